@@ -0,0 +1,444 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#include "attribute_cache.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <absl/hash/hash.h>
+#include <absl/strings/str_cat.h>
+#include <absl/strings/string_view.h>
+#include <glog/logging.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "posix_extras.h"
+
+namespace scoville {
+
+namespace {
+
+constexpr std::uint32_t kWatchMask =
+    IN_ATTRIB | IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE |
+    IN_DELETE_SELF | IN_MOVED_FROM | IN_MOVED_TO | IN_MOVE_SELF | IN_ONLYDIR;
+
+// Returns the parent directory of the relative path, or npos if the path is
+// the root.
+absl::string_view Parent(const absl::string_view path) {
+  if (path.empty()) {
+    return absl::string_view();
+  }
+  const size_t slash = path.rfind('/');
+  return slash == absl::string_view::npos ? absl::string_view("")
+                                          : path.substr(0, slash);
+}
+
+std::string Child(const absl::string_view directory,
+                  const absl::string_view name) {
+  return directory.empty() ? std::string(name)
+                           : absl::StrCat(directory, "/", name);
+}
+
+}  // namespace
+
+constexpr size_t AttributeCache::kShards;
+
+AttributeCache::AttributeCache(
+    const File& root, const size_t max_entries, const size_t max_watches,
+    const std::chrono::steady_clock::duration time_to_live,
+    const std::chrono::steady_clock::duration negative_time_to_live)
+    : root_(root),
+      max_entries_per_shard_((max_entries + kShards - 1) / kShards),
+      time_to_live_(time_to_live),
+      negative_time_to_live_(negative_time_to_live),
+      files_with_write_state_(0),
+      max_watches_(max_watches),
+      hits_(0),
+      misses_(0) {
+  if (!enabled()) {
+    return;
+  }
+  if ((inotify_fd_ = inotify_init1(IN_CLOEXEC)) == -1 ||
+      (stop_fd_ = eventfd(0, EFD_CLOEXEC)) == -1) {
+    PLOG(WARNING) << "couldn't set up inotify; attribute cache disabled";
+    max_entries_per_shard_ = 0;
+    return;
+  }
+  watcher_ = std::thread(&AttributeCache::WatchLoop, this);
+}
+
+AttributeCache::~AttributeCache() noexcept {
+  if (watcher_.joinable()) {
+    const std::uint64_t one = 1;
+    if (write(stop_fd_, &one, sizeof(one)) == sizeof(one)) {
+      watcher_.join();
+    } else {
+      PLOG(ERROR) << "couldn't stop inotify watcher";
+      watcher_.detach();
+    }
+  }
+  if (stop_fd_ != -1) {
+    close(stop_fd_);
+  }
+  if (inotify_fd_ != -1) {
+    close(inotify_fd_);
+  }
+}
+
+AttributeCache::Result AttributeCache::Lookup(const absl::string_view path,
+                                              struct stat* const output) {
+  if (!enabled()) {
+    return Result::kUnknown;
+  }
+
+  bool exists;
+  struct stat stats;
+  std::chrono::steady_clock::time_point inserted;
+  {
+    Shard& shard = ShardFor(path);
+    std::lock_guard<std::mutex> lock(shard.mu);
+    const auto it = shard.entries.find(path);
+    if (it == shard.entries.end()) {
+      misses_.fetch_add(1, std::memory_order_relaxed);
+      return Result::kUnknown;
+    }
+    if (!Watched(it->second)) {
+      shard.entries.erase(it);
+      misses_.fetch_add(1, std::memory_order_relaxed);
+      return Result::kUnknown;
+    }
+    exists = it->second.exists;
+    stats = it->second.stats;
+    inserted = it->second.inserted;
+  }
+
+  const auto age = std::chrono::steady_clock::now() - inserted;
+  if (!exists) {
+    if (age > negative_time_to_live_) {
+      misses_.fetch_add(1, std::memory_order_relaxed);
+      return Result::kUnknown;
+    }
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return Result::kMissing;
+  }
+  if (age > time_to_live_ || !WriteAllows(stats.st_ino, inserted)) {
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return Result::kUnknown;
+  }
+  hits_.fetch_add(1, std::memory_order_relaxed);
+  *output = stats;
+  return Result::kExists;
+}
+
+AttributeCache::Generation AttributeCache::BeginFetch(
+    const absl::string_view path) {
+  Generation result;
+  result.shard_generation_ = ShardFor(path).generation.load();
+  if (enabled()) {
+    // Make sure we'll hear about changes to the file from here on.  The root
+    // has no parent, so it's watched itself.
+    result.parent_ = AddWatch(path.empty() ? path : Parent(path));
+  }
+  return result;
+}
+
+void AttributeCache::Insert(const absl::string_view path,
+                            const struct stat& stats,
+                            const Generation& generation) {
+  if (!enabled() || generation.parent_ == nullptr) {
+    return;
+  }
+
+  Entry entry;
+  entry.exists = true;
+  entry.stats = stats;
+  entry.parent = generation.parent_;
+  if (S_ISDIR(stats.st_mode)) {
+    // Changes to a directory's contents change its own attributes, and only
+    // its own watch hears about them.  If that watch is new, the contents may
+    // have changed after the stat, so wait for the next one.
+    bool added = false;
+    entry.self = path.empty() ? generation.parent_ : AddWatch(path, &added);
+    if (entry.self == nullptr || added) {
+      return;
+    }
+  }
+  Store(path, std::move(entry), generation);
+}
+
+void AttributeCache::InsertMissing(const absl::string_view path,
+                                   const Generation& generation) {
+  // The root always exists, and if the parent is missing too, there's nothing
+  // to watch.
+  if (!enabled() || negative_time_to_live_.count() <= 0 || path.empty() ||
+      generation.parent_ == nullptr) {
+    return;
+  }
+
+  Entry entry{};
+  entry.exists = false;
+  entry.parent = generation.parent_;
+  Store(path, std::move(entry), generation);
+}
+
+bool AttributeCache::Contains(const absl::string_view path) {
+  if (!enabled()) {
+    return false;
+  }
+  Shard& shard = ShardFor(path);
+  std::lock_guard<std::mutex> lock(shard.mu);
+  const auto it = shard.entries.find(path);
+  return it != shard.entries.end() && Watched(it->second) &&
+         std::chrono::steady_clock::now() - it->second.inserted <=
+             (it->second.exists ? time_to_live_ : negative_time_to_live_);
+}
+
+void AttributeCache::Invalidate(const absl::string_view path) {
+  if (!enabled()) {
+    return;
+  }
+  // Any concurrent Insert of the path either sees the new generation or gets
+  // erased.
+  Shard& shard = ShardFor(path);
+  std::lock_guard<std::mutex> lock(shard.mu);
+  shard.generation.fetch_add(1);
+  shard.entries.erase(path);
+}
+
+void AttributeCache::InvalidateEntry(const absl::string_view path) {
+  Invalidate(path);
+  if (!path.empty()) {
+    Invalidate(Parent(path));
+  }
+}
+
+void AttributeCache::InvalidateAll() {
+  if (!enabled()) {
+    return;
+  }
+  for (Shard& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mu);
+    shard.generation.fetch_add(1);
+    shard.entries.clear();
+  }
+}
+
+void AttributeCache::BeginWrite(const ino_t inode) {
+  if (!enabled()) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(writes_mu_);
+  ++writes_[inode].writers;
+  files_with_write_state_.store(static_cast<int>(writes_.size()));
+}
+
+void AttributeCache::EndWrite(const ino_t inode) {
+  if (!enabled()) {
+    return;
+  }
+  const auto now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(writes_mu_);
+  WriteState& state = writes_[inode];
+  --state.writers;
+  state.last_closed = now;
+
+  // Once the time to live has passed, every entry inserted before the last
+  // writer closed has expired anyway, so there's no need to remember the file.
+  if (writes_.size() > 2 * kShards * 64) {
+    for (auto it = writes_.begin(); it != writes_.end();) {
+      if (it->second.writers == 0 &&
+          now - it->second.last_closed > time_to_live_) {
+        it = writes_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  files_with_write_state_.store(static_cast<int>(writes_.size()));
+}
+
+AttributeCache::Shard& AttributeCache::ShardFor(const absl::string_view path) {
+  // Use the high bits of the hash, which flat_hash_map doesn't use for its
+  // control bytes, as Memo does.
+  const size_t hash = absl::Hash<absl::string_view>()(path);
+  return shards_[(hash >> (std::numeric_limits<size_t>::digits - 8)) % kShards];
+}
+
+void AttributeCache::Store(const absl::string_view path, Entry entry,
+                           const Generation& generation) {
+  Shard& shard = ShardFor(path);
+  std::lock_guard<std::mutex> lock(shard.mu);
+  if (shard.generation.load() != generation.shard_generation_) {
+    // Something was invalidated while the caller was fetching the attributes,
+    // so they may be stale.
+    return;
+  }
+  if (shard.entries.size() >= max_entries_per_shard_) {
+    shard.entries.clear();
+  }
+  entry.inserted = std::chrono::steady_clock::now();
+  shard.entries[path] = std::move(entry);
+}
+
+bool AttributeCache::Watched(const Entry& entry) noexcept {
+  return entry.parent->live.load() &&
+         (entry.self == nullptr || entry.self->live.load());
+}
+
+bool AttributeCache::WriteAllows(
+    const ino_t inode, const std::chrono::steady_clock::time_point inserted) {
+  if (files_with_write_state_.load(std::memory_order_relaxed) == 0) {
+    return true;
+  }
+  std::lock_guard<std::mutex> lock(writes_mu_);
+  const auto it = writes_.find(inode);
+  return it == writes_.end() ||
+         (it->second.writers == 0 && it->second.last_closed < inserted);
+}
+
+std::shared_ptr<const AttributeCache::WatchState> AttributeCache::AddWatch(
+    const absl::string_view directory, bool* const added) {
+  std::lock_guard<std::mutex> lock(watches_mu_);
+  const auto existing = watches_.find(directory);
+  if (existing != watches_.end()) {
+    watch_recency_.splice(watch_recency_.begin(), watch_recency_,
+                          existing->second.recency);
+    return existing->second.state;
+  }
+
+  // By the time we get here, the mount has hidden the underlying directory, so
+  // reach it through our file descriptor instead.
+  std::string path = absl::StrCat("/proc/self/fd/", root_.fd());
+  if (!directory.empty()) {
+    absl::StrAppend(&path, "/", directory);
+  }
+  const int watch = inotify_add_watch(inotify_fd_, path.c_str(), kWatchMask);
+  if (watch == -1) {
+    if (errno != ENOENT && errno != ENOTDIR) {
+      PLOG_EVERY_N(WARNING, 1000)
+          << "couldn't watch " << path << "; not caching attributes in it";
+    }
+    return nullptr;
+  }
+
+  // Make room by dropping the least recently used watch.  The entries it
+  // covered notice on their next lookup.
+  while (!watches_.empty() && watches_.size() >= max_watches_) {
+    RemoveWatch(watches_.find(watch_recency_.back()), true);
+  }
+
+  watch_directories_[watch] = std::string(directory);
+  watch_recency_.emplace_front(directory);
+  Watch& record = watches_[directory];
+  record.descriptor = watch;
+  record.state = std::make_shared<WatchState>();
+  record.recency = watch_recency_.begin();
+  if (added != nullptr) {
+    *added = true;
+  }
+  return record.state;
+}
+
+void AttributeCache::RemoveWatch(
+    const absl::flat_hash_map<std::string, Watch>::iterator it,
+    const bool still_in_inotify) {
+  if (still_in_inotify) {
+    inotify_rm_watch(inotify_fd_, it->second.descriptor);
+  }
+  it->second.state->live = false;
+  watch_directories_.erase(it->second.descriptor);
+  watch_recency_.erase(it->second.recency);
+  watches_.erase(it);
+}
+
+void AttributeCache::WatchLoop() noexcept {
+  alignas(inotify_event) char buffer[64 * 1024];
+  pollfd fds[2] = {{inotify_fd_, POLLIN, 0}, {stop_fd_, POLLIN, 0}};
+  for (;;) {
+    if (poll(fds, 2, -1) == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      PLOG(ERROR) << "inotify watcher failed; attribute cache disabled";
+      break;
+    }
+    if (fds[1].revents) {
+      return;
+    }
+
+    const ssize_t bytes_read = read(inotify_fd_, buffer, sizeof(buffer));
+    if (bytes_read <= 0) {
+      if (bytes_read == -1 && errno == EINTR) {
+        continue;
+      }
+      PLOG(ERROR) << "inotify watcher failed; attribute cache disabled";
+      break;
+    }
+
+    for (const char* cursor = buffer; cursor < buffer + bytes_read;) {
+      const auto* const event = reinterpret_cast<const inotify_event*>(cursor);
+      cursor += sizeof(inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        // We've lost track of what changed.
+        InvalidateAll();
+        continue;
+      }
+
+      std::string directory;
+      {
+        std::lock_guard<std::mutex> lock(watches_mu_);
+        const auto it = watch_directories_.find(event->wd);
+        if (it == watch_directories_.end()) {
+          continue;
+        }
+        directory = it->second;
+        if (event->mask & (IN_IGNORED | IN_MOVE_SELF)) {
+          // The directory is gone, or is no longer at the path we know it by.
+          // Either way, stop watching it.
+          RemoveWatch(watches_.find(directory), !(event->mask & IN_IGNORED));
+        }
+      }
+
+      if ((event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) ||
+          ((event->mask & IN_ISDIR) && (event->mask & IN_MOVED_FROM))) {
+        // A directory moved or disappeared, taking the paths of everything
+        // under it along.
+        InvalidateAll();
+        continue;
+      }
+      if (event->len > 0) {
+        Invalidate(Child(directory, event->name));
+      }
+      Invalidate(directory);
+    }
+  }
+
+  // Something's gone badly wrong, and we can no longer trust the cache.
+  InvalidateAll();
+  max_entries_per_shard_ = 0;
+}
+
+}  // namespace scoville
@@ -0,0 +1,215 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#ifndef ATTRIBUTE_CACHE_H_
+#define ATTRIBUTE_CACHE_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include <absl/container/flat_hash_map.h>
+#include <absl/strings/string_view.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "posix_extras.h"
+
+namespace scoville {
+
+// A bounded, thread-safe cache of file attributes, keyed by encoded path
+// relative to the underlying root.  The cache also remembers paths which don't
+// exist, so repeated probes for missing files can be answered without a
+// syscall.
+//
+// The cache stays coherent in three ways.  Operations which change attributes
+// invalidate the affected paths explicitly.  Files open for writing are never
+// served from the cache, since their attributes change without any path-based
+// operation.  Finally, the cache watches every directory it holds entries from
+// with inotify, so changes made to the underlying file system behind our back
+// invalidate entries too.  Watches are limited in number; when the least
+// recently used one is removed, the entries it covered are dropped.  As a
+// backstop, entries also expire after a fixed time to live.
+class AttributeCache {
+ private:
+  struct WatchState;
+
+ public:
+  // A token identifying the state of one path in the cache.
+  class Generation {
+   private:
+    friend class AttributeCache;
+
+    std::uint64_t shard_generation_;
+    // Null if the path's parent couldn't be watched.
+    std::shared_ptr<const WatchState> parent_;
+  };
+
+  enum class Result { kUnknown, kExists, kMissing };
+
+  // A cache with a maximum of zero entries caches nothing.  The cache holds at
+  // most max_watches inotify watches.  Paths known to be missing are
+  // remembered for negative_time_to_live, which may be zero to disable
+  // negative caching.
+  AttributeCache(const File& root, size_t max_entries, size_t max_watches,
+                 std::chrono::steady_clock::duration time_to_live,
+                 std::chrono::steady_clock::duration negative_time_to_live);
+  virtual ~AttributeCache() noexcept;
+
+  bool enabled() const noexcept { return max_entries_per_shard_ != 0; }
+
+  // Call before stat'ing the path, and pass the result to Insert or
+  // InsertMissing.  This starts watching the path's parent, so changes made
+  // during the stat aren't missed, and if the path is invalidated before the
+  // insert, the (possibly stale) result is dropped rather than cached.
+  Generation BeginFetch(absl::string_view path);
+
+  // Looks up the path.  If the result is kExists, the path's attributes are
+  // stored in the output.
+  Result Lookup(absl::string_view path, struct stat*);
+
+  void Insert(absl::string_view path, const struct stat&, const Generation&);
+
+  // Records that the path does not exist.
+  void InsertMissing(absl::string_view path, const Generation&);
+
+  // Returns true if the cache holds an unexpired entry for the path.  Unlike
+  // Lookup, this doesn't count as a hit or miss.
+  bool Contains(absl::string_view path);
+
+  // Invalidates the cached attributes of the path.
+  void Invalidate(absl::string_view path);
+
+  // Invalidates the cached attributes of the path and of its parent directory.
+  // Use this after operations which add or remove names.
+  void InvalidateEntry(absl::string_view path);
+
+  void InvalidateAll();
+
+  // Brackets the time a file is open for writing.  While any writer is open,
+  // the cache refuses to serve the file's attributes, and entries inserted
+  // before the last writer closed are stale.
+  void BeginWrite(ino_t);
+  void EndWrite(ino_t);
+
+  std::uint64_t hits() const noexcept { return hits_.load(); }
+  std::uint64_t misses() const noexcept { return misses_.load(); }
+
+ private:
+  static constexpr size_t kShards = 16;
+
+  // Whether an inotify watch is still in place.
+  struct WatchState {
+    std::atomic<bool> live{true};
+  };
+
+  struct Watch {
+    int descriptor;
+    std::shared_ptr<WatchState> state;
+    // The watch's position in watch_recency_.
+    std::list<std::string>::iterator recency;
+  };
+
+  struct Entry {
+    bool exists;
+    struct stat stats;  // Valid only if exists.
+    std::chrono::steady_clock::time_point inserted;
+
+    // The watches which report changes to the entry: its parent's, and its
+    // own if it's a directory.  Once either is removed, the entry is stale.
+    std::shared_ptr<const WatchState> parent;
+    std::shared_ptr<const WatchState> self;
+  };
+
+  struct Shard {
+    std::mutex mu;
+    absl::flat_hash_map<std::string, Entry> entries;
+    // Bumped, with mu held, whenever an entry in the shard is invalidated.
+    std::atomic<std::uint64_t> generation{0};
+  };
+
+  struct WriteState {
+    int writers = 0;
+    std::chrono::steady_clock::time_point last_closed;
+  };
+
+  AttributeCache(const AttributeCache&) = delete;
+  AttributeCache(AttributeCache&&) = delete;
+
+  void operator=(const AttributeCache&) = delete;
+  void operator=(AttributeCache&&) = delete;
+
+  Shard& ShardFor(absl::string_view path);
+
+  // Stores the entry unless anything in its shard was invalidated since the
+  // generation.
+  void Store(absl::string_view path, Entry, const Generation&);
+
+  // Whether the entry's watches are still in place.
+  static bool Watched(const Entry&) noexcept;
+
+  // Returns true if entries for the inode inserted at the given time may be
+  // served.
+  bool WriteAllows(ino_t, std::chrono::steady_clock::time_point inserted);
+
+  // Starts watching the directory for changes, if it isn't watched already,
+  // and marks it most recently used.  Returns null if it can't be watched.
+  // Sets *added if the watch is new.
+  std::shared_ptr<const WatchState> AddWatch(absl::string_view directory,
+                                             bool* added = nullptr);
+
+  // Removes the watch from the bookkeeping, and from inotify unless it's
+  // already gone.  watches_mu_ must be held.
+  void RemoveWatch(absl::flat_hash_map<std::string, Watch>::iterator,
+                   bool still_in_inotify);
+
+  // Reads events from inotify_fd_ until stop_fd_ becomes readable.
+  void WatchLoop() noexcept;
+
+  const File& root_;
+  // Zeroed if we lose the ability to watch the underlying file system.
+  std::atomic<size_t> max_entries_per_shard_;
+  const std::chrono::steady_clock::duration time_to_live_;
+  const std::chrono::steady_clock::duration negative_time_to_live_;
+
+  std::array<Shard, kShards> shards_;
+
+  std::mutex writes_mu_;
+  std::atomic<int> files_with_write_state_;
+  std::unordered_map<ino_t, WriteState> writes_;
+
+  int inotify_fd_ = -1;
+  int stop_fd_ = -1;
+  const size_t max_watches_;
+  std::mutex watches_mu_;
+  std::unordered_map<int, std::string> watch_directories_;
+  absl::flat_hash_map<std::string, Watch> watches_;
+  // Watched directories, most recently used first.
+  std::list<std::string> watch_recency_;
+  std::thread watcher_;
+
+  std::atomic<std::uint64_t> hits_;
+  std::atomic<std::uint64_t> misses_;
+};
+
+}  // namespace scoville
+
+#endif  // ATTRIBUTE_CACHE_H_
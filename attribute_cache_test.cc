@@ -0,0 +1,193 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#include "attribute_cache.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "posix_extras.h"
+#include "test_util.h"
+
+namespace scoville {
+namespace {
+
+using Result = AttributeCache::Result;
+
+constexpr auto kLongTime = std::chrono::hours(1);
+
+class ScovilleAttributeCacheTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    root_.reset(new File(temporary_.path().c_str(), O_DIRECTORY));
+    root_->OpenAt("file", O_WRONLY | O_CREAT, 0644);
+  }
+
+  // Stats and inserts the path the way Getattr does.
+  void Fill(AttributeCache* const cache, const char* const path) {
+    const AttributeCache::Generation generation = cache->BeginFetch(path);
+    cache->Insert(path, *path ? root_->LinkStatAt(path) : root_->Stat(),
+                  generation);
+  }
+
+  TemporaryDirectory temporary_{"attribute_cache_test"};
+  std::unique_ptr<File> root_;
+};
+
+TEST_F(ScovilleAttributeCacheTest, DisabledCacheMisses) {
+  AttributeCache cache(*root_, 0, 64, kLongTime, kLongTime);
+  EXPECT_FALSE(cache.enabled());
+  Fill(&cache, "file");
+  struct stat stats;
+  EXPECT_EQ(cache.Lookup("file", &stats), Result::kUnknown);
+}
+
+TEST_F(ScovilleAttributeCacheTest, HitsAfterInsert) {
+  AttributeCache cache(*root_, 64, 64, kLongTime, kLongTime);
+  struct stat stats;
+  EXPECT_EQ(cache.Lookup("file", &stats), Result::kUnknown);
+  Fill(&cache, "file");
+  ASSERT_EQ(cache.Lookup("file", &stats), Result::kExists);
+  EXPECT_EQ(stats.st_ino, root_->LinkStatAt("file").st_ino);
+  EXPECT_EQ(cache.hits(), 1);
+  EXPECT_EQ(cache.misses(), 1);
+}
+
+TEST_F(ScovilleAttributeCacheTest, InvalidateEntryCoversParent) {
+  AttributeCache cache(*root_, 64, 64, kLongTime, kLongTime);
+  root_->MkDir("directory", 0755);
+  Fill(&cache, "");
+  Fill(&cache, "directory");
+  Fill(&cache, "file");
+  cache.InvalidateEntry("directory/new");
+  struct stat stats;
+  EXPECT_EQ(cache.Lookup("", &stats), Result::kExists);
+  EXPECT_EQ(cache.Lookup("directory", &stats), Result::kUnknown);
+  EXPECT_EQ(cache.Lookup("file", &stats), Result::kExists);
+}
+
+TEST_F(ScovilleAttributeCacheTest, DropsInsertsRacingInvalidation) {
+  AttributeCache cache(*root_, 64, 64, kLongTime, kLongTime);
+  const AttributeCache::Generation generation = cache.BeginFetch("file");
+  const struct stat stale = root_->LinkStatAt("file");
+  cache.Invalidate("file");
+  cache.Insert("file", stale, generation);
+  struct stat stats;
+  EXPECT_EQ(cache.Lookup("file", &stats), Result::kUnknown);
+}
+
+TEST_F(ScovilleAttributeCacheTest, ExpiresEntries) {
+  AttributeCache cache(*root_, 64, 64, std::chrono::steady_clock::duration(0),
+                       std::chrono::steady_clock::duration(0));
+  Fill(&cache, "file");
+  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  struct stat stats;
+  EXPECT_EQ(cache.Lookup("file", &stats), Result::kUnknown);
+}
+
+TEST_F(ScovilleAttributeCacheTest, IgnoresEntriesFromBeforeWriterCloses) {
+  AttributeCache cache(*root_, 64, 64, kLongTime, kLongTime);
+  const ino_t inode = root_->LinkStatAt("file").st_ino;
+  struct stat stats;
+
+  cache.BeginWrite(inode);
+  Fill(&cache, "file");
+  EXPECT_EQ(cache.Lookup("file", &stats), Result::kUnknown);
+  cache.EndWrite(inode);
+  EXPECT_EQ(cache.Lookup("file", &stats), Result::kUnknown);
+
+  Fill(&cache, "file");
+  EXPECT_EQ(cache.Lookup("file", &stats), Result::kExists);
+}
+
+TEST_F(ScovilleAttributeCacheTest, NoticesOutOfBandChanges) {
+  AttributeCache cache(*root_, 64, 64, kLongTime, kLongTime);
+  Fill(&cache, "file");
+  struct stat stats;
+  ASSERT_EQ(cache.Lookup("file", &stats), Result::kExists);
+
+  ASSERT_EQ(chmod((temporary_.path() + "/file").c_str(), 0600), 0);
+  // inotify delivers events asynchronously, so give the watcher a moment.
+  for (int i = 0; i < 500 && cache.Lookup("file", &stats) == Result::kExists;
+       ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(cache.Lookup("file", &stats), Result::kUnknown);
+}
+
+TEST_F(ScovilleAttributeCacheTest, RemembersMissingPaths) {
+  AttributeCache cache(*root_, 64, 64, kLongTime, kLongTime);
+  cache.InsertMissing("missing", cache.BeginFetch("missing"));
+  struct stat stats;
+  EXPECT_EQ(cache.Lookup("missing", &stats), Result::kMissing);
+  cache.InvalidateEntry("missing");
+  EXPECT_EQ(cache.Lookup("missing", &stats), Result::kUnknown);
+}
+
+TEST_F(ScovilleAttributeCacheTest, NegativeCachingCanBeDisabled) {
+  AttributeCache cache(*root_, 64, 64, kLongTime,
+                       std::chrono::steady_clock::duration(0));
+  cache.InsertMissing("missing", cache.BeginFetch("missing"));
+  struct stat stats;
+  EXPECT_EQ(cache.Lookup("missing", &stats), Result::kUnknown);
+}
+
+TEST_F(ScovilleAttributeCacheTest, NoticesOutOfBandCreation) {
+  AttributeCache cache(*root_, 64, 64, kLongTime, kLongTime);
+  cache.InsertMissing("new", cache.BeginFetch("new"));
+  struct stat stats;
+  ASSERT_EQ(cache.Lookup("new", &stats), Result::kMissing);
+
+  ASSERT_EQ(mkdir((temporary_.path() + "/new").c_str(), 0755), 0);
+  for (int i = 0; i < 500 && cache.Lookup("new", &stats) == Result::kMissing;
+       ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(cache.Lookup("new", &stats), Result::kUnknown);
+}
+
+TEST_F(ScovilleAttributeCacheTest, WaitsForDirectoryWatchBeforeCaching) {
+  AttributeCache cache(*root_, 64, 64, kLongTime, kLongTime);
+  root_->MkDir("directory", 0755);
+  struct stat stats;
+  // The directory's own watch didn't exist when it was stat'ed, so its
+  // contents might have changed unnoticed.
+  Fill(&cache, "directory");
+  EXPECT_EQ(cache.Lookup("directory", &stats), Result::kUnknown);
+  Fill(&cache, "directory");
+  EXPECT_EQ(cache.Lookup("directory", &stats), Result::kExists);
+}
+
+TEST_F(ScovilleAttributeCacheTest, DropsEntriesWhenWatchIsEvicted) {
+  AttributeCache cache(*root_, 64, 1, kLongTime, kLongTime);
+  root_->MkDir("a", 0755);
+  root_->MkDir("b", 0755);
+  root_->OpenAt("a/file", O_WRONLY | O_CREAT, 0644);
+  root_->OpenAt("b/file", O_WRONLY | O_CREAT, 0644);
+  struct stat stats;
+  Fill(&cache, "a/file");
+  ASSERT_EQ(cache.Lookup("a/file", &stats), Result::kExists);
+  Fill(&cache, "b/file");
+  EXPECT_EQ(cache.Lookup("b/file", &stats), Result::kExists);
+  EXPECT_EQ(cache.Lookup("a/file", &stats), Result::kUnknown);
+}
+
+}  // namespace
+}  // namespace scoville
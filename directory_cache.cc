@@ -0,0 +1,126 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#include "directory_cache.h"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <absl/strings/match.h>
+#include <absl/strings/string_view.h>
+#include <fcntl.h>
+
+#include "posix_extras.h"
+
+namespace scoville {
+
+DirectoryCache::DirectoryCache(const File& root, const size_t max_entries)
+    // The root outlives the cache, so it needn't be owned.
+    : root_(&root, [](const File*) {}),
+      max_entries_(max_entries),
+      hits_(0),
+      misses_(0) {}
+
+DirectoryCache::Location DirectoryCache::Find(const char* const path) {
+  if (*path == '\0') {
+    return {root_, "."};
+  }
+  const char* const slash = std::strrchr(path, '/');
+  if (!enabled() || slash == nullptr) {
+    return {root_, path};
+  }
+  const std::string parent(path, slash);
+
+  std::shared_ptr<const File> ancestor = root_;
+  size_t ancestor_length = 0;
+  std::uint64_t generation;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (std::shared_ptr<const File> directory = Lookup(parent)) {
+      ++hits_;
+      return {std::move(directory), slash + 1};
+    }
+    generation = generation_;
+    for (size_t end = parent.rfind('/'); end != std::string::npos && end > 0;
+         end = parent.rfind('/', end - 1)) {
+      if (std::shared_ptr<const File> directory =
+              Lookup(parent.substr(0, end))) {
+        ancestor = std::move(directory);
+        ancestor_length = end + 1;
+        break;
+      }
+    }
+  }
+  ++misses_;
+
+  std::shared_ptr<const File> directory;
+  try {
+    directory = std::make_shared<const File>(ancestor->OpenAt(
+        parent.c_str() + ancestor_length, O_PATH | O_DIRECTORY));
+  } catch (const std::system_error&) {
+    return {std::move(ancestor), path + ancestor_length};
+  }
+
+  std::shared_ptr<const File> evicted;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (generation == generation_ && index_.count(parent) == 0) {
+      entries_.emplace_front(parent, directory);
+      index_.emplace(parent, entries_.begin());
+      if (entries_.size() > max_entries_) {
+        evicted = std::move(entries_.back().second);
+        index_.erase(entries_.back().first);
+        entries_.pop_back();
+      }
+    }
+  }
+  // evicted closes its file descriptor here, outside the lock, unless someone
+  // is still using it.
+  return {std::move(directory), slash + 1};
+}
+
+void DirectoryCache::Invalidate(const absl::string_view path) {
+  std::vector<std::shared_ptr<const File>> doomed;
+  std::lock_guard<std::mutex> lock(mu_);
+  ++generation_;
+  // Everything beneath the path sorts among the strings starting with it.
+  for (auto it = index_.lower_bound(std::string(path));
+       it != index_.end() && absl::StartsWith(it->first, path);) {
+    if (it->first.size() == path.size() || path.empty() ||
+        it->first[path.size()] == '/') {
+      doomed.push_back(std::move(it->second->second));
+      entries_.erase(it->second);
+      it = index_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+std::shared_ptr<const File> DirectoryCache::Lookup(const std::string& path) {
+  const auto it = index_.find(path);
+  if (it == index_.end()) {
+    return nullptr;
+  }
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return it->second->second;
+}
+
+}  // namespace scoville
@@ -0,0 +1,106 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#ifndef DIRECTORY_CACHE_H_
+#define DIRECTORY_CACHE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include <absl/strings/string_view.h>
+
+#include "posix_extras.h"
+
+namespace scoville {
+
+// A bounded, thread-safe cache of O_PATH file descriptors for recently used
+// directories, keyed by encoded path relative to the underlying root.
+//
+// Every path-based operation otherwise makes the kernel walk the whole path
+// from the root, and on vfat, looking up a name the dcache doesn't hold means
+// scanning the directory.  With the parent directory cached, an operation
+// resolves only its final component.
+//
+// The cache notices directories renamed or removed through Scoville, as long
+// as the caller invalidates them, but not directories moved behind its back:
+// those stay reachable at their old paths until they're evicted.
+class DirectoryCache {
+ public:
+  // Where to find a path: a directory, and the rest of the path relative to
+  // it.  The directory stays open as long as the location exists, even if the
+  // cache evicts it.
+  struct Location {
+    std::shared_ptr<const File> directory;
+    const char* rest;
+  };
+
+  // A cache with a maximum of zero entries caches nothing.
+  DirectoryCache(const File& root, size_t max_entries);
+
+  bool enabled() const noexcept { return max_entries_ != 0; }
+
+  // Resolves the parent directory of the path, which must be encoded and
+  // relative to the root.  The rest of the location points into the path,
+  // except that the empty path, meaning the root itself, resolves to the root
+  // and ".".  On a miss, opens the parent relative to its deepest cached
+  // ancestor and caches it; if the parent can't be opened, returns the
+  // ancestor instead, so the caller's operation reports the error.
+  Location Find(const char* path);
+
+  // Drops the directory at the path, and everything beneath it.  Use this
+  // after renaming or removing a directory.
+  void Invalidate(absl::string_view path);
+
+  std::uint64_t hits() const noexcept { return hits_.load(); }
+  std::uint64_t misses() const noexcept { return misses_.load(); }
+
+ private:
+  using Entry = std::pair<std::string, std::shared_ptr<const File>>;
+
+  DirectoryCache(const DirectoryCache&) = delete;
+  DirectoryCache(DirectoryCache&&) = delete;
+
+  void operator=(const DirectoryCache&) = delete;
+  void operator=(DirectoryCache&&) = delete;
+
+  // Looks up the directory and marks it most recently used.  Returns null if
+  // it isn't cached.  Requires mu_.
+  std::shared_ptr<const File> Lookup(const std::string& path);
+
+  const std::shared_ptr<const File> root_;
+  const size_t max_entries_;
+
+  std::mutex mu_;
+
+  // Most recently used first.
+  std::list<Entry> entries_;
+  std::map<std::string, std::list<Entry>::iterator> index_;
+
+  // Incremented on every invalidation, so directories opened while one was in
+  // progress aren't cached.
+  std::uint64_t generation_ = 0;
+
+  std::atomic<std::uint64_t> hits_;
+  std::atomic<std::uint64_t> misses_;
+};
+
+}  // namespace scoville
+
+#endif  // DIRECTORY_CACHE_H_
@@ -0,0 +1,117 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#include "directory_cache.h"
+
+#include <memory>
+#include <string>
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "posix_extras.h"
+#include "test_util.h"
+
+namespace scoville {
+namespace {
+
+using Location = DirectoryCache::Location;
+
+class ScovilleDirectoryCacheTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    root_.reset(new File(temporary_.path().c_str(), O_DIRECTORY));
+    root_->MkDir("a", 0755);
+    root_->MkDir("a/b", 0755);
+    root_->MkDir("a/b/c", 0755);
+    root_->OpenAt("a/b/c/file", O_WRONLY | O_CREAT, 0644);
+  }
+
+  // The inode the location refers to.
+  ino_t Inode(const Location& location) const {
+    return location.directory->LinkStatAt(location.rest).st_ino;
+  }
+
+  TemporaryDirectory temporary_{"directory_cache_test"};
+  std::unique_ptr<File> root_;
+};
+
+TEST_F(ScovilleDirectoryCacheTest, DisabledCacheResolvesFromTheRoot) {
+  DirectoryCache cache(*root_, 0);
+  EXPECT_FALSE(cache.enabled());
+  const char path[] = "a/b/c/file";
+  const Location location = cache.Find(path);
+  EXPECT_EQ(location.directory.get(), root_.get());
+  EXPECT_EQ(location.rest, path);
+}
+
+TEST_F(ScovilleDirectoryCacheTest, CachesParents) {
+  DirectoryCache cache(*root_, 8);
+  const char path[] = "a/b/c/file";
+  const Location first = cache.Find(path);
+  EXPECT_STREQ(first.rest, "file");
+  EXPECT_EQ(Inode(first), root_->LinkStatAt(path).st_ino);
+  EXPECT_EQ(cache.misses(), 1);
+
+  const Location second = cache.Find(path);
+  EXPECT_EQ(second.directory, first.directory);
+  EXPECT_EQ(cache.hits(), 1);
+
+  // Names at the top level need no cache at all.
+  EXPECT_EQ(cache.Find("a").directory.get(), root_.get());
+}
+
+TEST_F(ScovilleDirectoryCacheTest, StartsFromTheDeepestCachedAncestor) {
+  DirectoryCache cache(*root_, 8);
+  cache.Find("a/b");  // caches a
+  root_->RenameAt("a/b", "elsewhere");
+  // The parent can't be opened, so the path resolves from a.
+  const Location location = cache.Find("a/b/c/file");
+  EXPECT_STREQ(location.rest, "b/c/file");
+  EXPECT_EQ(location.directory->Stat().st_ino, root_->LinkStatAt("a").st_ino);
+}
+
+TEST_F(ScovilleDirectoryCacheTest, InvalidatesDescendants) {
+  DirectoryCache cache(*root_, 8);
+  const ino_t c = Inode(cache.Find("a/b/c"));
+  cache.Find("a/b/c/file");
+  root_->RenameAt("a/b", "a/d");
+  root_->MkDir("a/b", 0755);
+  root_->MkDir("a/b/c", 0755);
+  cache.Invalidate("a/b");
+  const Location location = cache.Find("a/b/c");
+  EXPECT_NE(Inode(location), c);
+  EXPECT_EQ(Inode(location), root_->LinkStatAt("a/b/c").st_ino);
+  EXPECT_THROW(Inode(cache.Find("a/b/c/file")), std::system_error);
+}
+
+TEST_F(ScovilleDirectoryCacheTest, EvictsLeastRecentlyUsed) {
+  root_->MkDir("d", 0755);
+  root_->MkDir("e", 0755);
+  DirectoryCache cache(*root_, 2);
+  cache.Find("a/x");
+  cache.Find("d/x");
+  cache.Find("a/x");
+  cache.Find("e/x");  // evicts d
+  EXPECT_EQ(cache.hits(), 1);
+  cache.Find("a/x");
+  EXPECT_EQ(cache.hits(), 2);
+  cache.Find("d/x");
+  EXPECT_EQ(cache.hits(), 2);
+}
+
+}  // namespace
+}  // namespace scoville
@@ -0,0 +1,139 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#include "directory_listing.h"
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <dirent.h>
+#include <glog/logging.h>
+
+#include "encoding_cache.h"
+#include "posix_extras.h"
+
+namespace scoville {
+
+namespace {
+
+// Decodes the entry's name into a buffer of at least sizeof(entry.d_name)
+// bytes, returning the length of the decoded name.
+size_t DecodeName(EncodingCache* const encoding_cache, const dirent64& entry,
+                  char* const out) {
+  const size_t result =
+      encoding_cache->DecodeTo(entry.d_name, out, sizeof(entry.d_name));
+  if (result == std::string::npos) {
+    // Decoding never lengthens a name, so this should never happen.
+    throw std::system_error(ENAMETOOLONG, std::system_category());
+  }
+  return result;
+}
+
+}  // namespace
+
+DirectoryListing::DirectoryListing(File file,
+                                   EncodingCache* const encoding_cache,
+                                   const size_t max_snapshot_entries)
+    : directory_(std::move(file)),
+      encoding_cache_(encoding_cache),
+      max_snapshot_entries_(max_snapshot_entries) {}
+
+void DirectoryListing::Seek(const long offset) {
+  if (offset == 0 && (!started_ || offset_ != 0)) {
+    // We're starting (or restarting) from the top.
+    started_ = true;
+    offset_ = 0;
+    TakeSnapshot();
+    return;
+  }
+  started_ = true;
+  if (!snapshotted_) {
+    directory_.Seek(offset);
+  }
+  offset_ = offset;
+}
+
+bool DirectoryListing::Next(Entry* const entry) {
+  if (!started_) {
+    Seek(0);
+  }
+
+  if (snapshotted_) {
+    if (offset_ < 0 ||
+        static_cast<size_t>(offset_) >= snapshot_entries_.size()) {
+      return false;
+    }
+    const SnapshotEntry& snapshot_entry = snapshot_entries_[offset_];
+    entry->name = snapshot_names_.data() + snapshot_entry.name_offset;
+    entry->raw_name = entry->name + snapshot_entry.name_length + 1;
+    entry->inode = snapshot_entry.inode;
+    entry->type = snapshot_entry.type;
+    entry->next_offset = ++offset_;
+    return true;
+  }
+
+  const dirent64* const underlying = directory_.ReadOne();
+  if (!underlying) {
+    return false;
+  }
+  DecodeName(encoding_cache_, *underlying, name_);
+  entry->name = name_;
+  entry->raw_name = underlying->d_name;
+  entry->inode = underlying->d_ino;
+  entry->type = underlying->d_type;
+  entry->next_offset = offset_ = directory_.offset();
+  return true;
+}
+
+void DirectoryListing::TakeSnapshot() {
+  snapshotted_ = false;
+  snapshot_names_.clear();
+  snapshot_entries_.clear();
+  directory_.Seek(0);
+  if (max_snapshot_entries_ == 0) {
+    return;
+  }
+
+  for (const dirent64* underlying = directory_.ReadOne(); underlying;
+       underlying = directory_.ReadOne()) {
+    if (snapshot_entries_.size() == max_snapshot_entries_) {
+      VLOG(1) << "directory too large to snapshot; streaming it instead";
+      snapshot_names_.clear();
+      snapshot_names_.shrink_to_fit();
+      snapshot_entries_.clear();
+      snapshot_entries_.shrink_to_fit();
+      directory_.Seek(0);
+      return;
+    }
+
+    SnapshotEntry snapshot_entry;
+    snapshot_entry.name_offset =
+        static_cast<std::uint32_t>(snapshot_names_.size());
+    snapshot_entry.type = underlying->d_type;
+    snapshot_entry.inode = underlying->d_ino;
+
+    const size_t length = DecodeName(encoding_cache_, *underlying, name_);
+    snapshot_entry.name_length = static_cast<std::uint16_t>(length);
+    snapshot_entries_.push_back(snapshot_entry);
+    snapshot_names_.append(name_, length + 1);
+    snapshot_names_.append(underlying->d_name,
+                           std::strlen(underlying->d_name) + 1);
+  }
+  snapshotted_ = true;
+}
+
+}  // namespace scoville
@@ -0,0 +1,103 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#ifndef DIRECTORY_LISTING_H_
+#define DIRECTORY_LISTING_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "encoding_cache.h"
+#include "posix_extras.h"
+
+namespace scoville {
+
+// The decoded entries of an underlying directory, as served to FUSE.
+//
+// Seeking within a large directory on vfat means rescanning it from the start,
+// so paging through one with seekdir-style cookies takes quadratic time.  To
+// avoid that, a DirectoryListing reads the whole directory into a compact
+// snapshot the first time it's read from the start, and serves later reads by
+// array index.  Directories with more than max_snapshot_entries entries are
+// streamed as usual instead.
+class DirectoryListing {
+ public:
+  struct Entry {
+    const char* name;
+    const char* raw_name;  // as stored in the underlying directory
+    ino_t inode;
+    unsigned char type;  // a DT_* constant
+
+    // The offset to resume reading from after this entry.
+    long next_offset;
+  };
+
+  // Takes over the file, as Directory does.
+  DirectoryListing(File, EncodingCache*, size_t max_snapshot_entries);
+
+  // An opaque cookie identifying the position of the next entry Next will
+  // return.
+  long offset() const noexcept { return offset_; }
+
+  // Repositions the listing at a cookie previously returned by offset() or in
+  // Entry::next_offset.  Seeking to 0 rereads the directory.
+  void Seek(long);
+
+  // Retrieves the next entry, returning false at the end of the directory.  The
+  // entry remains valid until the next call to Next or Seek.
+  bool Next(Entry*);
+
+ private:
+  struct SnapshotEntry {
+    std::uint32_t name_offset;
+    std::uint16_t name_length;
+    unsigned char type;
+    ino_t inode;
+  };
+
+  DirectoryListing(const DirectoryListing&) = delete;
+  DirectoryListing(DirectoryListing&&) = delete;
+
+  void operator=(const DirectoryListing&) = delete;
+  void operator=(DirectoryListing&&) = delete;
+
+  // Reads the whole directory into the snapshot, falling back to streaming if
+  // it turns out to be too large.
+  void TakeSnapshot();
+
+  Directory directory_;
+  EncodingCache* const encoding_cache_;
+  const size_t max_snapshot_entries_;
+
+  long offset_ = 0;
+  bool started_ = false;
+
+  // In snapshot mode, offsets are indices into snapshot_entries_, and each
+  // entry's decoded name and raw name are packed end to end, NUL-terminated,
+  // in snapshot_names_.
+  bool snapshotted_ = false;
+  std::string snapshot_names_;
+  std::vector<SnapshotEntry> snapshot_entries_;
+
+  // In streaming mode, offsets are the underlying directory's cookies, and the
+  // most recent entry's decoded name lives here.
+  char name_[sizeof(dirent64::d_name)];
+};
+
+}  // namespace scoville
+
+#endif  // DIRECTORY_LISTING_H_
@@ -0,0 +1,153 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#include "directory_listing.h"
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+
+#include "encoding_cache.h"
+#include "posix_extras.h"
+#include "test_util.h"
+
+namespace scoville {
+namespace {
+
+// Large enough to snapshot the test directory, which has 12 entries.
+constexpr size_t kSnapshot = 100;
+// Disables snapshots.
+constexpr size_t kStream = 0;
+
+class ScovilleDirectoryListingTest : public testing::Test {
+ protected:
+  struct Entry {
+    std::string name;
+    std::string raw_name;
+    long next_offset;
+  };
+
+  void SetUp() override {
+    root_.reset(new File(temporary_.path().c_str(), O_DIRECTORY));
+    for (int i = 0; i < 10; ++i) {
+      Create("file" + std::to_string(i));
+    }
+  }
+
+  void Create(const std::string& name) {
+    root_->OpenAt(name.c_str(), O_WRONLY | O_CREAT, 0644);
+  }
+
+  std::unique_ptr<DirectoryListing> Open(const size_t max_snapshot_entries) {
+    return std::unique_ptr<DirectoryListing>(new DirectoryListing(
+        File(temporary_.path().c_str(), O_RDONLY | O_DIRECTORY),
+        &encoding_cache_, max_snapshot_entries));
+  }
+
+  // Reads the rest of the listing.
+  static std::vector<Entry> ReadAll(DirectoryListing* const listing) {
+    std::vector<Entry> result;
+    DirectoryListing::Entry entry;
+    while (listing->Next(&entry)) {
+      result.push_back({entry.name, entry.raw_name, entry.next_offset});
+      EXPECT_EQ(listing->offset(), entry.next_offset);
+    }
+    return result;
+  }
+
+  static std::set<std::string> Names(const std::vector<Entry>& entries) {
+    std::set<std::string> result;
+    for (const Entry& entry : entries) {
+      result.insert(entry.name);
+    }
+    return result;
+  }
+
+  static std::set<std::string> Expected() {
+    std::set<std::string> result = {".", ".."};
+    for (int i = 0; i < 10; ++i) {
+      result.insert("file" + std::to_string(i));
+    }
+    return result;
+  }
+
+  TemporaryDirectory temporary_{"directory_listing_test"};
+  std::unique_ptr<File> root_;
+  EncodingCache encoding_cache_{64};
+};
+
+TEST_F(ScovilleDirectoryListingTest, ListsEveryEntry) {
+  for (const size_t max : {kSnapshot, kStream}) {
+    const std::vector<Entry> entries = ReadAll(Open(max).get());
+    EXPECT_EQ(entries.size(), 12);
+    EXPECT_EQ(Names(entries), Expected());
+  }
+}
+
+TEST_F(ScovilleDirectoryListingTest, StreamsDirectoriesTooLargeToSnapshot) {
+  const std::vector<Entry> entries = ReadAll(Open(3).get());
+  EXPECT_EQ(entries.size(), 12);
+  EXPECT_EQ(Names(entries), Expected());
+}
+
+TEST_F(ScovilleDirectoryListingTest, ResumesFromNextOffset) {
+  for (const size_t max : {kSnapshot, kStream, size_t(3)}) {
+    const std::unique_ptr<DirectoryListing> listing = Open(max);
+    const std::vector<Entry> entries = ReadAll(listing.get());
+    ASSERT_EQ(entries.size(), 12);
+    for (const size_t resume : {size_t(5), size_t(0), size_t(10)}) {
+      listing->Seek(entries[resume].next_offset);
+      const std::vector<Entry> rest = ReadAll(listing.get());
+      ASSERT_EQ(rest.size(), entries.size() - resume - 1);
+      for (size_t i = 0; i < rest.size(); ++i) {
+        EXPECT_EQ(rest[i].name, entries[resume + 1 + i].name);
+        EXPECT_EQ(rest[i].next_offset, entries[resume + 1 + i].next_offset);
+      }
+    }
+  }
+}
+
+TEST_F(ScovilleDirectoryListingTest, RewindingRereadsTheDirectory) {
+  for (const size_t max : {kSnapshot, kStream}) {
+    const std::unique_ptr<DirectoryListing> listing = Open(max);
+    ReadAll(listing.get());
+    const std::string name = "new" + std::to_string(max);
+    Create(name);
+    listing->Seek(0);
+    EXPECT_EQ(Names(ReadAll(listing.get())).count(name), 1);
+  }
+}
+
+TEST_F(ScovilleDirectoryListingTest, ReturnsRawAndDecodedNames) {
+  Create("a%3fb");
+  for (const size_t max : {kSnapshot, kStream}) {
+    bool found = false;
+    for (const Entry& entry : ReadAll(Open(max).get())) {
+      if (entry.raw_name == "a%3fb") {
+        EXPECT_EQ(entry.name, "a?b");
+        found = true;
+      } else {
+        EXPECT_EQ(entry.name, entry.raw_name);
+      }
+    }
+    EXPECT_TRUE(found);
+  }
+}
+
+}  // namespace
+}  // namespace scoville
@@ -1,4 +1,4 @@
-// Copyright 2016, 2018 Benjamin Barenblat
+// Copyright 2016, 2018, 2026 Benjamin Barenblat
 //
 // Licensed under the Apache License, Version 2.0 (the "License"); you may not
 // use this file except in compliance with the License.  You may obtain a copy
@@ -14,101 +14,538 @@
 
 #include "encoding.h"
 
-#include <absl/strings/escaping.h>
-#include <absl/strings/str_cat.h>
-#include <absl/strings/str_join.h>
-#include <absl/strings/str_split.h>
+#include <absl/strings/match.h>
 #include <absl/strings/string_view.h>
 #include <glog/logging.h>
 
+#include <cstring>
 #include <stdexcept>
 #include <string>
-#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCOVILLE_X86 1
+#endif
 
 namespace scoville {
 
 namespace {
 
-bool IsVfatBadCharacter(const char c) noexcept {
-  return (0 <= c && c < 0x20) || c == '*' || c == '?' || c == '<' || c == '>' ||
-         c == '|' || c == '"' || c == ':' || c == '\\';
+constexpr char kHexDigits[] = "0123456789abcdef";
+
+// Profiles.  Each describes the names a file system accepts: which bytes it
+// forbids anywhere in a name, which it forbids at the end, and whether it
+// reserves device names.
+
+// VFAT forbids control characters and *?<>|":\ anywhere, and strips trailing
+// dots and spaces.
+struct Vfat {
+  static constexpr bool IsBad(const unsigned char c) noexcept {
+    return c < 0x20 || c == '*' || c == '?' || c == '<' || c == '>' ||
+           c == '|' || c == '"' || c == ':' || c == '\\';
+  }
+
+  static constexpr bool IsBadLast(const unsigned char c) noexcept {
+    return IsBad(c) || c == '.' || c == ' ';
+  }
+
+  // Whether the vectorized scanners, which look for exactly the bytes IsBad
+  // accepts, apply.
+  static constexpr bool kVfatCharacters = true;
+
+  // Whether IsBad and IsBadLast never accept anything, so only '%' needs
+  // escaping.
+  static constexpr bool kOnlyPercent = false;
+
+  static constexpr bool kReservedNames = false;
+};
+
+// exFAT forbids the same characters as VFAT, but Linux only strips trailing
+// dots.
+struct Exfat {
+  static constexpr bool IsBad(const unsigned char c) noexcept {
+    return Vfat::IsBad(c);
+  }
+
+  static constexpr bool IsBadLast(const unsigned char c) noexcept {
+    return IsBad(c) || c == '.';
+  }
+
+  static constexpr bool kVfatCharacters = true;
+  static constexpr bool kOnlyPercent = false;
+  static constexpr bool kReservedNames = false;
+};
+
+// NTFS, as Windows sees it, and SMB shares follow VFAT's rules, and also
+// refuse DOS device names like CON and LPT1.
+struct Ntfs {
+  static constexpr bool IsBad(const unsigned char c) noexcept {
+    return Vfat::IsBad(c);
+  }
+
+  static constexpr bool IsBadLast(const unsigned char c) noexcept {
+    return Vfat::IsBadLast(c);
+  }
+
+  static constexpr bool kVfatCharacters = true;
+  static constexpr bool kOnlyPercent = false;
+  static constexpr bool kReservedNames = true;
+};
+
+// POSIX file systems accept anything, so only '%' needs escaping.
+struct Posix {
+  static constexpr bool IsBad(unsigned char) noexcept { return false; }
+  static constexpr bool IsBadLast(unsigned char) noexcept { return false; }
+  static constexpr bool kVfatCharacters = false;
+  static constexpr bool kOnlyPercent = true;
+  static constexpr bool kReservedNames = false;
+};
+
+// Classes of bytes, as bits in a CharacterTable entry.
+constexpr unsigned char kBad = 1 << 0;
+constexpr unsigned char kBadLast = 1 << 1;
+// The scanners below stop at special bytes: bad ones, '%', and '/'.
+constexpr unsigned char kSpecial = 1 << 2;
+
+struct CharacterTable {
+  unsigned char classes[256];
+};
+
+template <typename Profile>
+constexpr CharacterTable MakeCharacterTable() noexcept {
+  CharacterTable result{};
+  for (int i = 0; i < 256; ++i) {
+    const auto c = static_cast<unsigned char>(i);
+    unsigned char classes = 0;
+    if (Profile::IsBad(c)) {
+      classes |= kBad;
+    }
+    if (Profile::IsBadLast(c)) {
+      classes |= kBadLast;
+    }
+    if (Profile::IsBad(c) || c == '%' || c == '/') {
+      classes |= kSpecial;
+    }
+    result.classes[i] = classes;
+  }
+  return result;
 }
 
-bool IsVfatBadLastCharacter(const char c) noexcept {
-  return IsVfatBadCharacter(c) || c == '.' || c == ' ';
+template <typename Profile>
+constexpr CharacterTable kCharacters = MakeCharacterTable<Profile>();
+
+template <typename Profile>
+bool Is(const unsigned char character_class, const char c) noexcept {
+  return (kCharacters<Profile>.classes[static_cast<unsigned char>(c)] &
+          character_class) != 0;
 }
 
-bool IsValidHex(const char c) noexcept {
-  return ('0' <= c && c <= '9') || ('A' <= c && c <= 'F') ||
-         ('a' <= c && c <= 'f');
+// Returns true if the component, which must not contain '/', is a DOS device
+// name, with or without an extension.  Windows ignores trailing spaces before
+// the extension, so "CON .txt" names the console too.
+bool IsReservedName(const absl::string_view component) noexcept {
+  absl::string_view base = component.substr(0, component.find('.'));
+  while (!base.empty() && base.back() == ' ') {
+    base.remove_suffix(1);
+  }
+  for (const char* const name :
+       {"CON", "PRN", "AUX", "NUL", "CONIN$", "CONOUT$"}) {
+    if (absl::EqualsIgnoreCase(base, name)) {
+      return true;
+    }
+  }
+  return base.size() == 4 &&
+         (absl::StartsWithIgnoreCase(base, "COM") ||
+          absl::StartsWithIgnoreCase(base, "LPT")) &&
+         '1' <= base[3] && base[3] <= '9';
 }
 
-std::string EncodeComponent(absl::string_view in) {
-  std::string out;
-  for (size_t i = 0; i < in.size(); ++i) {
-    absl::string_view c(in.data() + i, 1);
-    if (in[i] == '%') {
-      absl::StrAppend(&out, "%%");
-    } else if (IsVfatBadCharacter(in[i]) ||
-               (i == in.size() - 1 && IsVfatBadLastCharacter(in[i]))) {
-      absl::StrAppend(&out, "%", absl::BytesToHexString(c));
-    } else {
-      absl::StrAppend(&out, c);
+// Returns true if any component of the path is a DOS device name.
+bool HasReservedName(const absl::string_view path) noexcept {
+  for (size_t start = 0;;) {
+    const size_t slash = path.find('/', start);
+    if (IsReservedName(path.substr(start, slash - start))) {
+      return true;
+    }
+    if (slash == absl::string_view::npos) {
+      return false;
     }
+    start = slash + 1;
   }
-  return out;
 }
 
-}  // namespace
+int HexValue(const char c) noexcept {
+  if ('0' <= c && c <= '9') {
+    return c - '0';
+  } else if ('A' <= c && c <= 'F') {
+    return c - 'A' + 10;
+  } else if ('a' <= c && c <= 'f') {
+    return c - 'a' + 10;
+  } else {
+    return -1;
+  }
+}
+
+// Scanners.  Each returns the index of the first special byte in [data, data +
+// size), or size if there isn't one.
 
-std::string Encode(const std::string& in) {
-  std::vector<std::string> out;
-  for (auto component : absl::StrSplit(in, '/')) {
-    out.push_back(EncodeComponent(component));
+template <typename Profile>
+size_t ScanTable(const char* const data, const size_t size) noexcept {
+  for (size_t i = 0; i < size; ++i) {
+    if (Is<Profile>(kSpecial, data[i])) {
+      return i;
+    }
   }
-  std::string result = absl::StrJoin(out, "/");
-  VLOG(1) << "Encode: \"" << in << "\" -> \"" << result << "\"";
-  return result;
+  return size;
 }
 
-std::string Decode(const std::string& in) {
-  std::string result;
-  for (size_t i = 0; i < in.size(); ++i) {
-    if (in[i] != '%') {
-      // This isn't an escaped byte.
-      absl::StrAppend(&result, absl::string_view(in.data() + i, 1));
-      continue;
+#ifdef SCOVILLE_X86
+
+__attribute__((target("sse2"))) size_t ScanSse2(const char* const data,
+                                                 const size_t size) noexcept {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i space = _mm_set1_epi8(0x20);
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    // Control characters are those in [0, 0x20).  The comparisons are signed,
+    // so exclude bytes with the high bit set.
+    __m128i special =
+        _mm_andnot_si128(_mm_cmplt_epi8(v, zero), _mm_cmplt_epi8(v, space));
+    for (const char c : {'*', '?', '<', '>', '|', '"', ':', '\\', '%', '/'}) {
+      special = _mm_or_si128(special, _mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+    }
+    if (const int mask = _mm_movemask_epi8(special)) {
+      return i + static_cast<size_t>(__builtin_ctz(mask));
+    }
+  }
+  return i + ScanTable<Vfat>(data + i, size - i);
+}
+
+__attribute__((target("avx2"))) size_t ScanAvx2(const char* const data,
+                                                 const size_t size) noexcept {
+  const __m256i negative_one = _mm256_set1_epi8(-1);
+  const __m256i space = _mm256_set1_epi8(0x20);
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    const __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+    // See notes in ScanSse2 about control characters.
+    __m256i special = _mm256_and_si256(_mm256_cmpgt_epi8(v, negative_one),
+                                       _mm256_cmpgt_epi8(space, v));
+    for (const char c : {'*', '?', '<', '>', '|', '"', ':', '\\', '%', '/'}) {
+      special =
+          _mm256_or_si256(special, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)));
+    }
+    if (const auto mask =
+            static_cast<unsigned>(_mm256_movemask_epi8(special))) {
+      return i + static_cast<size_t>(__builtin_ctz(mask));
     }
+  }
+  return i + ScanSse2(data + i, size - i);
+}
+
+#endif  // SCOVILLE_X86
+
+using Scanner = size_t (*)(const char*, size_t);
+
+Scanner ChooseScanner() noexcept {
+#ifdef SCOVILLE_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return ScanAvx2;
+  } else if (__builtin_cpu_supports("sse2")) {
+    return ScanSse2;
+  }
+#endif
+  return ScanTable<Vfat>;
+}
+
+// Scans for bytes in the VFAT character set.
+const Scanner scan_vfat = ChooseScanner();
+
+template <typename Profile>
+size_t Scan(const char* const data, const size_t size) noexcept {
+  if (Profile::kVfatCharacters) {
+    return scan_vfat(data, size);
+  }
+  return ScanTable<Profile>(data, size);
+}
+
+// An output sink for the encoder and decoder which writes into a fixed-size,
+// caller-provided buffer.  It supports the subset of the std::string interface
+// they use, so they can be written once for both kinds of output.
+class BufferWriter {
+ public:
+  BufferWriter(char* const out, const size_t size) noexcept
+      : begin_(out), cursor_(out), end_(out + size) {}
+
+  void append(const char* const data, const size_t size) noexcept {
+    if (overflowed_ || static_cast<size_t>(end_ - cursor_) < size) {
+      overflowed_ = true;
+      return;
+    }
+    std::memcpy(cursor_, data, size);
+    cursor_ += size;
+  }
+
+  void append(const char* const data) noexcept {
+    append(data, std::strlen(data));
+  }
 
-    char x, y;
+  void push_back(const char c) noexcept { append(&c, 1); }
+
+  // NUL-terminates the output and returns its length (not counting the
+  // terminator), or std::string::npos if it didn't fit.
+  size_t Finish() noexcept {
+    push_back('\0');
+    if (overflowed_) {
+      return std::string::npos;
+    }
+    return static_cast<size_t>(cursor_ - begin_) - 1;
+  }
+
+ private:
+  char* const begin_;
+  char* cursor_;
+  char* const end_;
+  bool overflowed_ = false;
+};
+
+// Returns true if Encode would return the path unchanged.
+template <typename Profile>
+bool IsClean(const absl::string_view in) noexcept {
+  if (Profile::kOnlyPercent) {
+    // memchr is vectorized by the C library.
+    return in.empty() || std::memchr(in.data(), '%', in.size()) == nullptr;
+  }
+  if (Profile::kReservedNames && HasReservedName(in)) {
+    return false;
+  }
+  for (size_t i = 0; i < in.size();) {
+    i += Scan<Profile>(in.data() + i, in.size() - i);
+    if (i == in.size()) {
+      break;
+    }
+    if (in[i] != '/' || (i != 0 && Is<Profile>(kBadLast, in[i - 1]))) {
+      return false;
+    }
+    ++i;
+  }
+  return in.empty() || !Is<Profile>(kBadLast, in.back());
+}
+
+template <typename Output>
+void AppendEscaped(const char c, Output* const out) {
+  const auto byte = static_cast<unsigned char>(c);
+  const char escaped[] = {'%', kHexDigits[byte >> 4], kHexDigits[byte & 0xf]};
+  out->append(escaped, sizeof(escaped));
+}
+
+template <typename Profile, typename Output>
+void AppendEncodedComponent(const absl::string_view in, Output* const out) {
+  size_t i = 0;
+  if (Profile::kReservedNames && IsReservedName(in)) {
+    // Escaping any byte of the base name makes it an ordinary name.
+    AppendEscaped(in[0], out);
+    i = 1;
+  }
+  while (i < in.size()) {
+    const size_t special = i + Scan<Profile>(in.data() + i, in.size() - i);
+    if (special == in.size()) {
+      // The rest of the component is clean, except possibly the last byte.
+      if (Is<Profile>(kBadLast, in.back())) {
+        out->append(in.data() + i, special - i - 1);
+        AppendEscaped(in.back(), out);
+      } else {
+        out->append(in.data() + i, special - i);
+      }
+      return;
+    }
+    out->append(in.data() + i, special - i);
+    if (in[special] == '%') {
+      out->append("%%");
+    } else {
+      AppendEscaped(in[special], out);
+    }
+    i = special + 1;
+  }
+}
+
+template <typename Profile, typename Output>
+void AppendEncoded(const absl::string_view in, Output* const out) {
+  if (IsClean<Profile>(in)) {
+    out->append(in.data(), in.size());
+    return;
+  }
+  for (size_t start = 0;;) {
+    const size_t slash = in.find('/', start);
+    AppendEncodedComponent<Profile>(in.substr(start, slash - start), out);
+    if (slash == absl::string_view::npos) {
+      break;
+    }
+    out->push_back('/');
+    start = slash + 1;
+  }
+}
+
+template <typename Output>
+void AppendDecoded(const absl::string_view in, Output* const out) {
+  // memchr is already vectorized (and dispatched at runtime) by the C library.
+  const char* cursor = in.data();
+  const char* const end = cursor + in.size();
+  for (;;) {
+    const char* const escape = static_cast<const char*>(
+        std::memchr(cursor, '%', static_cast<size_t>(end - cursor)));
+    if (escape == nullptr) {
+      out->append(cursor, static_cast<size_t>(end - cursor));
+      return;
+    }
+    out->append(cursor, static_cast<size_t>(escape - cursor));
 
     // Decode single-byte escapes. There's only one of these ("%%" -> "%").
-    try {
-      x = in.at(i + 1);
-    } catch (std::out_of_range&) {
+    if (end - escape < 2) {
       throw DecodingFailure("clipped escape at end of string");
     }
-    if (x == '%') {
-      absl::StrAppend(&result, "%");
-      ++i;
+    if (escape[1] == '%') {
+      out->push_back('%');
+      cursor = escape + 2;
       continue;
     }
 
     // Decode double-byte escapes.
-    try {
-      y = in.at(i + 2);
-    } catch (std::out_of_range&) {
+    if (end - escape < 3) {
       throw DecodingFailure("clipped escape at end of string");
     }
-    if (!(IsValidHex(x) && IsValidHex(y))) {
-      throw DecodingFailure("clipped escape at end of string");
+    const int high = HexValue(escape[1]);
+    const int low = HexValue(escape[2]);
+    if (high < 0 || low < 0) {
+      throw DecodingFailure("invalid escape");
     }
-    absl::StrAppend(&result, absl::HexStringToBytes(
-                                 absl::string_view(in.c_str() + i + 1, 2)));
-    i += 2;
+    out->push_back(static_cast<char>(high << 4 | low));
+    cursor = escape + 3;
+  }
+}
+
+template <typename Profile>
+std::string EncodeComponentAs(const absl::string_view in) {
+  std::string out;
+  AppendEncodedComponent<Profile>(in, &out);
+  return out;
+}
+
+template <typename Profile>
+size_t EncodeComponentToAs(const absl::string_view in, char* const out,
+                           const size_t out_size) noexcept {
+  BufferWriter writer(out, out_size);
+  AppendEncodedComponent<Profile>(in, &writer);
+  return writer.Finish();
+}
+
+template <typename Profile>
+std::string EncodeAs(const absl::string_view in) {
+  std::string result;
+  result.reserve(in.size());
+  AppendEncoded<Profile>(in, &result);
+  VLOG(1) << "Encode: \"" << in << "\" -> \"" << result << "\"";
+  return result;
+}
+
+template <typename Profile>
+size_t EncodeToAs(const absl::string_view in, char* const out,
+                  const size_t out_size) noexcept {
+  BufferWriter writer(out, out_size);
+  AppendEncoded<Profile>(in, &writer);
+  const size_t result = writer.Finish();
+  if (result != std::string::npos) {
+    VLOG(1) << "Encode: \"" << in << "\" -> \"" << out << "\"";
   }
   return result;
+}
+
+// The encoders for one profile.
+struct Encoders {
+  std::string (*encode)(absl::string_view);
+  size_t (*encode_to)(absl::string_view, char*, size_t);
+  std::string (*encode_component)(absl::string_view);
+  size_t (*encode_component_to)(absl::string_view, char*, size_t);
+};
+
+template <typename Profile>
+constexpr Encoders kEncoders = {EncodeAs<Profile>, EncodeToAs<Profile>,
+                                EncodeComponentAs<Profile>,
+                                EncodeComponentToAs<Profile>};
+
+const Encoders* encoders = &kEncoders<Vfat>;
+
+}  // namespace
+
+bool ParseProfile(const absl::string_view name, Profile* const profile) {
+  if (name == "vfat") {
+    *profile = Profile::kVfat;
+  } else if (name == "exfat") {
+    *profile = Profile::kExfat;
+  } else if (name == "ntfs") {
+    *profile = Profile::kNtfs;
+  } else if (name == "posix") {
+    *profile = Profile::kPosix;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void SetProfile(const Profile profile) {
+  switch (profile) {
+    case Profile::kVfat:
+      encoders = &kEncoders<Vfat>;
+      return;
+    case Profile::kExfat:
+      encoders = &kEncoders<Exfat>;
+      return;
+    case Profile::kNtfs:
+      encoders = &kEncoders<Ntfs>;
+      return;
+    case Profile::kPosix:
+      encoders = &kEncoders<Posix>;
+      return;
+  }
+}
+
+std::string EncodeComponent(const absl::string_view in) {
+  return encoders->encode_component(in);
+}
+
+size_t EncodeComponentTo(const absl::string_view in, char* const out,
+                         const size_t out_size) noexcept {
+  return encoders->encode_component_to(in, out, out_size);
+}
+
+std::string Encode(const absl::string_view in) { return encoders->encode(in); }
+
+size_t EncodeTo(const absl::string_view in, char* const out,
+                const size_t out_size) noexcept {
+  return encoders->encode_to(in, out, out_size);
+}
+
+std::string Decode(const absl::string_view in) {
+  std::string result;
+  result.reserve(in.size());
+  AppendDecoded(in, &result);
   VLOG(1) << "Decode: \"" << in << "\" -> \"" << result << "\"";
+  return result;
+}
+
+size_t DecodeTo(const absl::string_view in, char* const out,
+                const size_t out_size) {
+  BufferWriter writer(out, out_size);
+  AppendDecoded(in, &writer);
+  const size_t result = writer.Finish();
+  if (result != std::string::npos) {
+    VLOG(1) << "Decode: \"" << in << "\" -> \"" << out << "\"";
+  }
+  return result;
 }
 
 }  // namespace scoville
@@ -18,6 +18,8 @@
 #include <string>
 #include <stdexcept>
 
+#include <absl/strings/string_view.h>
+
 namespace scoville {
 
 class DecodingFailure : public std::logic_error {
@@ -25,9 +27,47 @@ class DecodingFailure : public std::logic_error {
   using std::logic_error::logic_error;
 };
 
-std::string Encode(const std::string&);
+// The naming rules of the file system underneath Scoville, which determine what
+// Encode escapes.  Every profile escapes '%'.
+enum class Profile {
+  // Control characters and *?<>|":\ anywhere, and dots and spaces at the end
+  // of a name.  The default.
+  kVfat,
+
+  // The same characters as VFAT, but only dots at the end of a name.
+  kExfat,
+
+  // Windows' rules, for NTFS and SMB shares: VFAT's, plus DOS device names
+  // like CON and LPT1.
+  kNtfs,
+
+  // Nothing but '%'.
+  kPosix,
+};
+
+// Parses a profile name: "vfat", "exfat", "ntfs", or "posix".  Returns false if
+// the name isn't one of those.
+bool ParseProfile(absl::string_view, Profile*);
+
+// Selects the profile the encoders follow.  Call it before encoding anything;
+// it isn't safe to call while other threads are encoding.
+void SetProfile(Profile);
+
+std::string Encode(absl::string_view);
+
+// Encodes a single path component, which must not contain '/'.
+std::string EncodeComponent(absl::string_view);
+
+std::string Decode(absl::string_view);
 
-std::string Decode(const std::string&);
+// Allocation-free versions of the above.  Each writes its result into the
+// buffer [out, out + out_size) and NUL-terminates it, returning the length of
+// the result (not counting the terminator).  If the buffer is too small, they
+// return std::string::npos, and the buffer contents are unspecified.
+size_t EncodeTo(absl::string_view, char* out, size_t out_size) noexcept;
+size_t EncodeComponentTo(absl::string_view, char* out,
+                         size_t out_size) noexcept;
+size_t DecodeTo(absl::string_view, char* out, size_t out_size);
 
 }  // scoville
 
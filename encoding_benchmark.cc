@@ -0,0 +1,221 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+// Microbenchmarks for the encoder and decoder.  Each benchmark runs one of the
+// functions over every name in a corpus and reports, besides the usual times,
+//
+//   - time/byte: time per byte of input, and
+//   - allocs/call: heap allocations per call.
+//
+// Compare runs across commits with Google Benchmark's tools/compare.py.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <limits.h>
+
+#include "encoding.h"
+#include "encoding_cache.h"
+
+namespace {
+
+std::atomic<std::uint64_t> allocations(0);
+
+}  // namespace
+
+// Count every heap allocation in the program.  The benchmarks read the counter
+// before and after their timed loops.
+void* operator new(const size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* const result = std::malloc(size == 0 ? 1 : size)) {
+    return result;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* const p) noexcept { std::free(p); }
+
+void operator delete(void* const p, size_t) noexcept { std::free(p); }
+
+namespace scoville {
+namespace {
+
+using Corpus = std::vector<std::string>;
+
+// Names which need no escaping at all.
+Corpus CleanNames() {
+  return {"README.md",       "Makefile",    "src",
+          "main.cc",         "IMG_2048.JPG", "2016-05-01 Vacation.mp4",
+          "Music",           "index.html",   "Cargo.toml",
+          "thesis-final.pdf"};
+}
+
+// File names and object paths from a git-annex repository.
+Corpus AnnexKeys() {
+  const std::string key =
+      "SHA256E-s1048576--"
+      "5f70bf18a086007016e948b04aed3b82103a36bea41755b6cddfaf10ace3c6ef.flac";
+  return {key, "annex/objects/Xk/9p/" + key + "/" + key,
+          "MD5E-s42--d41d8cd98f00b204e9800998ecf8427e.txt",
+          "URL--http&c%%example.com%some%file.iso",
+          "WORM-s3-m1462140000--hello.txt"};
+}
+
+// Names dense with characters VFAT forbids.
+Corpus PunctuatedNames() {
+  return {"What Else Is There?.flac", "10:30:00 standup?.txt",
+          "a:b:c:d?e?f:g?h", "\"quoted\" <angled> |piped|",
+          "Really?!?.mp3", "C:\\Windows\\System32", "trailing dot.",
+          "trailing space "};
+}
+
+// The worst case for the escaper: every byte doubles.
+Corpus PercentNames() {
+  return {std::string(16, '%'), std::string(64, '%'), std::string(255, '%')};
+}
+
+// Long paths of mostly clean components, as the high-level API passes them.
+Corpus DeepPaths() {
+  std::string clean;
+  std::string mixed;
+  for (int i = 0; i < 32; ++i) {
+    clean += "/directory" + std::to_string(i);
+    mixed += (i % 4 == 0 ? "/what? " : "/dir") + std::to_string(i);
+  }
+  return {clean, mixed + "/file.txt"};
+}
+
+// Long names in non-ASCII scripts.  These have the high bit set in every byte,
+// which the vectorized scanners must not mistake for control characters.
+Corpus Utf8Names() {
+  std::string japanese;
+  std::string accented;
+  for (int i = 0; i < 8; ++i) {
+    japanese += "日本語のファイル名";
+    accented += "Ñandú Pokémon Ærøskøbing ";
+  }
+  return {japanese + ".txt", accented + "résumé.pdf",
+          "Ελληνικά και Кириллица.odt"};
+}
+
+Corpus Encoded(const Corpus& corpus) {
+  Corpus result;
+  for (const std::string& name : corpus) {
+    result.push_back(Encode(name));
+  }
+  return result;
+}
+
+std::int64_t TotalBytes(const Corpus& corpus) {
+  std::int64_t result = 0;
+  for (const std::string& name : corpus) {
+    result += static_cast<std::int64_t>(name.size());
+  }
+  return result;
+}
+
+// Runs f over the corpus on every iteration and sets the custom counters.
+template <typename F>
+void RunOverCorpus(benchmark::State& state, const Corpus& corpus, F f) {
+  const std::uint64_t allocations_before = allocations.load();
+  for (auto _ : state) {
+    for (const std::string& name : corpus) {
+      f(name);
+    }
+  }
+  const std::uint64_t allocations_after = allocations.load();
+
+  const std::int64_t bytes = TotalBytes(corpus);
+  state.SetBytesProcessed(state.iterations() * bytes);
+  state.counters["time/byte"] = benchmark::Counter(
+      static_cast<double>(bytes),
+      benchmark::Counter::kIsIterationInvariantRate |
+          benchmark::Counter::kInvert);
+  state.counters["allocs/call"] = benchmark::Counter(
+      static_cast<double>(allocations_after - allocations_before) /
+          static_cast<double>(corpus.size()),
+      benchmark::Counter::kAvgIterations);
+}
+
+void BM_Encode(benchmark::State& state, Corpus (*make_corpus)()) {
+  const Corpus corpus = make_corpus();
+  RunOverCorpus(state, corpus, [](const std::string& name) {
+    benchmark::DoNotOptimize(Encode(name));
+  });
+}
+
+void BM_EncodeTo(benchmark::State& state, Corpus (*make_corpus)()) {
+  const Corpus corpus = make_corpus();
+  char out[PATH_MAX];
+  RunOverCorpus(state, corpus, [&out](const std::string& name) {
+    benchmark::DoNotOptimize(EncodeTo(name, out, sizeof(out)));
+    benchmark::ClobberMemory();
+  });
+}
+
+void BM_Decode(benchmark::State& state, Corpus (*make_corpus)()) {
+  const Corpus corpus = Encoded(make_corpus());
+  RunOverCorpus(state, corpus, [](const std::string& name) {
+    benchmark::DoNotOptimize(Decode(name));
+  });
+}
+
+void BM_DecodeTo(benchmark::State& state, Corpus (*make_corpus)()) {
+  const Corpus corpus = Encoded(make_corpus());
+  char out[PATH_MAX];
+  RunOverCorpus(state, corpus, [&out](const std::string& name) {
+    benchmark::DoNotOptimize(DecodeTo(name, out, sizeof(out)));
+    benchmark::ClobberMemory();
+  });
+}
+
+// The memoized encoder, as the FUSE operations use it, with a warm cache.
+void BM_CachedEncodeTo(benchmark::State& state, Corpus (*make_corpus)()) {
+  const Corpus corpus = make_corpus();
+  EncodingCache cache(1 << 16);
+  char out[PATH_MAX];
+  for (const std::string& name : corpus) {
+    cache.EncodeTo(name, out, sizeof(out));
+  }
+  RunOverCorpus(state, corpus, [&cache, &out](const std::string& name) {
+    benchmark::DoNotOptimize(cache.EncodeTo(name, out, sizeof(out)));
+    benchmark::ClobberMemory();
+  });
+}
+
+#define SCOVILLE_BENCHMARK_CORPORA(f)                   \
+  BENCHMARK_CAPTURE(f, clean, CleanNames);              \
+  BENCHMARK_CAPTURE(f, annex, AnnexKeys);               \
+  BENCHMARK_CAPTURE(f, punctuated, PunctuatedNames);    \
+  BENCHMARK_CAPTURE(f, percent, PercentNames);          \
+  BENCHMARK_CAPTURE(f, deep, DeepPaths);                \
+  BENCHMARK_CAPTURE(f, utf8, Utf8Names)
+
+SCOVILLE_BENCHMARK_CORPORA(BM_Encode);
+SCOVILLE_BENCHMARK_CORPORA(BM_EncodeTo);
+SCOVILLE_BENCHMARK_CORPORA(BM_Decode);
+SCOVILLE_BENCHMARK_CORPORA(BM_DecodeTo);
+SCOVILLE_BENCHMARK_CORPORA(BM_CachedEncodeTo);
+
+#undef SCOVILLE_BENCHMARK_CORPORA
+
+}  // namespace
+}  // namespace scoville
+
+BENCHMARK_MAIN();
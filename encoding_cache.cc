@@ -0,0 +1,135 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#include "encoding_cache.h"
+
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <string>
+
+#include <absl/hash/hash.h>
+#include <absl/strings/string_view.h>
+#include <glog/logging.h>
+
+#include "encoding.h"
+
+namespace scoville {
+
+constexpr size_t Memo::kShards;
+
+Memo::Memo(const Function f, const size_t max_entries)
+    : f_(f),
+      max_entries_per_shard_((max_entries + kShards - 1) / kShards),
+      hits_(0),
+      misses_(0) {}
+
+size_t Memo::operator()(const absl::string_view in, char* const out,
+                        const size_t out_size) {
+  if (max_entries_per_shard_ == 0) {
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return f_(in, out, out_size);
+  }
+
+  Shard& shard = ShardFor(in);
+  {
+    std::lock_guard<std::mutex> lock(shard.mu);
+    const auto it = shard.entries.find(in);
+    if (it != shard.entries.end()) {
+      hits_.fetch_add(1, std::memory_order_relaxed);
+      const std::string& result = it->second;
+      if (out_size <= result.size()) {
+        return std::string::npos;
+      }
+      std::memcpy(out, result.c_str(), result.size() + 1);
+      return result.size();
+    }
+  }
+
+  // Compute the result outside the lock.  Two threads may race to compute the
+  // same value, but they'll both get the same answer.
+  misses_.fetch_add(1, std::memory_order_relaxed);
+  const size_t result = f_(in, out, out_size);
+  if (result == std::string::npos) {
+    return result;
+  }
+
+  std::lock_guard<std::mutex> lock(shard.mu);
+  if (shard.entries.size() >= max_entries_per_shard_) {
+    shard.entries.clear();
+  }
+  shard.entries.emplace(in, absl::string_view(out, result));
+  return result;
+}
+
+Memo::Shard& Memo::ShardFor(const absl::string_view in) {
+  // flat_hash_map takes its control bytes from the low bits of the hash, so
+  // pick the shard with the high bits.  Otherwise every key in a shard would
+  // share those bits, and lookups would probe more false matches.
+  const size_t hash = absl::Hash<absl::string_view>()(in);
+  return shards_[(hash >> (std::numeric_limits<size_t>::digits - 8)) % kShards];
+}
+
+EncodingCache::EncodingCache(const size_t max_entries)
+    : encodings_(EncodeComponentTo, max_entries),
+      decodings_(scoville::DecodeTo, max_entries) {}
+
+size_t EncodingCache::EncodeTo(const absl::string_view path, char* const out,
+                               const size_t out_size) {
+  size_t length = 0;
+  for (size_t start = 0;;) {
+    const size_t slash = path.find('/', start);
+    const size_t encoded = encodings_(path.substr(start, slash - start),
+                                      out + length, out_size - length);
+    if (encoded == std::string::npos) {
+      return encoded;
+    }
+    length += encoded;
+    if (slash == absl::string_view::npos) {
+      break;
+    }
+    // Overwrite the NUL terminator with the slash.  There's guaranteed to be
+    // room for another byte after it, but not necessarily for the next
+    // component, so check again on the next iteration.
+    out[length++] = '/';
+    if (length == out_size) {
+      return std::string::npos;
+    }
+    out[length] = '\0';
+    start = slash + 1;
+  }
+  VLOG(1) << "Encode: \"" << path << "\" -> \"" << out << "\"";
+  return length;
+}
+
+size_t EncodingCache::DecodeTo(const absl::string_view name, char* const out,
+                               const size_t out_size) {
+  return decodings_(name, out, out_size);
+}
+
+std::string EncodingCache::Encode(const absl::string_view path) {
+  // Each byte encodes to at most three.
+  std::string result(path.size() * 3 + 1, '\0');
+  result.resize(EncodeTo(path, &result[0], result.size()));
+  return result;
+}
+
+std::string EncodingCache::Decode(const absl::string_view name) {
+  // Decoding never lengthens a name.
+  std::string result(name.size() + 1, '\0');
+  result.resize(DecodeTo(name, &result[0], result.size()));
+  return result;
+}
+
+}  // namespace scoville
@@ -0,0 +1,103 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#ifndef ENCODING_CACHE_H_
+#define ENCODING_CACHE_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include <absl/container/flat_hash_map.h>
+#include <absl/strings/string_view.h>
+
+namespace scoville {
+
+// A bounded, thread-safe memo of a string-to-string function with the interface
+// of EncodeTo and friends.  Entries are spread across independently locked
+// shards so concurrent FUSE workers rarely contend.  When a shard fills, it is
+// simply emptied; since the memoized functions are pure and cheap to recompute,
+// this bounds memory without the bookkeeping of a true LRU.  A Memo with a
+// maximum of zero entries caches nothing.
+class Memo {
+ public:
+  using Function = size_t (*)(absl::string_view, char* out, size_t out_size);
+
+  Memo(Function, size_t max_entries);
+
+  // Calls the function, or copies its memoized result into out.  Cache hits do
+  // not allocate.
+  size_t operator()(absl::string_view, char* out, size_t out_size);
+
+  std::uint64_t hits() const noexcept { return hits_.load(); }
+  std::uint64_t misses() const noexcept { return misses_.load(); }
+
+ private:
+  static constexpr size_t kShards = 16;
+
+  struct Shard {
+    std::mutex mu;
+    absl::flat_hash_map<std::string, std::string> entries;
+  };
+
+  Memo(const Memo&) = delete;
+  Memo(Memo&&) = delete;
+
+  void operator=(const Memo&) = delete;
+  void operator=(Memo&&) = delete;
+
+  Shard& ShardFor(absl::string_view);
+
+  const Function f_;
+  const size_t max_entries_per_shard_;
+  std::array<Shard, kShards> shards_;
+
+  std::atomic<std::uint64_t> hits_;
+  std::atomic<std::uint64_t> misses_;
+};
+
+// Caches the results of Encode and Decode.  Encodings are cached per path
+// component, so paths that share a parent share the cached encoding of that
+// parent.
+class EncodingCache {
+ public:
+  explicit EncodingCache(size_t max_entries);
+
+  // Like EncodeTo and DecodeTo in encoding.h.
+  size_t EncodeTo(absl::string_view path, char* out, size_t out_size);
+  size_t DecodeTo(absl::string_view name, char* out, size_t out_size);
+
+  // Convenience versions of the above which allocate their results.
+  std::string Encode(absl::string_view path);
+  std::string Decode(absl::string_view name);
+
+  const Memo& encodings() const noexcept { return encodings_; }
+  const Memo& decodings() const noexcept { return decodings_; }
+
+ private:
+  EncodingCache(const EncodingCache&) = delete;
+  EncodingCache(EncodingCache&&) = delete;
+
+  void operator=(const EncodingCache&) = delete;
+  void operator=(EncodingCache&&) = delete;
+
+  Memo encodings_;
+  Memo decodings_;
+};
+
+}  // namespace scoville
+
+#endif  // ENCODING_CACHE_H_
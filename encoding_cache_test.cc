@@ -0,0 +1,91 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#include "encoding_cache.h"
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "encoding.h"
+
+namespace scoville {
+namespace {
+
+TEST(ScovilleEncodingCacheTest, EncodesLikeEncode) {
+  EncodingCache cache(64);
+  for (const char* path :
+       {"", "/", "foo", "/foo?/bar:", "/foo./bar ", "/100%/done"}) {
+    EXPECT_EQ(cache.Encode(path), Encode(path));
+    // Look each path up twice to make sure hits return the same thing.
+    EXPECT_EQ(cache.Encode(path), Encode(path));
+  }
+}
+
+TEST(ScovilleEncodingCacheTest, DecodesLikeDecode) {
+  EncodingCache cache(64);
+  for (const char* name : {"", "foo", "foo%3f", "foo%2e", "100%%"}) {
+    EXPECT_EQ(cache.Decode(name), Decode(name));
+    EXPECT_EQ(cache.Decode(name), Decode(name));
+  }
+}
+
+TEST(ScovilleEncodingCacheTest, SharesComponents) {
+  EncodingCache cache(64);
+  cache.Encode("/a/b/c");
+  EXPECT_EQ(cache.encodings().hits(), 0);
+  EXPECT_EQ(cache.encodings().misses(), 4);
+  cache.Encode("/a/b/d");
+  EXPECT_EQ(cache.encodings().hits(), 3);
+  EXPECT_EQ(cache.encodings().misses(), 5);
+}
+
+TEST(ScovilleEncodingCacheTest, DoesNotCacheFailures) {
+  EncodingCache cache(64);
+  EXPECT_THROW(cache.Decode("foo%"), DecodingFailure);
+  EXPECT_THROW(cache.Decode("foo%"), DecodingFailure);
+  EXPECT_EQ(cache.decodings().hits(), 0);
+}
+
+TEST(ScovilleEncodingCacheTest, RefusesToOverflowBuffers) {
+  EncodingCache cache(64);
+  char buffer[8];
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_EQ(cache.EncodeTo("/a/b/cd", buffer, sizeof(buffer)), 7);
+    EXPECT_STREQ(buffer, "/a/b/cd");
+    EXPECT_EQ(cache.EncodeTo("/a/b/cde", buffer, sizeof(buffer)),
+              std::string::npos);
+    EXPECT_EQ(cache.EncodeTo("/a/b/c/", buffer, sizeof(buffer)), 7);
+    EXPECT_EQ(cache.EncodeTo("/a/b/cd/", buffer, sizeof(buffer)),
+              std::string::npos);
+  }
+}
+
+TEST(ScovilleEncodingCacheTest, CanBeDisabled) {
+  EncodingCache cache(0);
+  EXPECT_EQ(cache.Encode("/foo?"), "/foo%3f");
+  EXPECT_EQ(cache.Encode("/foo?"), "/foo%3f");
+  EXPECT_EQ(cache.encodings().hits(), 0);
+}
+
+TEST(ScovilleEncodingCacheTest, StaysCorrectWhenFull) {
+  EncodingCache cache(1);
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(cache.Encode("/foo?"), "/foo%3f");
+    EXPECT_EQ(cache.Encode("/bar:"), "/bar%3a");
+  }
+}
+
+}  // namespace
+}  // namespace scoville
@@ -14,6 +14,8 @@
 
 #include "encoding.h"
 
+#include <string>
+
 #include <absl/strings/str_format.h>
 #include <gtest/gtest.h>
 
@@ -59,6 +61,118 @@ TEST(ScovilleEncodingTest, EncodesDirectoryTrailingBadCharacters) {
   EXPECT_EQ(Encode("foo /bar"), "foo%20/bar");
 }
 
+// The encoder scans long names in blocks, so make sure bad characters are
+// caught at every position within and across block boundaries.
+TEST(ScovilleEncodingTest, EncodesBadCharactersAnywhereInLongNames) {
+  for (size_t i = 0; i < 100; ++i) {
+    std::string in(100, 'a');
+    in[i] = '?';
+    std::string expected(in);
+    expected.replace(i, 1, "%3f");
+    EXPECT_EQ(Encode(in), expected) << "bad character at " << i;
+  }
+}
+
+TEST(ScovilleEncodingTest, EncodesTrailingBadCharactersInLongNames) {
+  for (size_t i = 1; i < 100; ++i) {
+    std::string in(100, 'a');
+    in[i - 1] = '.';
+    in[i] = '/';
+    std::string expected(in);
+    expected.replace(i - 1, 1, "%2e");
+    EXPECT_EQ(Encode(in), expected) << "slash at " << i;
+  }
+  EXPECT_EQ(Encode(std::string(99, 'a') + " "), std::string(99, 'a') + "%20");
+}
+
+TEST(ScovilleEncodingTest, LeavesHighBytesAlone) {
+  const std::string in = "/Sigur R\xc3\xb3s/\xc3\x81g\xc3\xa6tis "
+                         "byrjun/01 Intro.flac";
+  EXPECT_EQ(Encode(in), in);
+}
+
+TEST(ScovilleEncodingTest, EncodesIntoBuffers) {
+  char buffer[16];
+  EXPECT_EQ(EncodeTo("/foo?/bar", buffer, sizeof(buffer)), 11);
+  EXPECT_STREQ(buffer, "/foo%3f/bar");
+  EXPECT_EQ(EncodeTo("", buffer, sizeof(buffer)), 0);
+  EXPECT_STREQ(buffer, "");
+}
+
+TEST(ScovilleEncodingTest, RefusesToOverflowBuffers) {
+  char buffer[8];
+  EXPECT_EQ(EncodeTo("1234567", buffer, sizeof(buffer)), 7);
+  EXPECT_EQ(EncodeTo("12345678", buffer, sizeof(buffer)), std::string::npos);
+  EXPECT_EQ(EncodeTo("12345?", buffer, sizeof(buffer)), std::string::npos);
+  EXPECT_EQ(EncodeTo("", buffer, 0), std::string::npos);
+}
+
+// Selects a profile until the end of the scope, then goes back to VFAT.
+class ScopedProfile {
+ public:
+  explicit ScopedProfile(const Profile profile) { SetProfile(profile); }
+  ~ScopedProfile() { SetProfile(Profile::kVfat); }
+
+ private:
+  ScopedProfile(const ScopedProfile&) = delete;
+  ScopedProfile(ScopedProfile&&) = delete;
+
+  void operator=(const ScopedProfile&) = delete;
+  void operator=(ScopedProfile&&) = delete;
+};
+
+TEST(ScovilleEncodingTest, ParsesProfiles) {
+  Profile profile;
+  ASSERT_TRUE(ParseProfile("exfat", &profile));
+  EXPECT_EQ(profile, Profile::kExfat);
+  ASSERT_TRUE(ParseProfile("posix", &profile));
+  EXPECT_EQ(profile, Profile::kPosix);
+  EXPECT_FALSE(ParseProfile("hfs", &profile));
+}
+
+TEST(ScovilleEncodingTest, ExfatKeepsTrailingSpaces) {
+  ScopedProfile profile(Profile::kExfat);
+  EXPECT_EQ(Encode("foo /bar "), "foo /bar ");
+  EXPECT_EQ(Encode("foo./bar."), "foo%2e/bar%2e");
+  EXPECT_EQ(Encode("foo?bar"), "foo%3fbar");
+}
+
+TEST(ScovilleEncodingTest, NtfsEncodesReservedNames) {
+  ScopedProfile profile(Profile::kNtfs);
+  EXPECT_EQ(Encode("CON"), "%43ON");
+  EXPECT_EQ(Encode("con.txt"), "%63on.txt");
+  EXPECT_EQ(Encode("foo/Lpt1/bar"), "foo/%4cpt1/bar");
+  EXPECT_EQ(Encode("COM9"), "%43OM9");
+  EXPECT_EQ(Encode("COM9?"), "COM9%3f");
+  EXPECT_EQ(EncodeComponent("aux"), "%61ux");
+  EXPECT_EQ(Encode("COM0/CONSOLE/NUL_"), "COM0/CONSOLE/NUL_");
+  EXPECT_EQ(Encode("foo."), "foo%2e");
+  EXPECT_EQ(Decode(Encode("PRN.log")), "PRN.log");
+}
+
+TEST(ScovilleEncodingTest, NtfsEncodesReservedNamesWithTrailingSpaces) {
+  ScopedProfile profile(Profile::kNtfs);
+  EXPECT_EQ(Encode("CON .txt"), "%43ON .txt");
+  EXPECT_EQ(Encode("foo/NUL  .log"), "foo/%4eUL  .log");
+  EXPECT_EQ(Encode(" CON.txt"), " CON.txt");
+  EXPECT_EQ(Decode(Encode("aux .c")), "aux .c");
+}
+
+TEST(ScovilleEncodingTest, NtfsEncodesConsoleBufferNames) {
+  ScopedProfile profile(Profile::kNtfs);
+  EXPECT_EQ(Encode("CONIN$"), "%43ONIN$");
+  EXPECT_EQ(Encode("conout$.txt"), "%63onout$.txt");
+  EXPECT_EQ(Encode("CONIN"), "CONIN");
+  EXPECT_EQ(Encode("CONERR$"), "CONERR$");
+}
+
+TEST(ScovilleEncodingTest, PosixEncodesOnlyPercent) {
+  ScopedProfile profile(Profile::kPosix);
+  EXPECT_EQ(Encode("foo?*:/bar. "), "foo?*:/bar. ");
+  EXPECT_EQ(Encode("foo%bar/%"), "foo%%bar/%%");
+  EXPECT_EQ(EncodeComponent("a|%"), "a|%%");
+}
+
 TEST(ScovilleDecodingTest, DecodesEmptyToEmpty) { EXPECT_EQ(Decode(""), ""); }
 
 TEST(ScovilleDecodingTest, DecodesBadCharacters) {
@@ -89,6 +203,19 @@ TEST(ScovilleDecodingTest, DecodesTrailingBadCharacters) {
   EXPECT_EQ(Decode("foo%20"), "foo ");
 }
 
+TEST(ScovilleDecodingTest, DecodesIntoBuffers) {
+  char buffer[8];
+  EXPECT_EQ(DecodeTo("foo%3f", buffer, sizeof(buffer)), 4);
+  EXPECT_STREQ(buffer, "foo?");
+  EXPECT_EQ(DecodeTo("foobarbaz", buffer, sizeof(buffer)), std::string::npos);
+}
+
+TEST(ScovilleDecodingTest, RejectsMalformedEscapes) {
+  EXPECT_THROW(Decode("foo%"), DecodingFailure);
+  EXPECT_THROW(Decode("foo%2"), DecodingFailure);
+  EXPECT_THROW(Decode("foo%zzbar"), DecodingFailure);
+}
+
 TEST(ScovilleDecodingTest, DecodesDirectoryTrailingBadCharacters) {
   EXPECT_EQ(Decode("foo%2e/bar"), "foo./bar");
   EXPECT_EQ(Decode("foo%20/bar"), "foo /bar");
@@ -15,7 +15,17 @@
 #ifndef FUSE_H_
 #define FUSE_H_
 
+// Scoville builds against FUSE 2 by default.  Define SCOVILLE_FUSE3 to build
+// the high-level backend against FUSE 3 instead; code that differs between the
+// two checks FUSE_USE_VERSION.
+#ifdef SCOVILLE_FUSE3
+#define FUSE_USE_VERSION 31
+#include <fuse3/fuse.h>
+#include <fuse3/fuse_lowlevel.h>
+#else
 #define FUSE_USE_VERSION 26
 #include <fuse/fuse.h>
+#include <fuse/fuse_lowlevel.h>
+#endif
 
 #endif  // FUSE_H_
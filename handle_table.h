@@ -0,0 +1,189 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#ifndef HANDLE_TABLE_H_
+#define HANDLE_TABLE_H_
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace scoville {
+
+// Objects behind FUSE file handles.
+//
+// Objects live in slots carved out of slabs of kSlabSlots, which are allocated
+// as the table grows and never freed or moved, so opening and releasing a
+// handle doesn't allocate once the table has room.  A released slot goes on a
+// free list for reuse.
+//
+// A handle is the slot's index in its low 32 bits and the slot's generation in
+// its high 32 bits.  The generation changes every time the slot is filled or
+// emptied, so a handle that has already been released, or that never came from
+// the table, is detected rather than followed.  Handles are never zero.
+//
+// Thread-safe, except that using a handle concurrently with erasing it is
+// undefined, as it would be for a pointer.
+template <typename T>
+class HandleTable {
+ public:
+  // Preallocates the first slab.
+  HandleTable() {
+    std::lock_guard<std::mutex> lock(mu_);
+    AddSlab();
+  }
+
+  // Destroys any objects still in the table.
+  virtual ~HandleTable() noexcept {
+    for (size_t i = 0; i < slab_count_; ++i) {
+      Slot* const slab = slabs_[i].load(std::memory_order_relaxed);
+      for (size_t j = 0; j < kSlabSlots; ++j) {
+        if (slab[j].generation.load(std::memory_order_relaxed) % 2 == 1) {
+          Object(&slab[j])->~T();
+        }
+      }
+      delete[] slab;
+    }
+  }
+
+  // Constructs a T from the arguments and returns its handle.  Throws
+  // std::system_error with EMFILE if the table is full.
+  template <typename... Args>
+  std::uint64_t Emplace(Args&&... args) {
+    std::uint32_t index;
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      if (free_.empty()) {
+        AddSlab();
+      }
+      index = free_.back();
+      free_.pop_back();
+      ++size_;
+    }
+    Slot& slot = SlotAt(index);
+    try {
+      new (&slot.storage) T(std::forward<Args>(args)...);
+    } catch (...) {
+      Free(index);
+      throw;
+    }
+    const std::uint32_t generation =
+        slot.generation.load(std::memory_order_relaxed) + 1;
+    slot.generation.store(generation, std::memory_order_release);
+    return (static_cast<std::uint64_t>(generation) << 32) | (index + 1);
+  }
+
+  // Looks up the object with the given handle.  Throws std::system_error with
+  // EBADF if the handle is stale or bogus.
+  T& Get(const std::uint64_t handle) const {
+    return *Object(&Find(handle));
+  }
+
+  // Destroys the object with the given handle, freeing the slot for reuse.
+  // Throws std::system_error with EBADF if the handle is stale or bogus.
+  void Erase(const std::uint64_t handle) {
+    Slot& slot = Find(handle);
+    slot.generation.fetch_add(1, std::memory_order_acq_rel);
+    Object(&slot)->~T();
+    Free(static_cast<std::uint32_t>(handle) - 1);
+  }
+
+  // The number of objects in the table.
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return size_;
+  }
+
+ private:
+  static constexpr size_t kSlabSlots = 256;
+  static constexpr size_t kMaxSlabs = 4096;
+
+  struct Slot {
+    // Odd while the slot holds an object.
+    std::atomic<std::uint32_t> generation{0};
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+  };
+
+  HandleTable(const HandleTable&) = delete;
+  HandleTable(HandleTable&&) = delete;
+
+  void operator=(const HandleTable&) = delete;
+  void operator=(HandleTable&&) = delete;
+
+  static T* Object(Slot* const slot) noexcept {
+    return reinterpret_cast<T*>(&slot->storage);
+  }
+
+  Slot& SlotAt(const std::uint32_t index) const noexcept {
+    return slabs_[index / kSlabSlots].load(std::memory_order_acquire)
+        [index % kSlabSlots];
+  }
+
+  Slot& Find(const std::uint64_t handle) const {
+    const std::uint64_t index = (handle & 0xffffffff) - 1;
+    if (index >= kSlabSlots * kMaxSlabs ||
+        slabs_[index / kSlabSlots].load(std::memory_order_acquire) ==
+            nullptr) {
+      throw std::system_error(EBADF, std::system_category());
+    }
+    Slot& slot = SlotAt(static_cast<std::uint32_t>(index));
+    const std::uint32_t generation =
+        slot.generation.load(std::memory_order_acquire);
+    if (generation % 2 == 0 || generation != handle >> 32) {
+      throw std::system_error(EBADF, std::system_category());
+    }
+    return slot;
+  }
+
+  // Returns the slot to the free list.
+  void Free(const std::uint32_t index) {
+    std::lock_guard<std::mutex> lock(mu_);
+    free_.push_back(index);
+    --size_;
+  }
+
+  // Requires mu_.
+  void AddSlab() {
+    if (slab_count_ == kMaxSlabs) {
+      throw std::system_error(EMFILE, std::system_category());
+    }
+    free_.reserve((slab_count_ + 1) * kSlabSlots);
+    slabs_[slab_count_].store(new Slot[kSlabSlots],
+                              std::memory_order_release);
+    // Hand out low indices first, so the table stays dense.
+    for (size_t i = kSlabSlots; i > 0; --i) {
+      free_.push_back(
+          static_cast<std::uint32_t>(slab_count_ * kSlabSlots + i - 1));
+    }
+    ++slab_count_;
+  }
+
+  mutable std::mutex mu_;
+  std::array<std::atomic<Slot*>, kMaxSlabs> slabs_ = {};
+  size_t slab_count_ = 0;  // guarded by mu_
+  std::vector<std::uint32_t> free_;  // guarded by mu_
+  size_t size_ = 0;  // guarded by mu_
+};
+
+}  // namespace scoville
+
+#endif  // HANDLE_TABLE_H_
@@ -0,0 +1,91 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#include "handle_table.h"
+
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace scoville {
+namespace {
+
+TEST(ScovilleHandleTableTest, StoresObjects) {
+  HandleTable<std::string> table;
+  const std::uint64_t hello = table.Emplace("hello");
+  const std::uint64_t world = table.Emplace(5, 'w');
+  EXPECT_NE(hello, 0);
+  EXPECT_NE(world, 0);
+  EXPECT_NE(hello, world);
+  EXPECT_EQ(table.Get(hello), "hello");
+  EXPECT_EQ(table.Get(world), "wwwww");
+  EXPECT_EQ(table.size(), 2);
+  table.Erase(hello);
+  EXPECT_EQ(table.size(), 1);
+}
+
+TEST(ScovilleHandleTableTest, RejectsStaleHandles) {
+  HandleTable<std::string> table;
+  const std::uint64_t stale = table.Emplace("stale");
+  table.Erase(stale);
+  // The slot is reused, but under a different generation.
+  const std::uint64_t fresh = table.Emplace("fresh");
+  EXPECT_EQ(stale & 0xffffffff, fresh & 0xffffffff);
+  EXPECT_NE(stale, fresh);
+  EXPECT_THROW(table.Get(stale), std::system_error);
+  EXPECT_THROW(table.Erase(stale), std::system_error);
+  EXPECT_EQ(table.Get(fresh), "fresh");
+
+  EXPECT_THROW(table.Get(0), std::system_error);
+  EXPECT_THROW(table.Get(fresh + 1), std::system_error);
+  EXPECT_THROW(table.Get(std::uint64_t{1} << 40 | 1 << 30),
+               std::system_error);
+}
+
+TEST(ScovilleHandleTableTest, Grows) {
+  HandleTable<std::unique_ptr<int>> table;
+  std::vector<std::uint64_t> handles;
+  for (int i = 0; i < 1000; ++i) {
+    handles.push_back(table.Emplace(new int(i)));
+  }
+  EXPECT_EQ(std::set<std::uint64_t>(handles.begin(), handles.end()).size(),
+            1000);
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_EQ(*table.Get(handles[i]), i);
+  }
+  // The remaining objects are destroyed with the table.
+  for (int i = 0; i < 1000; i += 2) {
+    table.Erase(handles[i]);
+  }
+  EXPECT_EQ(table.size(), 500);
+}
+
+struct Throws {
+  Throws() { throw std::runtime_error("oops"); }
+};
+
+TEST(ScovilleHandleTableTest, ReclaimsSlotsWhenConstructionFails) {
+  HandleTable<Throws> table;
+  EXPECT_THROW(table.Emplace(), std::runtime_error);
+  EXPECT_EQ(table.size(), 0);
+}
+
+}  // namespace
+}  // namespace scoville
@@ -0,0 +1,495 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#include "io_uring.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace scoville {
+
+namespace {
+
+bool IsTransfer(const std::uint8_t opcode) noexcept {
+  return opcode == IORING_OP_READ || opcode == IORING_OP_WRITE ||
+         opcode == IORING_OP_READ_FIXED || opcode == IORING_OP_WRITE_FIXED;
+}
+
+bool IsRead(const std::uint8_t opcode) noexcept {
+  return opcode == IORING_OP_READ || opcode == IORING_OP_READ_FIXED;
+}
+
+void* MapRing(const int fd, const size_t bytes, const off_t offset) {
+  return mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+              MAP_SHARED | MAP_POPULATE, fd, offset);
+}
+
+template <typename T>
+T* At(void* const base, const std::uint32_t offset) noexcept {
+  return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+timespec Timespec(const statx_timestamp& timestamp) noexcept {
+  timespec result;
+  result.tv_sec = timestamp.tv_sec;
+  result.tv_nsec = timestamp.tv_nsec;
+  return result;
+}
+
+struct stat StatFromStatx(const struct statx& in) noexcept {
+  struct stat result;
+  std::memset(&result, 0, sizeof(result));
+  result.st_dev = makedev(in.stx_dev_major, in.stx_dev_minor);
+  result.st_ino = in.stx_ino;
+  result.st_mode = in.stx_mode;
+  result.st_nlink = in.stx_nlink;
+  result.st_uid = in.stx_uid;
+  result.st_gid = in.stx_gid;
+  result.st_rdev = makedev(in.stx_rdev_major, in.stx_rdev_minor);
+  result.st_size = static_cast<off_t>(in.stx_size);
+  result.st_blksize = in.stx_blksize;
+  result.st_blocks = static_cast<blkcnt_t>(in.stx_blocks);
+  result.st_atim = Timespec(in.stx_atime);
+  result.st_mtim = Timespec(in.stx_mtime);
+  result.st_ctim = Timespec(in.stx_ctime);
+  return result;
+}
+
+}  // namespace
+
+// One operation, from submission until its callback has run.
+struct IoUring::Request {
+  Request(const std::uint8_t opcode, const int fd) {
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = opcode;
+    sqe.fd = fd;
+    sqe.user_data = reinterpret_cast<std::uintptr_t>(this);
+  }
+
+  io_uring_sqe sqe;
+
+  // For reads and writes, the buffer, its size, how much of it the kernel has
+  // transferred so far, and the index of the registered buffer it lives in, if
+  // any.
+  char* data = nullptr;
+  size_t size = 0;
+  size_t transferred = 0;
+  int buffer_index = -1;
+  std::unique_ptr<char[]> own_buffer;
+
+  // Arguments the kernel reads or writes after submission.
+  std::string path;
+  std::string new_path;
+  struct statx stats;
+
+  std::function<void(Request&, int result)> callback;
+};
+
+IoUring* IoUring::Create(const unsigned entries, const size_t buffers,
+                         const size_t buffer_bytes) {
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  const int fd =
+      static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+  if (fd == -1) {
+    PLOG(WARNING) << "io_uring unavailable";
+    return nullptr;
+  }
+  std::unique_ptr<IoUring> ring(new IoUring);
+  ring->fd_ = fd;
+  ring->entries_ = params.sq_entries;
+
+  ring->sq_ring_bytes_ =
+      params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_ring_bytes_ =
+      params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  ring->sqes_bytes_ = params.sq_entries * sizeof(io_uring_sqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    ring->sq_ring_bytes_ = ring->cq_ring_bytes_ =
+        std::max(ring->sq_ring_bytes_, ring->cq_ring_bytes_);
+  }
+  void* const sq_ring = MapRing(fd, ring->sq_ring_bytes_, IORING_OFF_SQ_RING);
+  if (sq_ring == MAP_FAILED) {
+    PLOG(WARNING) << "could not map io_uring submission queue";
+    return nullptr;
+  }
+  ring->sq_ring_ = sq_ring;
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    ring->cq_ring_ = sq_ring;
+  } else {
+    void* const cq_ring =
+        MapRing(fd, ring->cq_ring_bytes_, IORING_OFF_CQ_RING);
+    if (cq_ring == MAP_FAILED) {
+      PLOG(WARNING) << "could not map io_uring completion queue";
+      return nullptr;
+    }
+    ring->cq_ring_ = cq_ring;
+  }
+  void* const sqes = MapRing(fd, ring->sqes_bytes_, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    PLOG(WARNING) << "could not map io_uring submission queue entries";
+    return nullptr;
+  }
+  ring->sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+  ring->sq_tail_ = At<unsigned>(ring->sq_ring_, params.sq_off.tail);
+  ring->sq_mask_ = *At<unsigned>(ring->sq_ring_, params.sq_off.ring_mask);
+  ring->sq_array_ = At<unsigned>(ring->sq_ring_, params.sq_off.array);
+  ring->cq_head_ = At<unsigned>(ring->cq_ring_, params.cq_off.head);
+  ring->cq_tail_ = At<unsigned>(ring->cq_ring_, params.cq_off.tail);
+  ring->cq_mask_ = *At<unsigned>(ring->cq_ring_, params.cq_off.ring_mask);
+  ring->cqes_ = At<io_uring_cqe>(ring->cq_ring_, params.cq_off.cqes);
+
+  // Find out which operations the kernel supports.  Kernels too old to answer
+  // also lack IORING_OP_READ and IORING_OP_WRITE.
+  std::vector<char> probe_memory(sizeof(io_uring_probe) +
+                                 256 * sizeof(io_uring_probe_op));
+  auto* const probe = reinterpret_cast<io_uring_probe*>(probe_memory.data());
+  if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) ==
+      -1) {
+    PLOG(WARNING) << "could not probe io_uring operations";
+    return nullptr;
+  }
+  for (unsigned i = 0; i < probe->ops_len; ++i) {
+    if (probe->ops[i].flags & IO_URING_OP_SUPPORTED) {
+      ring->supported_.set(probe->ops[i].op);
+    }
+  }
+  for (const std::uint8_t opcode :
+       {IORING_OP_NOP, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_READ_FIXED,
+        IORING_OP_WRITE_FIXED}) {
+    if (!ring->Supports(opcode)) {
+      LOG(WARNING) << "io_uring lacks operation " << static_cast<int>(opcode);
+      return nullptr;
+    }
+  }
+
+  // Without registered buffers, every read and write allocates its own, which
+  // is slower but still correct.
+  if (buffers != 0 && buffer_bytes != 0) {
+    ring->buffer_memory_.resize(buffers * buffer_bytes);
+    std::vector<iovec> iovecs(buffers);
+    for (size_t i = 0; i < buffers; ++i) {
+      iovecs[i].iov_base = &ring->buffer_memory_[i * buffer_bytes];
+      iovecs[i].iov_len = buffer_bytes;
+    }
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS,
+                iovecs.data(), static_cast<unsigned>(buffers)) == -1) {
+      PLOG(WARNING) << "could not register io_uring buffers";
+      ring->buffer_memory_.clear();
+    } else {
+      ring->buffer_bytes_ = buffer_bytes;
+      for (size_t i = buffers; i > 0; --i) {
+        ring->free_buffers_.push_back(static_cast<int>(i - 1));
+      }
+    }
+  }
+
+  IoUring* const result = ring.get();
+  ring->completion_thread_ = std::thread([result] { result->Complete(); });
+  return ring.release();
+}
+
+IoUring::~IoUring() noexcept {
+  if (completion_thread_.joinable()) {
+    {
+      std::unique_lock<std::mutex> lock(in_flight_mu_);
+      room_.wait(lock, [this] { return in_flight_ == 0; });
+    }
+    try {
+      Submit(nullptr);
+      completion_thread_.join();
+    } catch (const std::system_error& e) {
+      LOG(ERROR) << "could not stop io_uring completion thread: " << e.what();
+      completion_thread_.detach();
+    }
+  }
+  if (sqes_ != nullptr) {
+    munmap(sqes_, sqes_bytes_);
+  }
+  if (cq_ring_ != nullptr && cq_ring_ != sq_ring_) {
+    munmap(cq_ring_, cq_ring_bytes_);
+  }
+  if (sq_ring_ != nullptr) {
+    munmap(sq_ring_, sq_ring_bytes_);
+  }
+  if (close(fd_) == -1) {
+    PLOG(ERROR) << "failed to close io_uring";
+  }
+}
+
+void IoUring::Read(const int fd, const off_t offset, const size_t bytes,
+                   std::function<void(int, const char*)> done) {
+  std::unique_ptr<Request> request(new Request(IORING_OP_READ, fd));
+  AttachBuffer(bytes, request.get());
+  request->sqe.off = static_cast<std::uint64_t>(offset);
+  request->callback = [done = std::move(done)](Request& finished,
+                                               const int result) {
+    done(result, finished.data);
+  };
+  Start(std::move(request));
+}
+
+void IoUring::Write(const int fd, const off_t offset, const void* const data,
+                    const size_t bytes, Callback done) {
+  std::unique_ptr<Request> request(new Request(IORING_OP_WRITE, fd));
+  AttachBuffer(bytes, request.get());
+  std::memcpy(request->data, data, bytes);
+  request->sqe.off = static_cast<std::uint64_t>(offset);
+  request->callback = [done = std::move(done)](Request&, const int result) {
+    done(result);
+  };
+  Start(std::move(request));
+}
+
+bool IoUring::Statx(const int directory, const char* const path,
+                    const int flags,
+                    std::function<void(int, const struct stat&)> done) {
+  if (!Supports(IORING_OP_STATX)) {
+    return false;
+  }
+  std::unique_ptr<Request> request(new Request(IORING_OP_STATX, directory));
+  request->path = path;
+  request->sqe.addr = reinterpret_cast<std::uintptr_t>(request->path.c_str());
+  request->sqe.len = STATX_BASIC_STATS;
+  request->sqe.addr2 = reinterpret_cast<std::uintptr_t>(&request->stats);
+  request->sqe.statx_flags = static_cast<std::uint32_t>(flags);
+  request->callback = [done = std::move(done)](Request& finished,
+                                               const int result) {
+    done(result, StatFromStatx(finished.stats));
+  };
+  Start(std::move(request));
+  return true;
+}
+
+bool IoUring::OpenAt(const int directory, const char* const path,
+                     const int flags, const mode_t mode, Callback done) {
+  if (!Supports(IORING_OP_OPENAT)) {
+    return false;
+  }
+  std::unique_ptr<Request> request(new Request(IORING_OP_OPENAT, directory));
+  request->path = path;
+  request->sqe.addr = reinterpret_cast<std::uintptr_t>(request->path.c_str());
+  request->sqe.len = mode;
+  request->sqe.open_flags = static_cast<std::uint32_t>(flags);
+  request->callback = [done = std::move(done)](Request&, const int result) {
+    done(result);
+  };
+  Start(std::move(request));
+  return true;
+}
+
+bool IoUring::RenameAt(const int old_directory, const char* const old_path,
+                       const int new_directory, const char* const new_path,
+                       Callback done) {
+  if (!Supports(IORING_OP_RENAMEAT)) {
+    return false;
+  }
+  std::unique_ptr<Request> request(
+      new Request(IORING_OP_RENAMEAT, old_directory));
+  request->path = old_path;
+  request->new_path = new_path;
+  request->sqe.addr = reinterpret_cast<std::uintptr_t>(request->path.c_str());
+  request->sqe.len = static_cast<std::uint32_t>(new_directory);
+  request->sqe.addr2 =
+      reinterpret_cast<std::uintptr_t>(request->new_path.c_str());
+  request->callback = [done = std::move(done)](Request&, const int result) {
+    done(result);
+  };
+  Start(std::move(request));
+  return true;
+}
+
+bool IoUring::UnlinkAt(const int directory, const char* const path,
+                       const int flags, Callback done) {
+  if (!Supports(IORING_OP_UNLINKAT)) {
+    return false;
+  }
+  std::unique_ptr<Request> request(new Request(IORING_OP_UNLINKAT, directory));
+  request->path = path;
+  request->sqe.addr = reinterpret_cast<std::uintptr_t>(request->path.c_str());
+  request->sqe.unlink_flags = static_cast<std::uint32_t>(flags);
+  request->callback = [done = std::move(done)](Request&, const int result) {
+    done(result);
+  };
+  Start(std::move(request));
+  return true;
+}
+
+void IoUring::AttachBuffer(const size_t bytes, Request* const request) {
+  request->size = bytes;
+  if (bytes <= buffer_bytes_) {
+    std::lock_guard<std::mutex> lock(free_buffers_mu_);
+    if (!free_buffers_.empty()) {
+      request->buffer_index = free_buffers_.back();
+      free_buffers_.pop_back();
+    }
+  }
+  if (request->buffer_index == -1) {
+    request->own_buffer.reset(new char[bytes]);
+    request->data = request->own_buffer.get();
+  } else {
+    request->data =
+        &buffer_memory_[static_cast<size_t>(request->buffer_index) *
+                        buffer_bytes_];
+    request->sqe.opcode = IsRead(request->sqe.opcode) ? IORING_OP_READ_FIXED
+                                                      : IORING_OP_WRITE_FIXED;
+    request->sqe.buf_index = static_cast<std::uint16_t>(request->buffer_index);
+  }
+  request->sqe.addr = reinterpret_cast<std::uintptr_t>(request->data);
+  request->sqe.len = static_cast<std::uint32_t>(bytes);
+}
+
+void IoUring::Start(std::unique_ptr<Request> request) {
+  {
+    std::unique_lock<std::mutex> lock(in_flight_mu_);
+    room_.wait(lock, [this] { return in_flight_ < entries_; });
+    ++in_flight_;
+  }
+  try {
+    Submit(request.get());
+  } catch (...) {
+    Retire(std::move(request));
+    throw;
+  }
+  // The completion thread owns it now.
+  request.release();
+}
+
+void IoUring::Submit(const Request* const request) {
+  std::lock_guard<std::mutex> lock(submit_mu_);
+  // Every entry is submitted as soon as it's queued, so the kernel has already
+  // consumed everything before the tail, and the slot at the tail is free.
+  const unsigned tail = *sq_tail_;
+  const unsigned index = tail & sq_mask_;
+  if (request == nullptr) {
+    std::memset(&sqes_[index], 0, sizeof(sqes_[index]));
+    sqes_[index].opcode = IORING_OP_NOP;
+  } else {
+    sqes_[index] = request->sqe;
+  }
+  sq_array_[index] = index;
+  __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+  while (Enter(1, 0, 0) == -1) {
+    if (errno != EINTR) {
+      const int error = errno;
+      // The kernel consumed nothing, so the entry can be taken back.
+      __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+      throw std::system_error(error, std::system_category(), "io_uring_enter");
+    }
+  }
+}
+
+void IoUring::Retire(std::unique_ptr<Request> request) noexcept {
+  if (request->buffer_index != -1) {
+    std::lock_guard<std::mutex> lock(free_buffers_mu_);
+    free_buffers_.push_back(request->buffer_index);
+  }
+  request.reset();
+  {
+    std::lock_guard<std::mutex> lock(in_flight_mu_);
+    --in_flight_;
+  }
+  room_.notify_all();
+}
+
+void IoUring::Complete() noexcept {
+  for (;;) {
+    if (Enter(0, 1, IORING_ENTER_GETEVENTS) == -1 && errno != EINTR) {
+      PLOG(FATAL) << "io_uring_enter";
+    }
+    unsigned head = *cq_head_;
+    const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    bool stop = false;
+    for (; head != tail; ++head) {
+      const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+      const std::uint64_t user_data = cqe.user_data;
+      const int result = cqe.res;
+      // Hand the slot back before running the callback, which may take a
+      // while.
+      __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+      if (user_data == 0) {
+        stop = true;
+      } else {
+        Finish(reinterpret_cast<Request*>(user_data), result);
+      }
+    }
+    if (stop) {
+      return;
+    }
+  }
+}
+
+void IoUring::Finish(Request* const raw_request, int result) noexcept {
+  std::unique_ptr<Request> request(raw_request);
+  if (IsTransfer(request->sqe.opcode)) {
+    if (result > 0) {
+      request->transferred += static_cast<size_t>(result);
+      if (request->transferred < request->size) {
+        // A short transfer.  Submit the rest, reusing the room the request
+        // already has.
+        request->sqe.addr += static_cast<std::uint64_t>(result);
+        request->sqe.len -= static_cast<std::uint32_t>(result);
+        request->sqe.off += static_cast<std::uint64_t>(result);
+        try {
+          Submit(request.get());
+          request.release();
+          return;
+        } catch (const std::system_error& e) {
+          LOG(ERROR) << "could not continue short transfer: " << e.what();
+        }
+      }
+    }
+    // Report partial success in preference to an error.
+    if (request->transferred > 0) {
+      result = static_cast<int>(request->transferred);
+    }
+  }
+  try {
+    request->callback(*request, result);
+  } catch (...) {
+    // Nothing here knows how to answer whoever was waiting on the operation.
+    LOG(ERROR) << "io_uring callback threw";
+  }
+  Retire(std::move(request));
+}
+
+int IoUring::Enter(const unsigned to_submit, const unsigned min_complete,
+                   const unsigned flags) noexcept {
+  return static_cast<int>(syscall(__NR_io_uring_enter, fd_, to_submit,
+                                  min_complete, flags, nullptr, 0));
+}
+
+}  // namespace scoville
@@ -0,0 +1,180 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#ifndef IO_URING_H_
+#define IO_URING_H_
+
+#include <bitset>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace scoville {
+
+// An io_uring(7) instance, through which file system calls can be made
+// asynchronously.  Operations are submitted as they're requested, and a
+// dedicated thread waits for them to finish and runs their callbacks, so a
+// few threads can keep many operations in flight.
+//
+// Reads and writes go through a pool of buffers registered with the kernel,
+// which saves it from mapping the pages on every operation.  Requests that
+// don't fit in a registered buffer, or that arrive while every buffer is in
+// use, get a buffer of their own.
+//
+// Callbacks receive results as the kernel reports them: nonnegative on
+// success, or a negated errno value on failure.  They run on the completion
+// thread, so they mustn't block, and they mustn't start new operations, which
+// could wait forever for the completion thread to make room.  Nor should they
+// throw: the ring can only log and drop the exception, so callers have to
+// handle errors, such as by answering the request that started the
+// operation, in the callback itself.
+//
+// Thread-safe.
+class IoUring {
+ public:
+  using Callback = std::function<void(int result)>;
+
+  // Sets up a ring that allows up to the specified number of operations in
+  // flight at once and registers the specified number of buffers, each
+  // buffer_bytes long.  Returns null, having logged why, if the kernel can't
+  // provide io_uring or lacks the read and write operations.  Starts a thread.
+  static IoUring* Create(unsigned entries, size_t buffers,
+                         size_t buffer_bytes);
+
+  // Waits for outstanding operations to finish and stops the completion
+  // thread.
+  ~IoUring() noexcept;
+
+  // Reads up to the specified number of bytes at the offset, stopping short
+  // only at the end of the file.  data is valid only until the callback
+  // returns.
+  void Read(int fd, off_t, size_t,
+            std::function<void(int result, const char* data)>);
+
+  // Writes the specified bytes at the offset.  The data is copied before Write
+  // returns, so the caller may reuse it immediately.
+  void Write(int fd, off_t, const void* data, size_t, Callback);
+
+  // The remaining operations mirror the system calls of the same names, except
+  // that paths are copied before the functions return.  Each returns false,
+  // without calling the callback, if the kernel doesn't support the operation
+  // through io_uring; the caller should make the system call itself instead.
+
+  // Unlike statx(2), produces a struct stat.
+  bool Statx(int directory, const char* path, int flags,
+             std::function<void(int result, const struct stat&)>);
+
+  // On success, the callback takes ownership of the resulting file
+  // descriptor.
+  bool OpenAt(int directory, const char* path, int flags, mode_t, Callback);
+
+  bool RenameAt(int old_directory, const char* old_path, int new_directory,
+                const char* new_path, Callback);
+
+  bool UnlinkAt(int directory, const char* path, int flags, Callback);
+
+ private:
+  struct Request;
+
+  IoUring() = default;
+
+  IoUring(const IoUring&) = delete;
+  IoUring(IoUring&&) = delete;
+
+  void operator=(const IoUring&) = delete;
+  void operator=(IoUring&&) = delete;
+
+  bool Supports(std::uint8_t opcode) const noexcept {
+    return supported_[opcode];
+  }
+
+  // Gives the request a buffer of at least the specified size.
+  void AttachBuffer(size_t, Request*);
+
+  // Blocks until there's room for another operation in flight, then submits
+  // the request.  If submission fails, throws std::system_error, and the
+  // callback is never called.
+  void Start(std::unique_ptr<Request>);
+
+  // Places the request, for which room is already reserved, on the submission
+  // queue and tells the kernel about it.  A null request stops the completion
+  // thread.
+  void Submit(const Request*);
+
+  // Frees the request and the room it took up.
+  void Retire(std::unique_ptr<Request>) noexcept;
+
+  // Body of the completion thread.
+  void Complete() noexcept;
+
+  // Finishes one operation, or submits the rest of a partial read or write.
+  void Finish(Request*, int result) noexcept;
+
+  // Wraps io_uring_enter(2).
+  int Enter(unsigned to_submit, unsigned min_complete,
+            unsigned flags) noexcept;
+
+  int fd_ = -1;
+  unsigned entries_ = 0;
+  std::bitset<256> supported_;
+
+  // The rings and the submission queue entries, shared with the kernel.
+  void* sq_ring_ = nullptr;
+  size_t sq_ring_bytes_ = 0;
+  void* cq_ring_ = nullptr;
+  size_t cq_ring_bytes_ = 0;
+  io_uring_sqe* sqes_ = nullptr;
+  size_t sqes_bytes_ = 0;
+
+  unsigned* sq_tail_ = nullptr;
+  unsigned sq_mask_ = 0;
+  unsigned* sq_array_ = nullptr;
+  unsigned* cq_head_ = nullptr;
+  unsigned* cq_tail_ = nullptr;
+  unsigned cq_mask_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+
+  // Serializes writes to the submission queue.
+  std::mutex submit_mu_;
+
+  // The number of operations submitted but not yet finished, which is kept
+  // at or below entries_ so the completion queue can never overflow.
+  std::mutex in_flight_mu_;
+  std::condition_variable room_;
+  unsigned in_flight_ = 0;
+
+  // The registered buffers, or empty if registration failed, and the indices
+  // of those not in use.
+  size_t buffer_bytes_ = 0;
+  std::vector<char> buffer_memory_;
+  std::mutex free_buffers_mu_;
+  std::vector<int> free_buffers_;
+
+  std::thread completion_thread_;
+};
+
+}  // namespace scoville
+
+#endif  // IO_URING_H_
@@ -0,0 +1,156 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#include "io_uring.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <future>
+#include <memory>
+#include <string>
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "posix_extras.h"
+#include "test_util.h"
+
+namespace scoville {
+namespace {
+
+class ScovilleIoUringTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ring_.reset(IoUring::Create(8, 2, 16));
+    if (ring_ == nullptr) {
+      GTEST_SKIP() << "io_uring unavailable";
+    }
+    directory_.reset(
+        new File(temporary_.path().c_str(), O_RDONLY | O_DIRECTORY));
+  }
+
+  // Writes the data to the file and waits for the result.
+  int Write(const File& file, const off_t offset, const std::string& data) {
+    std::promise<int> result;
+    ring_->Write(file.fd(), offset, data.data(), data.size(),
+                 [&result](const int written) { result.set_value(written); });
+    return result.get_future().get();
+  }
+
+  // Reads from the file and waits for the result.
+  std::string Read(const File& file, const off_t offset, const size_t bytes) {
+    std::promise<std::string> result;
+    ring_->Read(file.fd(), offset, bytes,
+                [&result](const int read, const char* const data) {
+                  result.set_value(read < 0 ? "error"
+                                            : std::string(data, read));
+                });
+    return result.get_future().get();
+  }
+
+  TemporaryDirectory temporary_{"io_uring_test"};
+  std::unique_ptr<IoUring> ring_;
+  std::unique_ptr<File> directory_;
+};
+
+TEST_F(ScovilleIoUringTest, ReadsWhatWasWritten) {
+  const File file = directory_->OpenAt("file", O_RDWR | O_CREAT, 0644);
+  EXPECT_EQ(Write(file, 0, "hello"), 5);
+  EXPECT_EQ(Write(file, 5, ", world"), 7);
+  EXPECT_EQ(Read(file, 0, 12), "hello, world");
+  // Reads stop short at the end of the file.
+  EXPECT_EQ(Read(file, 7, 100), "world");
+}
+
+TEST_F(ScovilleIoUringTest, LargeTransfersGetTheirOwnBuffers) {
+  const File file = directory_->OpenAt("file", O_RDWR | O_CREAT, 0644);
+  const std::string data(1000, 'x');
+  EXPECT_EQ(Write(file, 0, data), 1000);
+  EXPECT_EQ(Read(file, 0, 1000), data);
+}
+
+TEST_F(ScovilleIoUringTest, WaitsForRoomInTheRing) {
+  const File file = directory_->OpenAt("file", O_RDWR | O_CREAT, 0644);
+  std::atomic<int> written(0);
+  for (int i = 0; i < 100; ++i) {
+    ring_->Write(file.fd(), i, "x", 1, [&written](const int result) {
+      written.fetch_add(result);
+    });
+  }
+  // Destroying the ring waits for outstanding operations.
+  ring_.reset();
+  EXPECT_EQ(written.load(), 100);
+  EXPECT_EQ(file.Stat().st_size, 100);
+}
+
+TEST_F(ScovilleIoUringTest, ReportsErrors) {
+  const File file = directory_->OpenAt("file", O_RDONLY | O_CREAT, 0644);
+  EXPECT_EQ(Write(file, 0, "hello"), -EBADF);
+}
+
+TEST_F(ScovilleIoUringTest, ManagesFiles) {
+  std::promise<int> opened;
+  ASSERT_TRUE(ring_->OpenAt(directory_->fd(), "file", O_WRONLY | O_CREAT,
+                            0600, [&opened](const int fd) {
+                              opened.set_value(fd);
+                            }));
+  const int fd = opened.get_future().get();
+  ASSERT_GE(fd, 0);
+  close(fd);
+
+  std::promise<struct stat> stats;
+  ASSERT_TRUE(ring_->Statx(directory_->fd(), "file", AT_SYMLINK_NOFOLLOW,
+                           [&stats](int, const struct stat& result) {
+                             stats.set_value(result);
+                           }));
+  const struct stat expected = directory_->LinkStatAt("file");
+  const struct stat actual = stats.get_future().get();
+  EXPECT_EQ(actual.st_ino, expected.st_ino);
+  EXPECT_EQ(actual.st_dev, expected.st_dev);
+  EXPECT_EQ(actual.st_mode, expected.st_mode);
+
+  std::promise<int> renamed;
+  ASSERT_TRUE(ring_->RenameAt(
+      directory_->fd(), "file", directory_->fd(), "renamed",
+      [&renamed](const int result) { renamed.set_value(result); }));
+  EXPECT_EQ(renamed.get_future().get(), 0);
+
+  std::promise<int> unlinked;
+  ASSERT_TRUE(ring_->UnlinkAt(
+      directory_->fd(), "renamed", 0,
+      [&unlinked](const int result) { unlinked.set_value(result); }));
+  EXPECT_EQ(unlinked.get_future().get(), 0);
+  struct stat ignored;
+  EXPECT_FALSE(directory_->TryLinkStatAt("renamed", &ignored));
+}
+
+TEST_F(ScovilleIoUringTest, StatsPathDescriptors) {
+  const File file = directory_->OpenAt("file", O_WRONLY | O_CREAT, 0644);
+  const File path = directory_->OpenAt("file", O_PATH | O_NOFOLLOW);
+  std::promise<int> done;
+  ino_t inode = 0;
+  ASSERT_TRUE(ring_->Statx(path.fd(), "", AT_EMPTY_PATH | AT_SYMLINK_NOFOLLOW,
+                           [&](const int result, const struct stat& stats) {
+                             inode = stats.st_ino;
+                             done.set_value(result);
+                           }));
+  EXPECT_EQ(done.get_future().get(), 0);
+  EXPECT_EQ(inode, file.Stat().st_ino);
+}
+
+}  // namespace
+}  // namespace scoville
@@ -0,0 +1,651 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#include "low_level_operations.h"
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "directory_listing.h"
+#include "encoding_cache.h"
+#include "fuse.h"
+#include "handle_table.h"
+#include "io_uring.h"
+#include "posix_extras.h"
+
+DECLARE_uint64(encoding_cache_entries);
+DECLARE_uint64(readdir_snapshot_entries);
+DECLARE_double(kernel_cache_timeout);
+DECLARE_double(kernel_negative_timeout);
+DECLARE_bool(io_uring);
+DECLARE_uint64(io_uring_entries);
+DECLARE_uint64(io_uring_buffers);
+
+namespace scoville {
+
+namespace {
+
+using InodeKey = std::pair<dev_t, ino_t>;
+
+// An inode the kernel has looked up.  We hold an O_PATH file descriptor to it
+// until the kernel forgets it, so operations on it never need to walk a path.
+struct Inode {
+  Inode(File file_in, const InodeKey& key_in)
+      : file(std::move(file_in)), key(key_in) {}
+
+  File file;
+  const InodeKey key;
+
+  // The number of times the kernel has looked this inode up and not yet
+  // forgotten it.  Guarded by the mutex of the inode's shard.
+  std::uint64_t lookups = 0;
+};
+
+// The inode corresponding to the directory underlying the mount point.  The
+// kernel never looks it up or forgets it, so it lives outside the table.
+Inode* root_inode_;
+
+// Memoized versions of Encode and Decode.
+EncodingCache* encoding_cache_;
+
+// Open files and directories, by FUSE file handle.
+HandleTable<File>* file_handles_;
+HandleTable<DirectoryListing>* directory_handles_;
+
+// Makes I/O asynchronous, or null if --io_uring is off or the kernel doesn't
+// support it.  When set, handlers for the operations it covers submit their
+// work and return; the ring's completion thread replies to the kernel.
+IoUring* io_uring_ = nullptr;
+
+// The largest read or write FUSE sends.  Larger requests would still work, but
+// without the benefit of a registered buffer.
+constexpr size_t kIoUringBufferBytes = 128 * 1024;
+
+// Every inode the kernel currently knows about, keyed by device and inode
+// number so repeated lookups of the same file share an entry.  The table is
+// split into independently locked shards, so lookups and forgets on different
+// threads rarely contend.
+struct InodeShard {
+  std::mutex mu;
+  std::map<InodeKey, std::unique_ptr<Inode>> inodes;
+};
+
+constexpr size_t kInodeShards = 16;
+
+std::array<InodeShard, kInodeShards>* inode_shards_;
+
+InodeShard& ShardFor(const InodeKey& key) noexcept {
+  return (*inode_shards_)[key.second % kInodeShards];
+}
+
+// A name from FUSE, encoded.  The encoding lives inline, so constructing one
+// does not allocate.
+class EncodedName {
+ public:
+  explicit EncodedName(const char* const name) {
+    if (encoding_cache_->EncodeTo(name, encoded_, sizeof(encoded_)) ==
+        std::string::npos) {
+      throw std::system_error(ENAMETOOLONG, std::system_category());
+    }
+  }
+
+  const char* c_str() const noexcept { return encoded_; }
+
+ private:
+  EncodedName(const EncodedName&) = delete;
+  EncodedName(EncodedName&&) = delete;
+
+  void operator=(const EncodedName&) = delete;
+  void operator=(EncodedName&&) = delete;
+
+  char encoded_[NAME_MAX + 1];
+};
+
+Inode& GetInode(const fuse_ino_t ino) {
+  if (ino == FUSE_ROOT_ID) {
+    return *root_inode_;
+  }
+  // This reinterpret_cast violates type aliasing rules, so a compiler may
+  // invoke undefined behavior when the result is dereferenced.  However, we
+  // compile with -fno-strict-aliasing, so it should be safe.
+  return *reinterpret_cast<Inode*>(ino);
+}
+
+fuse_ino_t InodeNumber(Inode* const inode) {
+  if (inode == root_inode_) {
+    return FUSE_ROOT_ID;
+  }
+  static_assert(sizeof(fuse_ino_t) == sizeof(std::uintptr_t),
+                "FUSE inode numbers are a different size than pointers");
+  return reinterpret_cast<std::uintptr_t>(inode);
+}
+
+// Looks up name in parent, registers the result in the inode table, and fills
+// in the entry to return to the kernel.
+fuse_entry_param LookUpEntry(Inode& parent, const char* const name) {
+  File file = parent.file.OpenAt(EncodedName(name).c_str(),
+                                 O_PATH | O_NOFOLLOW);
+
+  fuse_entry_param result;
+  std::memset(&result, 0, sizeof(result));
+  result.attr = file.Stat();
+  result.attr_timeout = FLAGS_kernel_cache_timeout;
+  result.entry_timeout = FLAGS_kernel_cache_timeout;
+
+  const InodeKey key(result.attr.st_dev, result.attr.st_ino);
+  InodeShard& shard = ShardFor(key);
+  std::lock_guard<std::mutex> lock(shard.mu);
+  std::unique_ptr<Inode>& inode = shard.inodes[key];
+  if (!inode) {
+    inode.reset(new Inode(std::move(file), key));
+  }
+  ++inode->lookups;
+  result.ino = InodeNumber(inode.get());
+  return result;
+}
+
+// Drops lookups references to the inode, removing it from the table once the
+// kernel has forgotten it entirely.
+void ForgetInode(const fuse_ino_t ino, const std::uint64_t lookups) noexcept {
+  if (ino == FUSE_ROOT_ID) {
+    return;
+  }
+  Inode& inode = GetInode(ino);
+  std::unique_ptr<Inode> doomed;
+  {
+    InodeShard& shard = ShardFor(inode.key);
+    std::lock_guard<std::mutex> lock(shard.mu);
+    inode.lookups -= lookups;
+    if (inode.lookups == 0) {
+      auto it = shard.inodes.find(inode.key);
+      doomed = std::move(it->second);
+      shard.inodes.erase(it);
+    }
+  }
+  // doomed closes its file descriptor here, outside the lock.
+}
+
+// Answers the request with an error describing the exception being handled.
+void ReplyCurrentException(fuse_req_t request) noexcept {
+  try {
+    throw;
+  } catch (const std::system_error& e) {
+    fuse_reply_err(request, e.code().value());
+  } catch (const std::bad_alloc&) {
+    fuse_reply_err(request, ENOMEM);
+  } catch (...) {
+    LOG(ERROR) << "caught unexpected value";
+    fuse_reply_err(request, ENOTRECOVERABLE);
+  }
+}
+
+// Wraps an io_uring callback for the request.  The ring can't answer the
+// request itself, so if the callback throws, this does.
+template <typename Callback>
+auto CatchAndReplyCallbackExceptions(fuse_req_t request, Callback callback) {
+  return [request, callback](const auto&... args) mutable noexcept {
+    try {
+      callback(args...);
+    } catch (...) {
+      ReplyCurrentException(request);
+    }
+  };
+}
+
+// Callbacks that pass io_uring results on to the kernel.
+IoUring::Callback ReplyError(fuse_req_t request) {
+  return CatchAndReplyCallbackExceptions(request, [request](const int result) {
+    fuse_reply_err(request, result < 0 ? -result : 0);
+  });
+}
+
+IoUring::Callback ReplyWrite(fuse_req_t request) {
+  return CatchAndReplyCallbackExceptions(request, [request](const int result) {
+    if (result < 0) {
+      fuse_reply_err(request, -result);
+    } else {
+      fuse_reply_write(request, static_cast<size_t>(result));
+    }
+  });
+}
+
+// Hands the file to the kernel as a new file handle.
+void ReplyOpen(fuse_req_t request, File file,
+               fuse_file_info* const file_info) {
+  file_info->fh = file_handles_->Emplace(std::move(file));
+  if (fuse_reply_open(request, file_info) != 0) {
+    file_handles_->Erase(file_info->fh);
+  }
+}
+
+void Initialize(void*, fuse_conn_info*) {
+  // The ring starts a thread, so it can't be created until FUSE has
+  // daemonized.
+  if (FLAGS_io_uring) {
+    io_uring_ = IoUring::Create(static_cast<unsigned>(FLAGS_io_uring_entries),
+                                FLAGS_io_uring_buffers, kIoUringBufferBytes);
+    if (io_uring_ == nullptr) {
+      LOG(WARNING) << "falling back to synchronous system calls";
+    }
+  }
+}
+
+void Forget(fuse_req_t request, const fuse_ino_t ino,
+            const unsigned long lookups) noexcept {
+  ForgetInode(ino, lookups);
+  fuse_reply_none(request);
+}
+
+void ForgetMulti(fuse_req_t request, const size_t count,
+                 fuse_forget_data* const forgets) noexcept {
+  for (size_t i = 0; i < count; ++i) {
+    ForgetInode(forgets[i].ino, forgets[i].nlookup);
+  }
+  fuse_reply_none(request);
+}
+
+void Lookup(fuse_req_t request, const fuse_ino_t parent,
+            const char* const name) {
+  fuse_entry_param entry;
+  try {
+    entry = LookUpEntry(GetInode(parent), name);
+  } catch (const std::system_error& e) {
+    if (e.code().value() != ENOENT || FLAGS_kernel_negative_timeout <= 0) {
+      throw;
+    }
+    // An entry with inode number 0 tells the kernel to cache the name's
+    // absence.
+    std::memset(&entry, 0, sizeof(entry));
+    entry.entry_timeout = FLAGS_kernel_negative_timeout;
+  }
+  fuse_reply_entry(request, &entry);
+}
+
+void Getattr(fuse_req_t request, const fuse_ino_t ino, fuse_file_info*) {
+  const File& file = GetInode(ino).file;
+  if (io_uring_ != nullptr &&
+      io_uring_->Statx(
+          file.fd(), "", AT_EMPTY_PATH | AT_SYMLINK_NOFOLLOW,
+          CatchAndReplyCallbackExceptions(
+              request, [request](const int result, const struct stat& stats) {
+                if (result < 0) {
+                  fuse_reply_err(request, -result);
+                } else {
+                  fuse_reply_attr(request, &stats, FLAGS_kernel_cache_timeout);
+                }
+              }))) {
+    return;
+  }
+  const struct stat stats = file.Stat();
+  fuse_reply_attr(request, &stats, FLAGS_kernel_cache_timeout);
+}
+
+void Setattr(fuse_req_t request, const fuse_ino_t ino,
+             struct stat* const attributes, const int to_set,
+             fuse_file_info* const file_info) {
+  const File& file = GetInode(ino).file;
+
+  if (to_set & FUSE_SET_ATTR_MODE) {
+    file.ChMod(attributes->st_mode);
+  }
+
+  if (to_set & FUSE_SET_ATTR_SIZE) {
+    if (file_info) {
+      file_handles_->Get(file_info->fh).Truncate(attributes->st_size);
+    } else {
+      file.Reopen(O_WRONLY).Truncate(attributes->st_size);
+    }
+  }
+
+  if (to_set & (FUSE_SET_ATTR_ATIME | FUSE_SET_ATTR_MTIME)) {
+    timespec access = {0, UTIME_OMIT};
+    timespec modification = {0, UTIME_OMIT};
+    if (to_set & FUSE_SET_ATTR_ATIME_NOW) {
+      access.tv_nsec = UTIME_NOW;
+    } else if (to_set & FUSE_SET_ATTR_ATIME) {
+      access = attributes->st_atim;
+    }
+    if (to_set & FUSE_SET_ATTR_MTIME_NOW) {
+      modification.tv_nsec = UTIME_NOW;
+    } else if (to_set & FUSE_SET_ATTR_MTIME) {
+      modification = attributes->st_mtim;
+    }
+    file.UTimeNs(access, modification);
+  }
+
+  const struct stat stats = file.Stat();
+  fuse_reply_attr(request, &stats, FLAGS_kernel_cache_timeout);
+}
+
+void Readlink(fuse_req_t request, fuse_ino_t) {
+  fuse_reply_err(request, EINVAL);
+}
+
+void Mknod(fuse_req_t request, const fuse_ino_t parent_ino,
+           const char* const name, const mode_t mode, const dev_t dev) {
+  Inode& parent = GetInode(parent_ino);
+  parent.file.MkNod(EncodedName(name).c_str(), mode, dev);
+  const fuse_entry_param entry = LookUpEntry(parent, name);
+  fuse_reply_entry(request, &entry);
+}
+
+void Mkdir(fuse_req_t request, const fuse_ino_t parent_ino,
+           const char* const name, const mode_t mode) {
+  Inode& parent = GetInode(parent_ino);
+  parent.file.MkDir(EncodedName(name).c_str(), mode);
+  const fuse_entry_param entry = LookUpEntry(parent, name);
+  fuse_reply_entry(request, &entry);
+}
+
+void Unlink(fuse_req_t request, const fuse_ino_t parent,
+            const char* const name) {
+  const File& directory = GetInode(parent).file;
+  const EncodedName encoded(name);
+  if (io_uring_ != nullptr &&
+      io_uring_->UnlinkAt(directory.fd(), encoded.c_str(), 0,
+                          ReplyError(request))) {
+    return;
+  }
+  directory.UnlinkAt(encoded.c_str());
+  fuse_reply_err(request, 0);
+}
+
+void Rmdir(fuse_req_t request, const fuse_ino_t parent,
+           const char* const name) {
+  const File& directory = GetInode(parent).file;
+  const EncodedName encoded(name);
+  if (io_uring_ != nullptr &&
+      io_uring_->UnlinkAt(directory.fd(), encoded.c_str(), AT_REMOVEDIR,
+                          ReplyError(request))) {
+    return;
+  }
+  directory.RmDirAt(encoded.c_str());
+  fuse_reply_err(request, 0);
+}
+
+void Symlink(fuse_req_t request, const char*, fuse_ino_t, const char*) {
+  fuse_reply_err(request, EPERM);
+}
+
+void Rename(fuse_req_t request, const fuse_ino_t old_parent,
+            const char* const old_name, const fuse_ino_t new_parent,
+            const char* const new_name) {
+  const File& old_directory = GetInode(old_parent).file;
+  const File& new_directory = GetInode(new_parent).file;
+  const EncodedName old_encoded(old_name);
+  const EncodedName new_encoded(new_name);
+  if (io_uring_ != nullptr &&
+      io_uring_->RenameAt(old_directory.fd(), old_encoded.c_str(),
+                          new_directory.fd(), new_encoded.c_str(),
+                          ReplyError(request))) {
+    return;
+  }
+  old_directory.RenameAt(old_encoded.c_str(), new_directory,
+                         new_encoded.c_str());
+  fuse_reply_err(request, 0);
+}
+
+void Open(fuse_req_t request, const fuse_ino_t ino,
+          fuse_file_info* const file_info) {
+  const File& inode = GetInode(ino).file;
+  if (io_uring_ != nullptr) {
+    // file_info only lives as long as this call, so the callback gets a copy.
+    fuse_file_info info = *file_info;
+    // As in File::Reopen, the path is a symbolic link, so O_NOFOLLOW would
+    // make this fail.
+    if (io_uring_->OpenAt(
+            AT_FDCWD, inode.ReopenPath().c_str(),
+            file_info->flags & ~O_NOFOLLOW, 0,
+            // ReplyOpen throws if the handle table is full.
+            CatchAndReplyCallbackExceptions(
+                request, [request, info](const int fd) mutable {
+                  if (fd < 0) {
+                    fuse_reply_err(request, -fd);
+                  } else {
+                    ReplyOpen(request, File::Adopt(fd), &info);
+                  }
+                }))) {
+      return;
+    }
+  }
+  ReplyOpen(request, inode.Reopen(file_info->flags), file_info);
+}
+
+void Create(fuse_req_t request, const fuse_ino_t parent_ino,
+            const char* const name, const mode_t mode,
+            fuse_file_info* const file_info) {
+  Inode& parent = GetInode(parent_ino);
+  File file = parent.file.OpenAt(EncodedName(name).c_str(),
+                                 file_info->flags | O_CREAT, mode);
+  const fuse_entry_param entry = LookUpEntry(parent, name);
+  // If the kernel never hears about the entry, it won't forget it either, so
+  // drop the lookup ourselves.
+  try {
+    file_info->fh = file_handles_->Emplace(std::move(file));
+  } catch (...) {
+    ForgetInode(entry.ino, 1);
+    throw;
+  }
+  if (fuse_reply_create(request, &entry, file_info) != 0) {
+    file_handles_->Erase(file_info->fh);
+    ForgetInode(entry.ino, 1);
+  }
+}
+
+void Read(fuse_req_t request, fuse_ino_t, const size_t bytes,
+          const off_t offset, fuse_file_info* const file_info) {
+  const File* const file = &file_handles_->Get(file_info->fh);
+
+  if (io_uring_ != nullptr) {
+    io_uring_->Read(
+        file->fd(), offset, bytes,
+        CatchAndReplyCallbackExceptions(
+            request, [request](const int result, const char* const data) {
+              if (result < 0) {
+                fuse_reply_err(request, -result);
+              } else {
+                fuse_reply_buf(request, data, static_cast<size_t>(result));
+              }
+            }));
+    return;
+  }
+
+  // As in the high-level read_buf, hand FUSE the file descriptor and let it
+  // splice the data into the kernel.
+  fuse_bufvec buffer;
+  std::memset(&buffer, 0, sizeof(buffer));
+  buffer.count = 1;
+  buffer.buf[0].size = bytes;
+  buffer.buf[0].flags =
+      static_cast<fuse_buf_flags>(FUSE_BUF_IS_FD | FUSE_BUF_FD_SEEK);
+  buffer.buf[0].fd = file->fd();
+  buffer.buf[0].pos = offset;
+  fuse_reply_data(request, &buffer, FUSE_BUF_SPLICE_MOVE);
+}
+
+void Write(fuse_req_t request, fuse_ino_t, const char* const buffer,
+           const size_t bytes, const off_t offset,
+           fuse_file_info* const file_info) {
+  File* const file = &file_handles_->Get(file_info->fh);
+  if (io_uring_ != nullptr) {
+    io_uring_->Write(file->fd(), offset, buffer, bytes, ReplyWrite(request));
+    return;
+  }
+  fuse_reply_write(request, file->Write(offset, buffer, bytes));
+}
+
+void WriteBuf(fuse_req_t request, fuse_ino_t, fuse_bufvec* const input,
+              const off_t offset, fuse_file_info* const file_info) {
+  File* const file = &file_handles_->Get(file_info->fh);
+  if (io_uring_ != nullptr && input->count == 1 &&
+      !(input->buf[0].flags & FUSE_BUF_IS_FD)) {
+    io_uring_->Write(file->fd(), offset, input->buf[0].mem, input->buf[0].size,
+                     ReplyWrite(request));
+    return;
+  }
+  fuse_bufvec output;
+  std::memset(&output, 0, sizeof(output));
+  output.count = 1;
+  output.buf[0].size = fuse_buf_size(input);
+  output.buf[0].flags =
+      static_cast<fuse_buf_flags>(FUSE_BUF_IS_FD | FUSE_BUF_FD_SEEK);
+  output.buf[0].fd = file->fd();
+  output.buf[0].pos = offset;
+  const ssize_t written =
+      fuse_buf_copy(&output, input, FUSE_BUF_SPLICE_NONBLOCK);
+  if (written < 0) {
+    fuse_reply_err(request, static_cast<int>(-written));
+  } else {
+    fuse_reply_write(request, static_cast<size_t>(written));
+  }
+}
+
+void Release(fuse_req_t request, fuse_ino_t,
+             fuse_file_info* const file_info) {
+  file_handles_->Erase(file_info->fh);
+  fuse_reply_err(request, 0);
+}
+
+void Opendir(fuse_req_t request, const fuse_ino_t ino,
+             fuse_file_info* const file_info) {
+  file_info->fh = directory_handles_->Emplace(
+      GetInode(ino).file.Reopen(O_RDONLY | O_DIRECTORY), encoding_cache_,
+      FLAGS_readdir_snapshot_entries);
+  if (fuse_reply_open(request, file_info) != 0) {
+    directory_handles_->Erase(file_info->fh);
+  }
+}
+
+void Readdir(fuse_req_t request, fuse_ino_t, const size_t size,
+             const off_t offset, fuse_file_info* const file_info) {
+  DirectoryListing* const directory = &directory_handles_->Get(file_info->fh);
+
+  if (offset != directory->offset()) {
+    directory->Seek(offset);
+  }
+
+  std::vector<char> buffer(size);
+  size_t used = 0;
+  DirectoryListing::Entry entry;
+  for (long entry_offset = directory->offset(); directory->Next(&entry);
+       entry_offset = entry.next_offset) {
+    struct stat stats;
+    std::memset(&stats, 0, sizeof(stats));
+    stats.st_ino = entry.inode;
+    stats.st_mode = static_cast<mode_t>(DTTOIF(entry.type));
+    const size_t entry_size =
+        fuse_add_direntry(request, buffer.data() + used, size - used,
+                          entry.name, &stats, entry.next_offset);
+    if (entry_size > size - used) {
+      // The entry didn't fit.  Rewind so the next call returns it.
+      directory->Seek(entry_offset);
+      break;
+    }
+    used += entry_size;
+  }
+  fuse_reply_buf(request, buffer.data(), used);
+}
+
+void Releasedir(fuse_req_t request, fuse_ino_t,
+                fuse_file_info* const file_info) {
+  directory_handles_->Erase(file_info->fh);
+  fuse_reply_err(request, 0);
+}
+
+void Statfs(fuse_req_t request, const fuse_ino_t ino) {
+  const struct statvfs stats = GetInode(ino).file.StatVFs();
+  fuse_reply_statfs(request, &stats);
+}
+
+template <typename Function, Function f, typename... Args>
+void CatchAndReplyExceptions(fuse_req_t request, Args... args) noexcept {
+  try {
+    f(request, args...);
+  } catch (...) {
+    ReplyCurrentException(request);
+  }
+}
+
+}  // namespace
+
+#define CATCH_AND_REPLY_EXCEPTIONS(f) CatchAndReplyExceptions<decltype(f), f>
+
+fuse_lowlevel_ops FuseLowLevelOperations(File* const root) {
+  const struct stat root_stats = root->Stat();
+  root_inode_ = new Inode(File(*root),
+                          InodeKey(root_stats.st_dev, root_stats.st_ino));
+  inode_shards_ = new std::array<InodeShard, kInodeShards>;
+  encoding_cache_ = new EncodingCache(FLAGS_encoding_cache_entries);
+  file_handles_ = new HandleTable<File>;
+  directory_handles_ = new HandleTable<DirectoryListing>;
+
+  fuse_lowlevel_ops result;
+  std::memset(&result, 0, sizeof(result));
+
+  result.init = Initialize;
+
+  result.lookup = CATCH_AND_REPLY_EXCEPTIONS(Lookup);
+  result.forget = Forget;
+  result.forget_multi = ForgetMulti;
+
+  result.statfs = CATCH_AND_REPLY_EXCEPTIONS(Statfs);
+
+  result.getattr = CATCH_AND_REPLY_EXCEPTIONS(Getattr);
+  result.setattr = CATCH_AND_REPLY_EXCEPTIONS(Setattr);
+
+  result.mknod = CATCH_AND_REPLY_EXCEPTIONS(Mknod);
+  result.rename = CATCH_AND_REPLY_EXCEPTIONS(Rename);
+  result.create = CATCH_AND_REPLY_EXCEPTIONS(Create);
+  result.open = CATCH_AND_REPLY_EXCEPTIONS(Open);
+  result.read = CATCH_AND_REPLY_EXCEPTIONS(Read);
+  result.write = CATCH_AND_REPLY_EXCEPTIONS(Write);
+  result.write_buf = CATCH_AND_REPLY_EXCEPTIONS(WriteBuf);
+  result.release = CATCH_AND_REPLY_EXCEPTIONS(Release);
+  result.unlink = CATCH_AND_REPLY_EXCEPTIONS(Unlink);
+
+  result.symlink = CATCH_AND_REPLY_EXCEPTIONS(Symlink);
+  result.readlink = CATCH_AND_REPLY_EXCEPTIONS(Readlink);
+
+  result.mkdir = CATCH_AND_REPLY_EXCEPTIONS(Mkdir);
+  result.opendir = CATCH_AND_REPLY_EXCEPTIONS(Opendir);
+  result.readdir = CATCH_AND_REPLY_EXCEPTIONS(Readdir);
+  result.releasedir = CATCH_AND_REPLY_EXCEPTIONS(Releasedir);
+  result.rmdir = CATCH_AND_REPLY_EXCEPTIONS(Rmdir);
+
+  return result;
+}
+
+#undef CATCH_AND_REPLY_EXCEPTIONS
+
+}  // namespace scoville
@@ -0,0 +1,31 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#ifndef LOW_LEVEL_OPERATIONS_H_
+#define LOW_LEVEL_OPERATIONS_H_
+
+#include "fuse.h"
+#include "posix_extras.h"
+
+namespace scoville {
+
+// Operations for the FUSE low-level API.  Rather than resolving a full path
+// from the root on every call, these keep an open O_PATH file descriptor for
+// every inode the kernel knows about, so each operation resolves at most one
+// path component.
+fuse_lowlevel_ops FuseLowLevelOperations(File* root);
+
+}  // namespace scoville
+
+#endif  // LOW_LEVEL_OPERATIONS_H_
@@ -17,29 +17,115 @@
 
 #include "operations.h"
 
+#include <algorithm>
 #include <cerrno>
+#include <chrono>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
-#include <experimental/optional>
 #include <memory>
+#include <mutex>
 #include <new>
 #include <stdexcept>
 #include <string>
 #include <system_error>
 #include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <dirent.h>
 #include <fcntl.h>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
+#include <limits.h>
 #include <sys/stat.h>
 #include <sys/statvfs.h>
 #include <sys/types.h>
 #include <time.h>
+#include <unistd.h>
 
+#include "attribute_cache.h"
+#include "directory_cache.h"
+#include "directory_listing.h"
 #include "encoding.h"
+#include "encoding_cache.h"
 #include "fuse.h"
+#include "handle_table.h"
 #include "posix_extras.h"
+#include "readahead.h"
+#include "recording.h"
+#include "stat_prefetcher.h"
+#include "statistics.h"
+#include "tracer.h"
+#include "write_buffer.h"
+
+DEFINE_uint64(encoding_cache_entries, 1 << 16,
+              "Maximum number of encoded and decoded names to cache.  Set to 0 "
+              "to disable caching.");
+DEFINE_uint64(readdir_snapshot_entries, 0,
+              "Snapshot directories with up to this many entries when they're "
+              "opened, so reading them in pieces doesn't require seeking in "
+              "the underlying directory.  Set to 0 to always stream "
+              "directories.");
+DEFINE_uint64(attr_cache_entries, 0,
+              "Maximum number of file attributes to cache, saving stat calls "
+              "on slow underlying file systems.  Set to 0 to disable caching.");
+DEFINE_uint64(attr_cache_watches, 4096,
+              "Maximum number of directories to watch with inotify for changes "
+              "made around Scoville.  Cached attributes of files in "
+              "directories that aren't watched are dropped.");
+DEFINE_double(attr_cache_ttl, 10.0,
+              "Seconds for which cached file attributes remain valid.  Changes "
+              "made through Scoville or noticed through inotify invalidate "
+              "them sooner.");
+DEFINE_double(negative_cache_ttl, 1.0,
+              "Seconds for which to remember that a path doesn't exist, so "
+              "repeated probes for it don't reach the underlying file system.  "
+              "Shares space with the attribute cache, so it has no effect "
+              "unless --attr_cache_entries is nonzero.  Set to 0 to disable.");
+DEFINE_uint64(directory_cache_entries, 0,
+              "Maximum number of directories to hold open, so operations on "
+              "paths inside them needn't walk the full path from the root.  "
+              "Directories renamed or removed directly in the underlying file "
+              "system stay reachable at their old paths until evicted.  Set "
+              "to 0 to disable caching.");
+DEFINE_int32(stat_prefetch_threads, 0,
+             "Number of threads which stat directory entries in the "
+             "background as the directory is read, anticipating the getattr "
+             "calls that usually follow.  Requires --attr_cache_entries.");
+DEFINE_uint64(trace_buffer_entries, 0,
+              "Number of recent operations each thread remembers for "
+              "--trace_file.  Set to 0 to disable tracing.");
+DEFINE_double(slow_op_threshold_ms, 0.0,
+              "Log operations that take at least this many milliseconds.  Set "
+              "to 0 to disable.");
+DEFINE_string(trace_file, "",
+              "Where to write recent operations, in Chrome trace format, when "
+              "Scoville receives SIGUSR2.  Requires --trace_buffer_entries.  "
+              "If empty, traces aren't written.");
+DEFINE_uint64(write_buffer_bytes, 0,
+              "Coalesce sequential writes smaller than this many bytes into "
+              "aligned writes of this many bytes.  Buffered data are written "
+              "out when a write isn't sequential, when the file is flushed, "
+              "synced or closed, and before anything reads the file or its "
+              "attributes.  Set to 0 to disable buffering.");
+DEFINE_uint64(readahead_bytes, 0,
+              "When a file is read sequentially, ask the underlying file "
+              "system to read up to this many bytes ahead of the reader.  Set "
+              "to 0 to disable readahead hints.");
+DEFINE_string(record_file, "",
+              "Record every operation's arguments and timing, but not file "
+              "contents, to this file for scoville-replay.  Leave empty to "
+              "disable recording.");
+#if FUSE_USE_VERSION >= 30
+DEFINE_bool(writeback_cache, false,
+            "Let the kernel cache writes and pass them on in large batches.  "
+            "Changes made directly to the underlying file system while a "
+            "file is cached may be overwritten.");
+
+DECLARE_uint64(max_request_bytes);
+#endif
 
 namespace scoville {
 
@@ -48,149 +134,722 @@ namespace {
 // Pointer to the directory underlying the mount point.
 File* root_;
 
+// Memoized versions of Encode and Decode.
+EncodingCache* encoding_cache_;
+
+// Attributes of underlying files, keyed by relative encoded path.
+AttributeCache* attribute_cache_;
+
+// Recently used directories, keyed by relative encoded path.  Operations on
+// paths use it to resolve everything but the final component.
+DirectoryCache* directory_cache_;
+
+// Fills attribute_cache_ with the attributes of directory entries as they're
+// read.
+StatPrefetcher* stat_prefetcher_;
+
+// Counters for every operation.  This is a static object rather than a
+// pointer to a heap one, since its counters are over-aligned and operator new
+// doesn't honor that in C++14.
+Statistics statistics_;
+
+// Recent operations and slow-operation logging, or null if both are disabled.
+Tracer* tracer_;
+
+// Where to record operations, or null if recording is disabled.
+Recorder* recorder_;
+
+#if FUSE_USE_VERSION >= 30
+// Whether the kernel agreed to cache writes and to ask for attributes along
+// with directory entries.  Set in Initialize.
+bool writeback_cache_;
+bool readdirplus_;
+#endif
+
+// A synthetic, read-only file at the mount root which serves statistics_.  It
+// doesn't appear in directory listings, and operations which would change it,
+// or a real file of the same name beneath it, fail.
+constexpr char kStatisticsPath[] = "/.scoville-stats";
+
+// The text of the statistics file as of each open, so every reader sees a
+// single snapshot no matter how it reads the file.  Handles of open statistics
+// files are the snapshot's key in their high 32 bits and zero in their low 32
+// bits, which handle tables never issue.
+std::mutex statistics_snapshots_mu_;
+std::unordered_map<uint32_t, std::string>* statistics_snapshots_;
+uint32_t next_statistics_snapshot_ = 0;
+
+bool IsStatisticsFile(const char* const path) noexcept {
+  return std::strcmp(path, kStatisticsPath) == 0;
+}
+
+bool IsStatisticsHandle(const uint64_t handle) noexcept {
+  return static_cast<uint32_t>(handle) == 0;
+}
+
+struct stat StatisticsFileStat() {
+  struct stat result;
+  std::memset(&result, 0, sizeof(result));
+  result.st_mode = S_IFREG | 0444;
+  result.st_nlink = 1;
+  result.st_uid = getuid();
+  result.st_gid = getgid();
+  // The file is opened with direct_io, so the kernel reads it until we return
+  // nothing, regardless of its size.
+  result.st_size = 0;
+  result.st_atime = result.st_mtime = result.st_ctime = time(nullptr);
+  return result;
+}
+
+// Takes a snapshot of the statistics and returns a handle to it.
+uint64_t OpenStatistics() {
+  std::string text = statistics_.Format();
+  std::lock_guard<std::mutex> lock(statistics_snapshots_mu_);
+  uint32_t key;
+  do {
+    key = next_statistics_snapshot_++;
+  } while (statistics_snapshots_->count(key) != 0);
+  (*statistics_snapshots_)[key] = std::move(text);
+  return static_cast<uint64_t>(key) << 32;
+}
+
+void ReleaseStatistics(const uint64_t handle) {
+  std::lock_guard<std::mutex> lock(statistics_snapshots_mu_);
+  statistics_snapshots_->erase(static_cast<uint32_t>(handle >> 32));
+}
+
+// Copies [offset, offset + bytes) of the statistics snapshot into the buffer,
+// returning the number of bytes copied.
+size_t ReadStatistics(const uint64_t handle, const off_t offset,
+                      const size_t bytes, char* const buffer) {
+  std::lock_guard<std::mutex> lock(statistics_snapshots_mu_);
+  const auto it =
+      statistics_snapshots_->find(static_cast<uint32_t>(handle >> 32));
+  if (it == statistics_snapshots_->end()) {
+    throw std::system_error(EBADF, std::system_category());
+  }
+  const std::string& text = it->second;
+  if (offset < 0 || static_cast<size_t>(offset) >= text.size()) {
+    return 0;
+  }
+  const size_t result =
+      std::min(bytes, text.size() - static_cast<size_t>(offset));
+  std::memcpy(buffer, text.data() + offset, result);
+  return result;
+}
+
 mode_t DirectoryTypeToFileType(const unsigned char type) {
   return static_cast<mode_t>(DTTOIF(type));
 }
 
-std::string MakeRelative(const std::string& path) {
-  if (path.at(0) != '/') {
-    throw std::system_error(ENOENT, std::system_category());
+// A path from FUSE, encoded and made relative to root_.  The encoding lives
+// inline, so constructing one does not allocate.
+class EncodedPath {
+ public:
+  explicit EncodedPath(const char* const path) {
+    if (path == nullptr || path[0] != '/') {
+      throw std::system_error(ENOENT, std::system_category());
+    }
+    if (encoding_cache_->EncodeTo(path + 1, relative_, sizeof(relative_)) ==
+        std::string::npos) {
+      throw std::system_error(ENAMETOOLONG, std::system_category());
+    }
+  }
+
+  bool is_root() const noexcept { return relative_[0] == '\0'; }
+
+  // The encoded path, relative to root_.  Empty if this is the root.
+  const char* relative() const noexcept { return relative_; }
+
+ private:
+  EncodedPath(const EncodedPath&) = delete;
+  EncodedPath(EncodedPath&&) = delete;
+
+  void operator=(const EncodedPath&) = delete;
+  void operator=(EncodedPath&&) = delete;
+
+  char relative_[PATH_MAX];
+};
+
+#if FUSE_USE_VERSION >= 30
+// Asks the kernel for the features that matter for throughput, where it
+// supports them.
+void Negotiate(fuse_conn_info* const connection, fuse_config* const config) {
+  // FUSE 3 moved the flags fuse_operations used to carry here.
+  config->nullpath_ok = true;
+
+  unsigned wanted = FUSE_CAP_ASYNC_READ | FUSE_CAP_PARALLEL_DIROPS |
+                    FUSE_CAP_READDIRPLUS | FUSE_CAP_READDIRPLUS_AUTO;
+  if (FLAGS_writeback_cache) {
+    wanted |= FUSE_CAP_WRITEBACK_CACHE;
   }
-  return path.substr(1);
+  connection->want |= wanted & connection->capable;
+  writeback_cache_ = (connection->want & FUSE_CAP_WRITEBACK_CACHE) != 0;
+  readdirplus_ = (connection->want & FUSE_CAP_READDIRPLUS) != 0;
+
+  // libfuse derives max_pages from max_write, and lowers max_write to fit its
+  // own buffers.  max_read also has to be given as a mount option, which main
+  // takes care of.
+  const unsigned max_request_bytes = static_cast<unsigned>(
+      std::min<std::uint64_t>(FLAGS_max_request_bytes, UINT_MAX));
+  connection->max_write = max_request_bytes;
+  connection->max_read = max_request_bytes;
 }
 
-void* Initialize(fuse_conn_info*) noexcept { return nullptr; }
+void* Initialize(fuse_conn_info* const connection,
+                 fuse_config* const config) noexcept {
+  Negotiate(connection, config);
+#else
+void* Initialize(fuse_conn_info*) noexcept {
+#endif
+  // These start threads, so they can't be created until FUSE has daemonized.
+  attribute_cache_ = new AttributeCache(
+      *root_, FLAGS_attr_cache_entries, FLAGS_attr_cache_watches,
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(FLAGS_attr_cache_ttl)),
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(FLAGS_negative_cache_ttl)));
+  stat_prefetcher_ = new StatPrefetcher(*root_, attribute_cache_,
+                                        FLAGS_stat_prefetch_threads);
+  StartDumpingOnSignal(&statistics_);
+  if (FLAGS_trace_buffer_entries != 0 && !FLAGS_trace_file.empty()) {
+    StartWritingTraceOnSignal(tracer_, FLAGS_trace_file);
+  }
+  if (recorder_ != nullptr) {
+    recorder_->Start();
+  }
+  return nullptr;
+}
 
-void Destroy(void*) noexcept {}
+void Destroy(void*) noexcept {
+  LOG(INFO) << "encoding cache: " << encoding_cache_->encodings().hits()
+            << " hits, " << encoding_cache_->encodings().misses()
+            << " misses; decoding cache: "
+            << encoding_cache_->decodings().hits() << " hits, "
+            << encoding_cache_->decodings().misses() << " misses";
+  if (attribute_cache_->enabled()) {
+    LOG(INFO) << "attribute cache: " << attribute_cache_->hits() << " hits, "
+              << attribute_cache_->misses() << " misses";
+  }
+  if (directory_cache_->enabled()) {
+    LOG(INFO) << "directory cache: " << directory_cache_->hits() << " hits, "
+              << directory_cache_->misses() << " misses";
+  }
+  if (stat_prefetcher_->enabled()) {
+    LOG(INFO) << "stat prefetcher: " << stat_prefetcher_->dropped()
+              << " paths dropped";
+  }
+  LOG(INFO) << "statistics:\n" << statistics_.Format();
+  if (recorder_ != nullptr) {
+    try {
+      recorder_->Flush();
+    } catch (const std::system_error& e) {
+      LOG(ERROR) << "couldn't write recording: " << e.what();
+    }
+  }
+}
 
 int Statfs(const char* const c_path, struct statvfs* const output) {
-  const std::string path(Encode(c_path));
-  if (path == "/") {
+  const EncodedPath path(c_path);
+  if (path.is_root()) {
     *output = root_->StatVFs();
   } else {
-    *output =
-        root_->OpenAt(MakeRelative(path).c_str(), O_RDONLY | O_PATH).StatVFs();
+    const DirectoryCache::Location location =
+        directory_cache_->Find(path.relative());
+    *output = location.directory->OpenAt(location.rest, O_RDONLY | O_PATH)
+                  .StatVFs();
   }
   return 0;
 }
 
-int Getattr(const char* const c_path, struct stat* output) {
-  const std::string path(Encode(c_path));
-  if (path == "/") {
+bool IsWritable(const int flags) noexcept {
+  return (flags & O_ACCMODE) != O_RDONLY;
+}
+
+bool BufferingWrites() noexcept { return FLAGS_write_buffer_bytes != 0; }
+
+// Identifies the file, if anything needs to know which it is.
+BufferedFiles::Key IdentifyFile(const File& file, const bool writable) {
+  if (!BufferingWrites() && !(attribute_cache_->enabled() && writable)) {
+    return BufferedFiles::Key();
+  }
+  const struct stat stats = file.Stat();
+  return BufferedFiles::Key(stats.st_dev, stats.st_ino);
+}
+
+// An open file.
+struct FileHandle {
+  FileHandle(File file_in, const int flags)
+      : file(std::move(file_in)),
+        writable(IsWritable(flags)),
+        key(IdentifyFile(file, writable)),
+        readahead(FLAGS_readahead_bytes) {}
+
+  File file;
+  const bool writable;
+
+  // The device and inode numbers.  Only set if something needs them.
+  const BufferedFiles::Key key;
+
+  // Shared with the other handles open on the file, if writes are being
+  // buffered.
+  std::shared_ptr<BufferedFile> buffers;
+
+  Readahead readahead;
+};
+
+// Open files, by FUSE file handle.
+HandleTable<FileHandle>* file_handles_;
+
+// Write buffers by inode, so data buffered in one handle can be written out
+// before the file is observed through anything else.  Only used if writes are
+// being buffered.
+BufferedFiles* buffered_files_;
+
+// Writes out data buffered for the handle.
+void FlushWrites(FileHandle* const handle) {
+  if (BufferingWrites() && handle->writable) {
+    handle->buffers->Flush(&handle->file);
+  }
+}
+
+// Writes out data buffered for the handle's file through any handle.  Takes
+// no lock unless something is buffered.
+void FlushFileWrites(const FileHandle& handle) {
+  if (BufferingWrites()) {
+    handle.buffers->Flush();
+  }
+}
+
+// Writes out data buffered for the file through any handle.  Returns whether
+// there were any.
+bool FlushWrites(const struct stat& stats) {
+  return BufferingWrites() &&
+         buffered_files_->Flush(BufferedFiles::Key(stats.st_dev, stats.st_ino));
+}
+
+// Getattr, for a path that's already encoded and relative to root_.
+int GetattrEncoded(const char* const path, struct stat* const output) {
+  switch (attribute_cache_->Lookup(path, output)) {
+    case AttributeCache::Result::kExists:
+      return 0;
+    case AttributeCache::Result::kMissing:
+      return -ENOENT;
+    case AttributeCache::Result::kUnknown:
+      break;
+  }
+  const AttributeCache::Generation generation =
+      attribute_cache_->BeginFetch(path);
+  const DirectoryCache::Location location = directory_cache_->Find(path);
+  if (path[0] == '\0') {
     *output = root_->Stat();
-  } else {
-    *output = root_->LinkStatAt(MakeRelative(path).c_str());
+  } else if (!location.directory->TryLinkStatAt(location.rest, output)) {
+    // Probes for missing files are common enough that they shouldn't cost an
+    // exception.
+    attribute_cache_->InsertMissing(path, generation);
+    return -ENOENT;
+  }
+  if (S_ISREG(output->st_mode) && FlushWrites(*output)) {
+    *output = location.directory->LinkStatAt(location.rest);
   }
+  attribute_cache_->Insert(path, *output, generation);
   return 0;
 }
 
+int Getattr(const char* const c_path, struct stat* output) {
+  if (IsStatisticsFile(c_path)) {
+    *output = StatisticsFileStat();
+    return 0;
+  }
+  return GetattrEncoded(EncodedPath(c_path).relative(), output);
+}
+
 int Fgetattr(const char*, struct stat* const output,
              struct fuse_file_info* const file_info) {
-  // This reinterpret_cast violates type aliasing rules, so a compiler may
-  // invoke undefined behavior if *output is ever dereferenced.  However, we
-  // compile with -fno-strict-aliasing, so this should be safe.
-  *output = reinterpret_cast<File*>(file_info->fh)->Stat();
+  if (IsStatisticsHandle(file_info->fh)) {
+    *output = StatisticsFileStat();
+    return 0;
+  }
+  FileHandle* const handle = &file_handles_->Get(file_info->fh);
+  FlushFileWrites(*handle);
+  *output = handle->file.Stat();
   return 0;
 }
 
-template <typename T>
-int OpenResource(const std::string& path, const int flags,
-                 uint64_t* const handle, const mode_t mode = 0) {
+// Opens the path and stores it, along with args, in a new entry in the table.
+template <typename T, typename... Args>
+int OpenResource(const EncodedPath& path, const int flags,
+                 HandleTable<T>* const table, uint64_t* const handle,
+                 const mode_t mode, const Args&... args) {
   try {
-    std::unique_ptr<T> t(
-        new T(path == "/" ? *root_ : root_->OpenAt(MakeRelative(path).c_str(),
-                                                   flags, mode)));
-    static_assert(sizeof(*handle) == sizeof(std::uintptr_t),
-                  "FUSE file handles are a different size than pointers");
-    *handle = reinterpret_cast<std::uintptr_t>(t.release());
+    // The location of the root is ".", so the root is opened anew rather than
+    // duplicated, and the entry gets a file offset of its own.
+    const DirectoryCache::Location location =
+        directory_cache_->Find(path.relative());
+    *handle = table->Emplace(
+        location.directory->OpenAt(location.rest, flags, mode), args...);
     return 0;
   } catch (const std::bad_alloc&) {
     return -ENOMEM;
   }
 }
 
-template <typename T>
-int ReleaseResource(const uint64_t handle) noexcept {
-  delete reinterpret_cast<T*>(handle);
+// Opens a file, telling the attribute cache if it's open for writing.
+int OpenFile(const EncodedPath& path, int flags, uint64_t* const fh,
+             const mode_t mode = 0) {
+#if FUSE_USE_VERSION >= 30
+  if (writeback_cache_) {
+    // The kernel reads in pages to fill out partial writes, even to files
+    // opened write-only, and it handles appending itself.
+    if ((flags & O_ACCMODE) == O_WRONLY) {
+      flags = (flags & ~O_ACCMODE) | O_RDWR;
+    }
+    flags &= ~O_APPEND;
+  }
+#endif
+  if (BufferingWrites() && (flags & O_TRUNC) && !path.is_root()) {
+    const DirectoryCache::Location location =
+        directory_cache_->Find(path.relative());
+    struct stat existing;
+    if (location.directory->TryLinkStatAt(location.rest, &existing)) {
+      // Don't let buffered writes land after the truncation.
+      FlushWrites(existing);
+    }
+  }
+
+  const int result = OpenResource(path, flags, file_handles_, fh, mode, flags);
+  if (result != 0) {
+    return result;
+  }
+  FileHandle* const handle = &file_handles_->Get(*fh);
+  if (BufferingWrites()) {
+    // Even read-only handles share the file's buffers, so they can flush
+    // what the others have written before reading.
+    handle->buffers = buffered_files_->Acquire(handle->key);
+    if (handle->writable) {
+      handle->buffers->Open(&handle->file);
+    }
+  }
+  if (handle->writable && attribute_cache_->enabled()) {
+    attribute_cache_->BeginWrite(handle->key.second);
+  }
   return 0;
 }
 
 int Mknod(const char* const c_path, const mode_t mode, const dev_t dev) {
-  const std::string path(Encode(c_path));
-  if (path == "/") {
+  if (IsStatisticsFile(c_path)) {
+    return -EPERM;
+  }
+  const EncodedPath path(c_path);
+  if (path.is_root()) {
     return -EISDIR;
   } else {
-    root_->MkNod(MakeRelative(path).c_str(), mode, dev);
+    const DirectoryCache::Location location =
+        directory_cache_->Find(path.relative());
+    location.directory->MkNod(location.rest, mode, dev);
+    attribute_cache_->InvalidateEntry(path.relative());
     return 0;
   }
 }
 
 int Chmod(const char* const c_path, const mode_t mode) {
-  const std::string path(Encode(c_path));
-  root_->ChModAt(path == "/" ? "." : MakeRelative(path).c_str(), mode);
+  if (IsStatisticsFile(c_path)) {
+    return -EPERM;
+  }
+  const EncodedPath path(c_path);
+  const DirectoryCache::Location location =
+      directory_cache_->Find(path.relative());
+  location.directory->ChModAt(location.rest, mode);
+  attribute_cache_->Invalidate(path.relative());
   return 0;
 }
 
 int Rename(const char* const c_old_path, const char* const c_new_path) {
-  const std::string old_path(Encode(c_old_path));
-  const std::string new_path(Encode(c_new_path));
-  if (old_path == "/" || new_path == "/") {
+  if (IsStatisticsFile(c_old_path) || IsStatisticsFile(c_new_path)) {
+    return -EPERM;
+  }
+  const EncodedPath old_path(c_old_path);
+  const EncodedPath new_path(c_new_path);
+  if (old_path.is_root() || new_path.is_root()) {
     return -EINVAL;
   } else {
-    root_->RenameAt(MakeRelative(old_path).c_str(),
-                    MakeRelative(new_path).c_str());
+    const DirectoryCache::Location old_location =
+        directory_cache_->Find(old_path.relative());
+    const DirectoryCache::Location new_location =
+        directory_cache_->Find(new_path.relative());
+    const bool moving_directory =
+        attribute_cache_->enabled() &&
+        S_ISDIR(old_location.directory->LinkStatAt(old_location.rest).st_mode);
+    // If either path is a directory, cached directories beneath it are about
+    // to be elsewhere or gone.  Drop them now, so concurrent operations don't
+    // resolve through them while the rename happens, and again afterward, in
+    // case one of those operations cached them anew in the meantime.
+    directory_cache_->Invalidate(old_path.relative());
+    directory_cache_->Invalidate(new_path.relative());
+    old_location.directory->RenameAt(old_location.rest,
+                                     *new_location.directory,
+                                     new_location.rest);
+    directory_cache_->Invalidate(old_path.relative());
+    directory_cache_->Invalidate(new_path.relative());
+    if (moving_directory) {
+      // Everything under the directory has a new path now.
+      attribute_cache_->InvalidateAll();
+    } else {
+      attribute_cache_->InvalidateEntry(old_path.relative());
+      attribute_cache_->InvalidateEntry(new_path.relative());
+    }
     return 0;
   }
 }
 
-int Create(const char* const path, const mode_t mode,
+int Create(const char* const c_path, const mode_t mode,
            fuse_file_info* const file_info) {
-  return OpenResource<File>(Encode(path), file_info->flags | O_CREAT,
-                            &file_info->fh, mode);
+  if (IsStatisticsFile(c_path)) {
+    return -EEXIST;
+  }
+  const EncodedPath path(c_path);
+  const int result =
+      OpenFile(path, file_info->flags | O_CREAT, &file_info->fh, mode);
+  attribute_cache_->InvalidateEntry(path.relative());
+  return result;
 }
 
 int Open(const char* const path, fuse_file_info* const file_info) {
-  return OpenResource<File>(Encode(path), file_info->flags, &file_info->fh);
+  if (IsStatisticsFile(path)) {
+    if (IsWritable(file_info->flags)) {
+      return -EACCES;
+    }
+    // The file's contents change constantly, and it claims to be empty, so
+    // make sure the kernel neither caches it nor stops at its size.
+    file_info->direct_io = true;
+    file_info->fh = OpenStatistics();
+    return 0;
+  }
+  return OpenFile(EncodedPath(path), file_info->flags, &file_info->fh);
 }
 
 int Read(const char*, char* const buffer, const size_t bytes,
          const off_t offset, fuse_file_info* const file_info) {
-  // This reinterpret_cast violates type aliasing rules, so a compiler may
-  // invoke undefined behavior when file is dereferenced on the next line.
-  // However, we compile with -fno-strict-aliasing, so it should be safe.
-  auto* const file = reinterpret_cast<File*>(file_info->fh);
-  const std::vector<std::uint8_t> read = file->Read(offset, bytes);
-  std::memcpy(buffer, read.data(), read.size());
-  return static_cast<int>(read.size());
+  if (IsStatisticsHandle(file_info->fh)) {
+    return static_cast<int>(
+        ReadStatistics(file_info->fh, offset, bytes, buffer));
+  }
+  FileHandle* const handle = &file_handles_->Get(file_info->fh);
+  FlushFileWrites(*handle);
+  handle->readahead.Read(handle->file, offset, bytes);
+  return static_cast<int>(handle->file.Read(offset, bytes, buffer));
+}
+
+int ReadBuf(const char*, fuse_bufvec** const output, const size_t bytes,
+            const off_t offset, fuse_file_info* const file_info) {
+  if (IsStatisticsHandle(file_info->fh)) {
+    // FUSE frees both the vector and its memory buffer with free(3).
+    auto* const result = static_cast<fuse_bufvec*>(
+        std::calloc(1, sizeof(fuse_bufvec)));
+    char* const buffer = static_cast<char*>(std::malloc(bytes));
+    if (result == nullptr || buffer == nullptr) {
+      std::free(result);
+      std::free(buffer);
+      return -ENOMEM;
+    }
+    result->count = 1;
+    result->buf[0].mem = buffer;
+    try {
+      result->buf[0].size =
+          ReadStatistics(file_info->fh, offset, bytes, buffer);
+    } catch (...) {
+      std::free(result);
+      std::free(buffer);
+      throw;
+    }
+    *output = result;
+    return 0;
+  }
+
+  FileHandle* const handle = &file_handles_->Get(file_info->fh);
+  FlushFileWrites(*handle);
+  handle->readahead.Read(handle->file, offset, bytes);
+
+  // Rather than reading the data ourselves, hand FUSE a buffer that refers to
+  // the underlying file descriptor.  FUSE can then splice the data straight
+  // into the kernel without ever copying it through our address space.  FUSE
+  // takes ownership of *output and releases it with free(3).
+  auto* const result =
+      static_cast<fuse_bufvec*>(std::malloc(sizeof(fuse_bufvec)));
+  if (result == nullptr) {
+    return -ENOMEM;
+  }
+  std::memset(result, 0, sizeof(*result));
+  result->count = 1;
+  result->buf[0].size = bytes;
+  result->buf[0].flags =
+      static_cast<fuse_buf_flags>(FUSE_BUF_IS_FD | FUSE_BUF_FD_SEEK);
+  result->buf[0].fd = handle->file.fd();
+  result->buf[0].pos = offset;
+  *output = result;
+  // This is an upper bound; FUSE will read less at the end of the file.
+  statistics_.AddBytes(Operation::kReadBuf, bytes);
+  return 0;
 }
 
 int Write(const char*, const char* const buffer, const size_t bytes,
           const off_t offset, fuse_file_info* const file_info) {
-  // See notes in Read about undefined behavior.
-  auto* const file = reinterpret_cast<File*>(file_info->fh);
-  const std::vector<std::uint8_t> to_write(buffer, buffer + bytes);
-  file->Write(offset, to_write);
-  return static_cast<int>(bytes);
+  FileHandle* const handle = &file_handles_->Get(file_info->fh);
+  std::unique_lock<std::mutex> lock;
+  if (BufferingWrites()) {
+    if (handle->buffers->Absorbs(bytes)) {
+      handle->buffers->Write(&handle->file, offset, buffer, bytes);
+      return static_cast<int>(bytes);
+    }
+    // Nothing buffered through any handle may land on top of this.
+    lock = handle->buffers->FlushForWrite();
+  }
+  return static_cast<int>(handle->file.Write(offset, buffer, bytes));
+}
+
+int WriteBuf(const char*, fuse_bufvec* const input, const off_t offset,
+             fuse_file_info* const file_info) {
+  FileHandle* const handle = &file_handles_->Get(file_info->fh);
+
+  std::unique_lock<std::mutex> lock;
+  if (BufferingWrites()) {
+    const size_t bytes = fuse_buf_size(input);
+    if (handle->buffers->Absorbs(bytes)) {
+      // Small writes are going to be copied into the buffer anyway, so pull
+      // them into memory.
+      thread_local std::vector<char> data;
+      data.resize(bytes);
+      fuse_bufvec memory;
+      std::memset(&memory, 0, sizeof(memory));
+      memory.count = 1;
+      memory.buf[0].size = bytes;
+      memory.buf[0].mem = data.data();
+      const ssize_t copied =
+          fuse_buf_copy(&memory, input, fuse_buf_copy_flags());
+      if (copied < 0) {
+        return static_cast<int>(copied);
+      }
+      handle->buffers->Write(&handle->file, offset, data.data(),
+                             static_cast<size_t>(copied));
+      return static_cast<int>(copied);
+    }
+    // Nothing buffered through any handle may land on top of this.
+    lock = handle->buffers->FlushForWrite();
+  }
+
+  // Point FUSE at the underlying file descriptor and let it move the data
+  // there itself.  If the data are still sitting in the FUSE device, FUSE will
+  // splice them across without copying them into our address space.
+  fuse_bufvec output;
+  std::memset(&output, 0, sizeof(output));
+  output.count = 1;
+  output.buf[0].size = fuse_buf_size(input);
+  output.buf[0].flags =
+      static_cast<fuse_buf_flags>(FUSE_BUF_IS_FD | FUSE_BUF_FD_SEEK);
+  output.buf[0].fd = handle->file.fd();
+  output.buf[0].pos = offset;
+  // fuse_buf_copy returns either the number of bytes copied or a negated errno
+  // value, which is exactly what FUSE expects from us.
+  return static_cast<int>(
+      fuse_buf_copy(&output, input, FUSE_BUF_SPLICE_NONBLOCK));
+}
+
+#if FUSE_USE_VERSION >= 30
+int CopyFileRange(const char*, fuse_file_info* const in_info,
+                  const off_t in_offset, const char*,
+                  fuse_file_info* const out_info, const off_t out_offset,
+                  const size_t bytes, const int flags) {
+  if (flags != 0) {
+    return -EINVAL;
+  }
+  if (IsStatisticsHandle(in_info->fh) || IsStatisticsHandle(out_info->fh)) {
+    // The kernel copies through read and write instead.
+    return -EOPNOTSUPP;
+  }
+  FileHandle* const in = &file_handles_->Get(in_info->fh);
+  FileHandle* const out = &file_handles_->Get(out_info->fh);
+  // Buffered data have to land before the copy reads the source or
+  // overwrites the destination.
+  FlushFileWrites(*in);
+  std::unique_lock<std::mutex> lock;
+  if (BufferingWrites()) {
+    lock = out->buffers->FlushForWrite();
+  }
+  // Keep the result representable as an int.  Callers loop on short copies.
+  constexpr size_t kMaxBytes = 1 << 30;
+  return static_cast<int>(in->file.CopyRangeTo(
+      in_offset, &out->file, out_offset, std::min(bytes, kMaxBytes)));
 }
+#endif
 
 int Utimens(const char* const c_path, const timespec times[2]) {
-  const std::string path(Encode(c_path));
-  root_->UTimeNs(path == "/" ? "." : MakeRelative(path).c_str(), times[0],
-                 times[1]);
+  if (IsStatisticsFile(c_path)) {
+    return -EPERM;
+  }
+  const EncodedPath path(c_path);
+  const DirectoryCache::Location location =
+      directory_cache_->Find(path.relative());
+  location.directory->UTimeNs(location.rest, times[0], times[1]);
+  attribute_cache_->Invalidate(path.relative());
+  return 0;
+}
+
+int Flush(const char*, fuse_file_info* const file_info) {
+  if (!IsStatisticsHandle(file_info->fh)) {
+    FlushWrites(&file_handles_->Get(file_info->fh));
+  }
+  return 0;
+}
+
+int Fsync(const char*, const int datasync, fuse_file_info* const file_info) {
+  if (!IsStatisticsHandle(file_info->fh)) {
+    FileHandle* const handle = &file_handles_->Get(file_info->fh);
+    FlushWrites(handle);
+    handle->file.Sync(datasync != 0);
+  }
   return 0;
 }
 
 int Release(const char*, fuse_file_info* const file_info) {
-  return ReleaseResource<File>(file_info->fh);
+  if (IsStatisticsHandle(file_info->fh)) {
+    ReleaseStatistics(file_info->fh);
+    return 0;
+  }
+  FileHandle* const handle = &file_handles_->Get(file_info->fh);
+  int result = 0;
+  if (BufferingWrites()) {
+    if (handle->writable) {
+      // The kernel ignores errors from release, but report them anyway so
+      // they're counted.  Applications that care will have seen them from
+      // flush.
+      try {
+        handle->buffers->Close(&handle->file);
+      } catch (const std::system_error& e) {
+        result = -e.code().value();
+      }
+    }
+    buffered_files_->Release(handle->key);
+  }
+  if (handle->writable && attribute_cache_->enabled()) {
+    attribute_cache_->EndWrite(handle->key.second);
+  }
+  file_handles_->Erase(file_info->fh);
+  return result;
 }
 
 int Unlink(const char* c_path) {
-  const std::string path(Encode(c_path));
-  if (path == "/") {
+  if (IsStatisticsFile(c_path)) {
+    return -EPERM;
+  }
+  const EncodedPath path(c_path);
+  if (path.is_root()) {
     // Removing the root is probably a bad idea.
     return -EPERM;
   } else {
-    root_->UnlinkAt(MakeRelative(path).c_str());
+    const DirectoryCache::Location location =
+        directory_cache_->Find(path.relative());
+    location.directory->UnlinkAt(location.rest);
+    attribute_cache_->InvalidateEntry(path.relative());
     return 0;
   }
 }
@@ -200,78 +859,177 @@ int Symlink(const char*, const char*) { return -EPERM; }
 int Readlink(const char*, char*, size_t) { return -EINVAL; }
 
 int Mkdir(const char* const c_path, const mode_t mode) {
-  const std::string path(Encode(c_path));
-  if (path == "/") {
+  if (IsStatisticsFile(c_path)) {
+    return -EPERM;
+  }
+  const EncodedPath path(c_path);
+  if (path.is_root()) {
     // They're asking to create the mount point.  Huh?
     return -EEXIST;
   } else {
-    root_->MkDir(MakeRelative(path).c_str(), mode);
+    const DirectoryCache::Location location =
+        directory_cache_->Find(path.relative());
+    location.directory->MkDir(location.rest, mode);
+    attribute_cache_->InvalidateEntry(path.relative());
     return 0;
   }
 }
 
-int Opendir(const char* const path, fuse_file_info* const file_info) {
-  return OpenResource<Directory>(Encode(path), O_DIRECTORY, &file_info->fh);
+// Whether anything needs to know where open directories are.
+bool TrackingDirectoryPaths() noexcept {
+#if FUSE_USE_VERSION >= 30
+  if (readdirplus_) {
+    return true;
+  }
+#endif
+  return stat_prefetcher_->enabled();
+}
+
+// An open directory.  If we're prefetching attributes or answering readdirplus
+// requests, we also need to know where it is.
+struct OpenDirectory {
+  OpenDirectory(File file, const char* const relative_path)
+      : listing(std::move(file), encoding_cache_,
+                FLAGS_readdir_snapshot_entries),
+        path(TrackingDirectoryPaths() ? relative_path : "") {}
+
+  DirectoryListing listing;
+  const std::string path;  // Encoded, relative to root_.
+};
+
+// Open directories, by FUSE file handle.
+HandleTable<OpenDirectory>* directory_handles_;
+
+int Opendir(const char* const c_path, fuse_file_info* const file_info) {
+  const EncodedPath path(c_path);
+  return OpenResource(path, O_RDONLY | O_DIRECTORY, directory_handles_,
+                      &file_info->fh, 0, path.relative());
+}
+
+// Returns true for the directory entries other than "." and "..".
+bool IsChildEntry(const char* const name) {
+  return std::strcmp(name, ".") != 0 && std::strcmp(name, "..") != 0;
+}
+
+#if FUSE_USE_VERSION >= 30
+// Fills in the full attributes of the directory entry for readdirplus.
+// Returns false if they're unavailable, in which case the kernel will look the
+// entry up itself if it needs to.
+bool StatEntry(const OpenDirectory& directory,
+               const DirectoryListing::Entry& entry,
+               struct stat* const output) {
+  if (!IsChildEntry(entry.raw_name)) {
+    return false;
+  }
+  std::string path = directory.path;
+  if (!path.empty()) {
+    path.push_back('/');
+  }
+  path.append(entry.raw_name);
+  try {
+    return GetattrEncoded(path.c_str(), output) == 0;
+  } catch (const std::system_error&) {
+    return false;
+  }
 }
 
+int Readdir(const char*, void* const buffer, fuse_fill_dir_t filler,
+            const off_t offset, fuse_file_info* const file_info,
+            const fuse_readdir_flags flags) {
+#else
 int Readdir(const char*, void* const buffer, fuse_fill_dir_t filler,
             const off_t offset, fuse_file_info* const file_info) {
-  // See notes in Read about undefined behavior.
-  auto* const directory = reinterpret_cast<Directory*>(file_info->fh);
+#endif
+  OpenDirectory* const directory = &directory_handles_->Get(file_info->fh);
+  DirectoryListing& listing = directory->listing;
 
   static_assert(std::is_same<off_t, long>(),
                 "off_t is not convertible with long");
-  if (offset != directory->offset()) {
-    directory->Seek(offset);
+  if (offset != listing.offset()) {
+    listing.Seek(offset);
   }
 
-  for (std::experimental::optional<dirent> entry = directory->ReadOne(); entry;
-       entry = directory->ReadOne()) {
+  DirectoryListing::Entry entry;
+  while (listing.Next(&entry)) {
     struct stat stats;
     std::memset(&stats, 0, sizeof(stats));
-    stats.st_ino = entry->d_ino;
-    stats.st_mode = DirectoryTypeToFileType(entry->d_type);
-    const off_t next_offset = directory->offset();
-    if (filler(buffer, Decode(entry->d_name).c_str(), &stats, next_offset)) {
+    stats.st_ino = entry.inode;
+    stats.st_mode = DirectoryTypeToFileType(entry.type);
+#if FUSE_USE_VERSION >= 30
+    fuse_fill_dir_flags fill_flags = fuse_fill_dir_flags();
+    if ((flags & FUSE_READDIR_PLUS) &&
+        StatEntry(*directory, entry, &stats)) {
+      fill_flags = FUSE_FILL_DIR_PLUS;
+    }
+    if (filler(buffer, entry.name, &stats, entry.next_offset, fill_flags)) {
       break;
     }
+#else
+    if (filler(buffer, entry.name, &stats, entry.next_offset)) {
+      break;
+    }
+#endif
+    if (stat_prefetcher_->enabled() && IsChildEntry(entry.raw_name)) {
+      stat_prefetcher_->Prefetch(directory->path, entry.raw_name);
+    }
   }
   return 0;
 }
 
 int Releasedir(const char*, fuse_file_info* const file_info) {
-  return ReleaseResource<Directory>(file_info->fh);
+  directory_handles_->Erase(file_info->fh);
+  return 0;
 }
 
 int Truncate(const char* const c_path, const off_t size) {
-  const std::string path(Encode(c_path));
-  if (path == "/") {
+  if (IsStatisticsFile(c_path)) {
+    return -EACCES;
+  }
+  const EncodedPath path(c_path);
+  if (path.is_root()) {
     return -EISDIR;
   } else {
-    root_->OpenAt(MakeRelative(path).c_str(), O_WRONLY).Truncate(size);
+    // There's no truncateat, so open the file, but relative to its cached
+    // parent.
+    const DirectoryCache::Location location =
+        directory_cache_->Find(path.relative());
+    File file = location.directory->OpenAt(location.rest, O_WRONLY);
+    if (BufferingWrites()) {
+      FlushWrites(file.Stat());
+    }
+    file.Truncate(size);
+    attribute_cache_->Invalidate(path.relative());
     return 0;
   }
 }
 
 int Ftruncate(const char*, const off_t size, fuse_file_info* const file_info) {
-  // See notes in Read about undefined behavior.
-  reinterpret_cast<File*>(file_info->fh)->Truncate(size);
+  FileHandle* const handle = &file_handles_->Get(file_info->fh);
+  FlushFileWrites(*handle);
+  handle->file.Truncate(size);
   return 0;
 }
 
 int Rmdir(const char* c_path) {
-  const std::string path(Encode(c_path));
-  if (path == "/") {
+  if (IsStatisticsFile(c_path)) {
+    return -EPERM;
+  }
+  const EncodedPath path(c_path);
+  if (path.is_root()) {
     // Removing the root is probably a bad idea.
     return -EPERM;
   } else {
-    root_->RmDirAt(MakeRelative(path).c_str());
+    const DirectoryCache::Location location =
+        directory_cache_->Find(path.relative());
+    location.directory->RmDirAt(location.rest);
+    directory_cache_->Invalidate(path.relative());
+    attribute_cache_->InvalidateEntry(path.relative());
     return 0;
   }
 }
 
 template <typename Function, Function f, typename... Args>
-int CatchAndReturnExceptions(Args... args) noexcept {
+int CatchAndReturnExceptionsUntimed(Args... args) noexcept {
   try {
     return f(args...);
   } catch (const std::system_error& e) {
@@ -282,39 +1040,362 @@ int CatchAndReturnExceptions(Args... args) noexcept {
   }
 }
 
+// Records the arguments each operation signature needs to be replayed.  Handles
+// are recorded as integers, so the replayer can tell which calls share them.
+// File contents are never recorded.
+
+void AppendHandle(const fuse_file_info* const file_info,
+                  std::string* const record) {
+  AppendInteger(static_cast<std::int64_t>(file_info->fh), record);
+}
+
+// Statfs, Getattr
+void RecordArguments(std::string* const record, const char* const path,
+                     struct statvfs*) {
+  AppendPath(path, record);
+}
+void RecordArguments(std::string* const record, const char* const path,
+                     struct stat*) {
+  AppendPath(path, record);
+}
+
+// Fgetattr
+void RecordArguments(std::string* const record, const char*, struct stat*,
+                     fuse_file_info* const file_info) {
+  AppendHandle(file_info, record);
+}
+
+// Mknod
+void RecordArguments(std::string* const record, const char* const path,
+                     const mode_t mode, const dev_t dev) {
+  AppendPath(path, record);
+  AppendInteger(mode, record);
+  AppendInteger(static_cast<std::int64_t>(dev), record);
+}
+
+// Chmod, Mkdir
+void RecordArguments(std::string* const record, const char* const path,
+                     const mode_t mode) {
+  AppendPath(path, record);
+  AppendInteger(mode, record);
+}
+
+// Rename, Symlink
+void RecordArguments(std::string* const record, const char* const path1,
+                     const char* const path2) {
+  AppendPath(path1, record);
+  AppendPath(path2, record);
+}
+
+// Create
+void RecordArguments(std::string* const record, const char* const path,
+                     const mode_t mode, fuse_file_info* const file_info) {
+  AppendPath(path, record);
+  AppendInteger(mode, record);
+  AppendInteger(file_info->flags, record);
+  AppendHandle(file_info, record);
+}
+
+// Open, Flush, Release, Opendir, Releasedir
+void RecordArguments(std::string* const record, const char* const path,
+                     fuse_file_info* const file_info) {
+  AppendPath(path, record);
+  AppendInteger(file_info->flags, record);
+  AppendHandle(file_info, record);
+}
+
+// Fsync
+void RecordArguments(std::string* const record, const char*,
+                     const int datasync, fuse_file_info* const file_info) {
+  AppendInteger(datasync, record);
+  AppendHandle(file_info, record);
+}
+
+// Read, ReadBuf, Write
+void RecordArguments(std::string* const record, const char*, char*,
+                     const size_t bytes, const off_t offset,
+                     fuse_file_info* const file_info) {
+  AppendInteger(static_cast<std::int64_t>(bytes), record);
+  AppendInteger(offset, record);
+  AppendHandle(file_info, record);
+}
+void RecordArguments(std::string* const record, const char*, fuse_bufvec**,
+                     const size_t bytes, const off_t offset,
+                     fuse_file_info* const file_info) {
+  AppendInteger(static_cast<std::int64_t>(bytes), record);
+  AppendInteger(offset, record);
+  AppendHandle(file_info, record);
+}
+void RecordArguments(std::string* const record, const char*, const char*,
+                     const size_t bytes, const off_t offset,
+                     fuse_file_info* const file_info) {
+  AppendInteger(static_cast<std::int64_t>(bytes), record);
+  AppendInteger(offset, record);
+  AppendHandle(file_info, record);
+}
+
+// WriteBuf
+void RecordArguments(std::string* const record, const char*,
+                     fuse_bufvec* const input, const off_t offset,
+                     fuse_file_info* const file_info) {
+  AppendInteger(static_cast<std::int64_t>(fuse_buf_size(input)), record);
+  AppendInteger(offset, record);
+  AppendHandle(file_info, record);
+}
+
+#if FUSE_USE_VERSION >= 30
+// CopyFileRange
+void RecordArguments(std::string* const record, const char*,
+                     fuse_file_info* const in_info, const off_t in_offset,
+                     const char*, fuse_file_info* const out_info,
+                     const off_t out_offset, const size_t bytes, int) {
+  AppendInteger(static_cast<std::int64_t>(bytes), record);
+  AppendInteger(in_offset, record);
+  AppendHandle(in_info, record);
+  AppendInteger(out_offset, record);
+  AppendHandle(out_info, record);
+}
+#endif
+
+// Utimens
+void RecordArguments(std::string* const record, const char* const path,
+                     const timespec* const times) {
+  AppendPath(path, record);
+  for (int i = 0; i < 2; ++i) {
+    AppendInteger(times[i].tv_sec, record);
+    AppendInteger(times[i].tv_nsec, record);
+  }
+}
+
+// Truncate
+void RecordArguments(std::string* const record, const char* const path,
+                     const off_t size) {
+  AppendPath(path, record);
+  AppendInteger(size, record);
+}
+
+// Ftruncate
+void RecordArguments(std::string* const record, const char*, const off_t size,
+                     fuse_file_info* const file_info) {
+  AppendInteger(size, record);
+  AppendHandle(file_info, record);
+}
+
+// Unlink, Rmdir
+void RecordArguments(std::string* const record, const char* const path) {
+  AppendPath(path, record);
+}
+
+// Readlink
+void RecordArguments(std::string* const record, const char* const path, char*,
+                     const size_t bytes) {
+  AppendPath(path, record);
+  AppendInteger(static_cast<std::int64_t>(bytes), record);
+}
+
+// Readdir
+void RecordArguments(std::string* const record, const char*, void*,
+                     fuse_fill_dir_t, const off_t offset,
+                     fuse_file_info* const file_info) {
+  AppendInteger(offset, record);
+  AppendHandle(file_info, record);
+}
+#if FUSE_USE_VERSION >= 30
+void RecordArguments(std::string* const record, const char* const path,
+                     void* const buffer, const fuse_fill_dir_t filler,
+                     const off_t offset, fuse_file_info* const file_info,
+                     fuse_readdir_flags) {
+  RecordArguments(record, path, buffer, filler, offset, file_info);
+}
+#endif
+
+template <typename... Args>
+void Record(const Operation operation,
+            const std::chrono::steady_clock::time_point start,
+            const std::chrono::steady_clock::duration elapsed, const int result,
+            Args... args) noexcept {
+  // Reused from call to call, so recording usually doesn't allocate.
+  thread_local std::string record;
+  record.clear();
+  AppendCallHeader(operation, elapsed, result, &record);
+  RecordArguments(&record, args...);
+  try {
+    recorder_->Write(start, record);
+  } catch (const std::system_error& e) {
+    LOG(ERROR) << "couldn't write recording: " << e.what();
+  }
+}
+
+// Returns the path an operation was called on.  Every operation takes it
+// first, though it's null for operations on handles.
+template <typename... Args>
+const char* PathArgument(const char* const path, Args...) noexcept {
+  return path;
+}
+
+template <typename Function, Function f, Operation operation,
+          typename... Args>
+int CatchAndReturnExceptions(Args... args) noexcept {
+  const auto start = std::chrono::steady_clock::now();
+  const int result = CatchAndReturnExceptionsUntimed<Function, f>(args...);
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  statistics_.Record(operation, result, elapsed);
+  if (tracer_ != nullptr) {
+    tracer_->Record(operation, PathArgument(args...), start, elapsed, result,
+                    MovesBytes(operation) && result > 0
+                        ? static_cast<std::uint64_t>(result)
+                        : 0);
+  }
+  if (recorder_ != nullptr) {
+    Record(operation, start, elapsed, result, args...);
+  }
+  return result;
+}
+
 }  // namespace
 
-#define CATCH_AND_RETURN_EXCEPTIONS(f) CatchAndReturnExceptions<decltype(f), f>
+#define CATCH_AND_RETURN_EXCEPTIONS(f) \
+  CatchAndReturnExceptions<decltype(f), f, Operation::k##f>
+
+#if FUSE_USE_VERSION >= 30
+namespace {
+
+// FUSE 3 folds the handle-based variants of getattr and truncate into the
+// path-based ones, passing a handle when there is one, and gives several other
+// operations extra arguments.  Dispatch to the FUSE 2 operations, so
+// statistics and recordings mean the same thing in both builds.
+
+int GetattrOrFgetattr(const char* const path, struct stat* const output,
+                      fuse_file_info* const file_info) noexcept {
+  if (file_info == nullptr) {
+    return CATCH_AND_RETURN_EXCEPTIONS(Getattr)(path, output);
+  }
+  return CATCH_AND_RETURN_EXCEPTIONS(Fgetattr)(path, output, file_info);
+}
+
+int TruncateOrFtruncate(const char* const path, const off_t size,
+                        fuse_file_info* const file_info) noexcept {
+  if (file_info == nullptr) {
+    return CATCH_AND_RETURN_EXCEPTIONS(Truncate)(path, size);
+  }
+  return CATCH_AND_RETURN_EXCEPTIONS(Ftruncate)(path, size, file_info);
+}
+
+// The kernel only passes a handle with attribute changes when truncating, so
+// chmod and utimens always get a path.
+int ChmodIgnoringHandle(const char* const path, const mode_t mode,
+                        fuse_file_info*) noexcept {
+  return CATCH_AND_RETURN_EXCEPTIONS(Chmod)(path, mode);
+}
+
+int UtimensIgnoringHandle(const char* const path, const timespec times[2],
+                          fuse_file_info*) noexcept {
+  return CATCH_AND_RETURN_EXCEPTIONS(Utimens)(path, times);
+}
+
+// copy_file_range returns ssize_t, but CopyFileRange never copies more than
+// fits in an int.
+ssize_t CopyFileRangeReturningSsize(const char* const in_path,
+                                    fuse_file_info* const in_info,
+                                    const off_t in_offset,
+                                    const char* const out_path,
+                                    fuse_file_info* const out_info,
+                                    const off_t out_offset, const size_t bytes,
+                                    const int flags) noexcept {
+  return CATCH_AND_RETURN_EXCEPTIONS(CopyFileRange)(
+      in_path, in_info, in_offset, out_path, out_info, out_offset, bytes,
+      flags);
+}
+
+// RENAME_EXCHANGE and RENAME_NOREPLACE aren't supported.
+int RenameWithoutFlags(const char* const old_path, const char* const new_path,
+                       const unsigned flags) noexcept {
+  if (flags != 0) {
+    return -EINVAL;
+  }
+  return CATCH_AND_RETURN_EXCEPTIONS(Rename)(old_path, new_path);
+}
+
+}  // namespace
+#endif
 
 fuse_operations FuseOperations(File* const root) {
   root_ = root;
+  encoding_cache_ = new EncodingCache(FLAGS_encoding_cache_entries);
+  directory_cache_ = new DirectoryCache(*root_, FLAGS_directory_cache_entries);
+  statistics_snapshots_ = new std::unordered_map<uint32_t, std::string>;
+  buffered_files_ = new BufferedFiles(FLAGS_write_buffer_bytes);
+  file_handles_ = new HandleTable<FileHandle>;
+  directory_handles_ = new HandleTable<OpenDirectory>;
+  BlockDumpSignal();
+  if (FLAGS_trace_buffer_entries != 0 || FLAGS_slow_op_threshold_ms > 0) {
+    tracer_ = new Tracer(
+        FLAGS_trace_buffer_entries,
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double, std::milli>(
+                FLAGS_slow_op_threshold_ms)));
+  }
+  if (FLAGS_trace_buffer_entries != 0 && !FLAGS_trace_file.empty()) {
+    BlockTraceSignal();
+  }
+  if (!FLAGS_record_file.empty()) {
+    // Open the file now, while relative paths still work.  FUSE changes to the
+    // root directory when it daemonizes.
+    recorder_ = new Recorder(FLAGS_record_file.c_str());
+  }
 
   fuse_operations result;
   std::memset(&result, 0, sizeof(result));
 
+#if FUSE_USE_VERSION < 30
   result.flag_nullpath_ok = true;
   result.flag_nopath = true;
   result.flag_utime_omit_ok = true;
+#endif
 
   result.init = Initialize;
   result.destroy = Destroy;
 
   result.statfs = CATCH_AND_RETURN_EXCEPTIONS(Statfs);
 
+#if FUSE_USE_VERSION >= 30
+  result.getattr = GetattrOrFgetattr;
+#else
   result.getattr = CATCH_AND_RETURN_EXCEPTIONS(Getattr);
   result.fgetattr = CATCH_AND_RETURN_EXCEPTIONS(Fgetattr);
+#endif
 
   result.mknod = CATCH_AND_RETURN_EXCEPTIONS(Mknod);
+#if FUSE_USE_VERSION >= 30
+  result.chmod = ChmodIgnoringHandle;
+  result.rename = RenameWithoutFlags;
+#else
   result.chmod = CATCH_AND_RETURN_EXCEPTIONS(Chmod);
   result.rename = CATCH_AND_RETURN_EXCEPTIONS(Rename);
+#endif
   result.create = CATCH_AND_RETURN_EXCEPTIONS(Create);
   result.open = CATCH_AND_RETURN_EXCEPTIONS(Open);
   result.read = CATCH_AND_RETURN_EXCEPTIONS(Read);
+  result.read_buf = CATCH_AND_RETURN_EXCEPTIONS(ReadBuf);
   result.write = CATCH_AND_RETURN_EXCEPTIONS(Write);
+  result.write_buf = CATCH_AND_RETURN_EXCEPTIONS(WriteBuf);
+#if FUSE_USE_VERSION >= 30
+  result.utimens = UtimensIgnoringHandle;
+#else
   result.utimens = CATCH_AND_RETURN_EXCEPTIONS(Utimens);
+#endif
+#if FUSE_USE_VERSION >= 30
+  result.copy_file_range = CopyFileRangeReturningSsize;
+#endif
+  result.flush = CATCH_AND_RETURN_EXCEPTIONS(Flush);
+  result.fsync = CATCH_AND_RETURN_EXCEPTIONS(Fsync);
   result.release = CATCH_AND_RETURN_EXCEPTIONS(Release);
+#if FUSE_USE_VERSION >= 30
+  result.truncate = TruncateOrFtruncate;
+#else
   result.truncate = CATCH_AND_RETURN_EXCEPTIONS(Truncate);
   result.ftruncate = CATCH_AND_RETURN_EXCEPTIONS(Ftruncate);
+#endif
   result.unlink = CATCH_AND_RETURN_EXCEPTIONS(Unlink);
 
   result.symlink = CATCH_AND_RETURN_EXCEPTIONS(Symlink);
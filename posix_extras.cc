@@ -14,12 +14,14 @@
 
 #include "posix_extras.h"
 
+#include <algorithm>
 #include <array>
 #include <cerrno>
 #include <cstdint>
-#include <experimental/optional>
 #include <stdexcept>
+#include <string>
 #include <system_error>
+#include <utility>
 #include <vector>
 
 #include <dirent.h>
@@ -28,6 +30,7 @@
 #include <stdio.h>
 #include <sys/stat.h>
 #include <sys/statvfs.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -35,6 +38,13 @@ namespace scoville {
 
 namespace {
 
+// How much space to give getdents64(2).  Large batches keep the number of
+// system calls down on directories with tens of thousands of entries.
+constexpr size_t kDirectoryBufferBytes = 64 * 1024;
+
+// How much to read at once when copy_file_range(2) isn't available.
+constexpr size_t kCopyBufferBytes = 1 << 20;
+
 std::system_error SystemError() {
   return std::system_error(errno, std::system_category());
 }
@@ -53,19 +63,40 @@ T CheckSyscall(const T result) {
   return result;
 }
 
+// Returns a path which refers to the referent of the file descriptor.  This
+// lets us operate on file descriptors opened with O_PATH, which most system
+// calls refuse.
+std::string ProcPath(const int fd) {
+  return "/proc/self/fd/" + std::to_string(fd);
+}
+
 }  // namespace
 
-File::File(const char* const path, const int flags, const mode_t mode)
-    : path_(path) {
+File::File(const char* const path, const int flags, const mode_t mode) {
   fd_ = CheckSyscall(open(path, flags, mode));
   VLOG(1) << "opening file descriptor " << fd_;
 }
 
-File::File(const File& other) : path_(other.path_), fd_(other.Duplicate()) {
+File::File(const File& other) : fd_(other.Duplicate()) {
   VLOG(1) << "opening file descriptor " << fd_;
 }
 
+File::File(File&& other) noexcept : fd_(other.fd_) {
+  other.fd_ = -1;
+}
+
+File File::Adopt(const int fd) noexcept {
+  File result;
+  result.fd_ = fd;
+  VLOG(1) << "adopting file descriptor " << fd;
+  return result;
+}
+
 File::~File() noexcept {
+  if (fd_ == -1) {
+    // This File has been moved from.
+    return;
+  }
   VLOG(1) << "closing file descriptor " << fd_;
   try {
     CheckSyscall(close(fd_));
@@ -80,6 +111,18 @@ struct stat File::Stat() const {
   return result;
 }
 
+void File::Advise(const off_t offset, const off_t length,
+                  const int advice) const {
+  // posix_fadvise returns an error number instead of setting errno.
+  if (const int error = posix_fadvise(fd_, offset, length, advice)) {
+    throw std::system_error(error, std::system_category());
+  }
+}
+
+void File::ChMod(const mode_t mode) const {
+  CheckSyscall(chmod(ProcPath(fd_).c_str(), mode));
+}
+
 void File::ChModAt(const char* const path, const mode_t mode) const {
   ValidatePath(path);
   CheckSyscall(fchmodat(fd_, path, mode, 0));
@@ -92,6 +135,18 @@ struct stat File::LinkStatAt(const char* const path) const {
   return result;
 }
 
+bool File::TryLinkStatAt(const char* const path,
+                         struct stat* const output) const {
+  ValidatePath(path);
+  if (fstatat(fd_, path, output, AT_SYMLINK_NOFOLLOW) == -1) {
+    if (errno == ENOENT) {
+      return false;
+    }
+    throw SystemError();
+  }
+  return true;
+}
+
 void File::MkDir(const char* const path, const mode_t mode) const {
   ValidatePath(path);
   CheckSyscall(mkdirat(fd_, path, mode | S_IFDIR));
@@ -108,24 +163,76 @@ File File::OpenAt(const char* const path, const int flags,
   ValidatePath(path);
   File result;
   result.fd_ = CheckSyscall(openat(fd_, path, flags, mode));
-  result.path_ = path_ + "/" + path;
   return result;
 }
 
-std::vector<std::uint8_t> File::Read(off_t offset, size_t bytes) const {
+std::vector<std::uint8_t> File::Read(const off_t offset,
+                                     const size_t bytes) const {
   std::vector<std::uint8_t> result(bytes, 0);
-  size_t cursor = 0;
-  ssize_t bytes_read;
-  while (0 < (bytes_read = CheckSyscall(
-                  pread(fd_, result.data() + cursor, bytes, offset)))) {
-    cursor += static_cast<size_t>(bytes_read);
-    offset += bytes_read;
-    bytes -= static_cast<size_t>(bytes_read);
+  result.resize(Read(offset, bytes, result.data()));
+  return result;
+}
+
+size_t File::Read(off_t offset, size_t bytes, void* const buffer) const {
+  auto* const cursor = static_cast<std::uint8_t*>(buffer);
+  size_t bytes_read = 0;
+  ssize_t result;
+  while (0 < (result = CheckSyscall(
+                  pread(fd_, cursor + bytes_read, bytes, offset)))) {
+    bytes_read += static_cast<size_t>(result);
+    offset += result;
+    bytes -= static_cast<size_t>(result);
   }
-  result.resize(cursor);
+  return bytes_read;
+}
+
+size_t File::CopyRangeTo(off_t offset, File* const destination,
+                         off_t destination_offset, size_t bytes) const {
+  size_t copied = 0;
+  while (bytes > 0) {
+    const ssize_t result = copy_file_range(fd_, &offset, destination->fd_,
+                                           &destination_offset, bytes, 0);
+    if (result == 0) {
+      return copied;
+    }
+    if (result == -1) {
+      if (errno == EXDEV || errno == ENOSYS || errno == EOPNOTSUPP) {
+        // The kernel or the file system can't do this copy.  Do it by hand.
+        // Other errors, like EINVAL for overlapping ranges within one file,
+        // would be just as wrong to work around.
+        break;
+      }
+      throw SystemError();
+    }
+    copied += static_cast<size_t>(result);
+    bytes -= static_cast<size_t>(result);
+  }
+
+  std::vector<std::uint8_t> buffer(std::min(bytes, kCopyBufferBytes));
+  while (bytes > 0) {
+    const size_t read =
+        Read(offset, std::min(bytes, buffer.size()), buffer.data());
+    if (read == 0) {
+      break;
+    }
+    destination->Write(destination_offset, buffer.data(), read);
+    offset += static_cast<off_t>(read);
+    destination_offset += static_cast<off_t>(read);
+    copied += read;
+    bytes -= read;
+  }
+  return copied;
+}
+
+File File::Reopen(const int flags) const {
+  File result;
+  // The /proc entry is a symbolic link, so O_NOFOLLOW would make this fail.
+  result.fd_ = CheckSyscall(open(ProcPath(fd_).c_str(), flags & ~O_NOFOLLOW));
   return result;
 }
 
+std::string File::ReopenPath() const { return ProcPath(fd_); }
+
 std::string File::ReadLinkAt(const char* const path) const {
   ValidatePath(path);
   std::vector<char> result(64, '\0');
@@ -145,6 +252,13 @@ void File::RenameAt(const char* old_path, const char* new_path) const {
   CheckSyscall(renameat(fd_, old_path, fd_, new_path));
 }
 
+void File::RenameAt(const char* const old_path, const File& new_directory,
+                    const char* const new_path) const {
+  ValidatePath(old_path);
+  ValidatePath(new_path);
+  CheckSyscall(renameat(fd_, old_path, new_directory.fd_, new_path));
+}
+
 void File::RmDirAt(const char* const path) const {
   ValidatePath(path);
   CheckSyscall(unlinkat(fd_, path, AT_REMOVEDIR));
@@ -161,6 +275,10 @@ void File::SymLinkAt(const char* const target, const char* const source) const {
   CheckSyscall(symlinkat(target, fd_, source));
 }
 
+void File::Sync(const bool data_only) const {
+  CheckSyscall(data_only ? fdatasync(fd_) : fsync(fd_));
+}
+
 void File::Truncate(const off_t size) { CheckSyscall(ftruncate(fd_, size)); }
 
 void File::UnlinkAt(const char* const path) const {
@@ -175,52 +293,79 @@ void File::UTimeNs(const char* const path, const timespec& access,
   CheckSyscall(utimensat(fd_, path, times.data(), AT_SYMLINK_NOFOLLOW));
 }
 
+void File::UTimeNs(const timespec& access,
+                   const timespec& modification) const {
+  std::array<const timespec, 2> times{{access, modification}};
+  CheckSyscall(utimensat(AT_FDCWD, ProcPath(fd_).c_str(), times.data(), 0));
+}
+
 size_t File::Write(const off_t offset,
                    const std::vector<std::uint8_t>& to_write) {
+  return Write(offset, to_write.data(), to_write.size());
+}
+
+size_t File::Write(const off_t offset, const void* const buffer,
+                   const size_t bytes) {
+  const auto* const cursor = static_cast<const std::uint8_t*>(buffer);
   size_t bytes_written = 0;
-  while (bytes_written < to_write.size()) {
-    bytes_written += static_cast<size_t>(CheckSyscall(pwrite(
-        fd_, to_write.data() + bytes_written, to_write.size() - bytes_written,
-        offset + static_cast<off_t>(bytes_written))));
+  while (bytes_written < bytes) {
+    bytes_written += static_cast<size_t>(CheckSyscall(
+        pwrite(fd_, cursor + bytes_written, bytes - bytes_written,
+               offset + static_cast<off_t>(bytes_written))));
   }
   return bytes_written;
 }
 
 int File::Duplicate() const { return CheckSyscall(dup(fd_)); }
 
-Directory::Directory(const File& file) {
-  // "After a successful call to fdopendir(), fd is used internally by the
-  // implementation, and should not otherwise be used by the application."  We
-  // therefore need to grab an unmanaged copy of the file descriptor from file.
-  if (!(stream_ = fdopendir(file.Duplicate()))) {
-    throw SystemError();
-  }
-  rewinddir(stream_);
+Directory::Directory(File file)
+    : fd_(file.fd_), buffer_(kDirectoryBufferBytes) {
+  file.fd_ = -1;
 }
 
 Directory::~Directory() noexcept {
   try {
-    CheckSyscall(closedir(stream_));
+    CheckSyscall(close(fd_));
   } catch (...) {
     LOG(ERROR) << "failed to close directory stream";
   }
 }
 
-long Directory::offset() const { return CheckSyscall(telldir(stream_)); }
-
-void Directory::Seek(const long offset) noexcept { seekdir(stream_, offset); }
+void Directory::Seek(const long offset) {
+  if (offset == offset_) {
+    return;
+  }
+  if (offset == previous_offset_) {
+    // We're backing up over the entry we just returned.  It's still buffered.
+    cursor_ = previous_cursor_;
+    offset_ = previous_offset_;
+    previous_offset_ = -1;
+    return;
+  }
+  CheckSyscall(lseek(fd_, offset, SEEK_SET));
+  cursor_ = size_ = 0;
+  offset_ = offset;
+  previous_offset_ = -1;
+}
 
-std::experimental::optional<dirent> Directory::ReadOne() {
-  dirent* result;
-  errno = 0;
-  if (!(result = readdir(stream_))) {
-    if (errno == 0) {
-      return std::experimental::nullopt;
-    } else {
-      throw SystemError();
+const dirent64* Directory::ReadOne() {
+  if (cursor_ == size_) {
+    const long bytes_read = CheckSyscall(
+        syscall(SYS_getdents64, fd_, buffer_.data(), buffer_.size()));
+    cursor_ = 0;
+    size_ = static_cast<size_t>(bytes_read);
+    previous_offset_ = -1;
+    if (bytes_read == 0) {
+      return nullptr;
     }
   }
-  return *result;
+  const auto* const result =
+      reinterpret_cast<const dirent64*>(buffer_.data() + cursor_);
+  previous_cursor_ = cursor_;
+  previous_offset_ = offset_;
+  cursor_ += result->d_reclen;
+  offset_ = result->d_off;
+  return result;
 }
 
 }  // scoville
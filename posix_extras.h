@@ -16,7 +16,6 @@
 #define POSIX_EXTRAS_H_
 
 #include <cstdint>
-#include <experimental/optional>
 #include <string>
 #include <vector>
 
@@ -30,17 +29,25 @@ namespace scoville {
 
 class File;
 
-// RAII wrapper for Unix directory streams.
+// A directory stream.  Rather than going through readdir(3), this pulls
+// entries from the kernel in large getdents64(2) batches.
 class Directory {
  public:
-  explicit Directory(const File&);
+  // Takes over the file's descriptor, which must have a file offset of its own
+  // (i.e., must not have been duplicated) and be at the start of the directory.
+  explicit Directory(File);
   virtual ~Directory() noexcept;
 
-  long offset() const;
+  // An opaque cookie identifying the position of the next entry ReadOne will
+  // return.
+  long offset() const noexcept { return offset_; }
 
-  void Seek(long) noexcept;
+  // Repositions the stream at a cookie previously returned by offset().
+  void Seek(long);
 
-  std::experimental::optional<dirent> ReadOne();
+  // Returns the next entry in the directory, or nullptr at the end of the
+  // directory.  The entry remains valid until the next call to ReadOne or Seek.
+  const dirent64* ReadOne();
 
  private:
   Directory(const Directory&) = delete;
@@ -49,7 +56,19 @@ class Directory {
   void operator=(const Directory&) = delete;
   void operator=(Directory&&) = delete;
 
-  DIR* stream_;
+  int fd_;
+
+  // Entries the kernel has returned but we haven't.  buffer_[cursor_, size_)
+  // is unread.
+  std::vector<char> buffer_;
+  size_t cursor_ = 0;
+  size_t size_ = 0;
+  long offset_ = 0;
+
+  // The cursor and offset before the most recent ReadOne, so seeking back one
+  // entry doesn't require a system call.
+  size_t previous_cursor_ = 0;
+  long previous_offset_ = -1;
 };
 
 // RAII wrapper for Unix file descriptors.
@@ -58,22 +77,47 @@ class File {
   File(const char* path, int flags) : File(path, flags, 0777) {}
   File(const char* path, int flags, mode_t mode);
   File(const File&);
-  File(File&& other) = default;
+  File(File&&) noexcept;
   virtual ~File() noexcept;
 
-  const std::string& path() const noexcept { return path_; }
+  // Takes ownership of a file descriptor opened by other means.
+  static File Adopt(int fd) noexcept;
+
+  // The underlying file descriptor.  The File retains ownership of it.
+  int fd() const noexcept { return fd_; }
 
   // Calls fstat(2) on the file descriptor.
   struct stat Stat() const;
 
+  // Tells the kernel how the given range of the file will be accessed, as
+  // posix_fadvise(2).  A length of zero extends the range to the end of the
+  // file.
+  void Advise(off_t offset, off_t length, int advice) const;
+
+  // Changes the file mode of the file.  Works even if the file descriptor was
+  // opened with O_PATH.
+  void ChMod(mode_t) const;
+
   // Changes the file mode of the path relative to the file descriptor.  The
   // path must indeed be relative (i.e., it must not start with '/').
   void ChModAt(const char* path, mode_t) const;
 
+  // Copies up to the specified number of bytes from the file at the given
+  // offset to the destination at its offset, stopping early at the end of this
+  // file.  Returns the number of bytes copied.  Uses copy_file_range(2), so a
+  // copy within one file system can stay in the kernel, and falls back to
+  // reading and writing through a buffer where that isn't supported.
+  size_t CopyRangeTo(off_t offset, File* destination, off_t destination_offset,
+                     size_t bytes) const;
+
   // Calls lstat(2) on the path relative to the file descriptor.  The path must
   // indeed be relative (i.e., it must not start with '/').
   struct stat LinkStatAt(const char* path) const;
 
+  // Like LinkStatAt, but returns false rather than throwing if the path doesn't
+  // exist.
+  bool TryLinkStatAt(const char* path, struct stat*) const;
+
   // Creates a directory at the path relative to the file descriptor.  The path
   // must indeed be relative (i.e., it must not start with '/').
   void MkDir(const char* path, mode_t mode) const;
@@ -94,6 +138,19 @@ class File {
   // fewer bytes are returned.
   std::vector<std::uint8_t> Read(off_t, size_t) const;
 
+  // Like the above, but reads directly into the caller-provided buffer, which
+  // must be at least the specified number of bytes long.  Returns the number of
+  // bytes read.
+  size_t Read(off_t, size_t, void* buffer) const;
+
+  // Opens the referent of the file descriptor anew with the specified flags.
+  // This is the only way to do I/O on a file whose descriptor was opened with
+  // O_PATH.
+  File Reopen(int flags) const;
+
+  // The path Reopen opens, for callers that need to open it themselves.
+  std::string ReopenPath() const;
+
   // Reads the contents of a symbolic link.  The path to the symbolic link is
   // interpreted relative to the file descriptor and must indeed be relative
   // (i.e., it must not start with '/').
@@ -104,6 +161,10 @@ class File {
   // they must not start with '/').
   void RenameAt(const char* old_path, const char* new_path) const;
 
+  // Like the above, but new_path is interpreted relative to new_directory.
+  void RenameAt(const char* old_path, const File& new_directory,
+                const char* new_path) const;
+
   // Removes the directory at the path relative to the file descriptor.  The
   // path must indeed be relative (i.e., it must not start with '/').
   void RmDirAt(const char* path) const;
@@ -117,6 +178,10 @@ class File {
   // indeed be relative (i.e., it must not start with '/').
   void SymLinkAt(const char* target, const char* source) const;
 
+  // Flushes the file's data, and unless data_only is set, its metadata, to the
+  // underlying device.
+  void Sync(bool data_only) const;
+
   // Truncates the file to the specified size.
   void Truncate(off_t);
 
@@ -130,11 +195,19 @@ class File {
   void UTimeNs(const char* path, const timespec& access,
                const timespec& modification) const;
 
+  // Sets the access and modification times of the file.  Works even if the file
+  // descriptor was opened with O_PATH.
+  void UTimeNs(const timespec& access, const timespec& modification) const;
+
   // Writes the specified byte vector to the file at the given offset.  Returns
   // the number of bytes written, which will always be the number of bytes given
   // as input.
   size_t Write(off_t, const std::vector<std::uint8_t>&);
 
+  // Like the above, but writes the specified number of bytes directly from the
+  // caller-provided buffer.
+  size_t Write(off_t, const void* buffer, size_t);
+
  private:
   File() {}
 
@@ -144,10 +217,9 @@ class File {
   // Duplicates fd_ and returns the raw new file descriptor.
   int Duplicate() const;
 
-  std::string path_;
   int fd_;
 
-  friend Directory::Directory(const File&);
+  friend Directory::Directory(File);
 };
 
 }  // scoville
@@ -0,0 +1,191 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#include "posix_extras.h"
+
+#include <cstdlib>
+#include <memory>
+#include <set>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include "test_util.h"
+
+namespace scoville {
+namespace {
+
+class ScovillePosixExtrasTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    file_.reset(new File(temporary_.path().c_str(), O_RDWR));
+    file_->Write(0, "0123456789", 10);
+  }
+
+  TemporaryFile temporary_{"posix_extras_test"};
+  std::unique_ptr<File> file_;
+};
+
+TEST_F(ScovillePosixExtrasTest, CopiesRange) {
+  const std::string path = temporary_.path() + ".copy";
+  File destination(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+  unlink(path.c_str());
+  destination.Write(0, "abc", 3);
+  EXPECT_EQ(file_->CopyRangeTo(2, &destination, 1, 4), 4);
+  EXPECT_EQ(Contents(destination), "a2345");
+}
+
+TEST_F(ScovillePosixExtrasTest, CopyStopsAtEndOfSource) {
+  const std::string path = temporary_.path() + ".copy";
+  File destination(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+  unlink(path.c_str());
+  EXPECT_EQ(file_->CopyRangeTo(6, &destination, 0, 100), 4);
+  EXPECT_EQ(Contents(destination), "6789");
+}
+
+TEST_F(ScovillePosixExtrasTest, CopyRejectsOverlappingRanges) {
+  // This is an error from copy_file_range, not a cue to copy by hand.
+  EXPECT_THROW(file_->CopyRangeTo(0, file_.get(), 2, 5), std::system_error);
+  EXPECT_EQ(Contents(*file_), "0123456789");
+}
+
+TEST_F(ScovillePosixExtrasTest, CopyFallsBackAcrossFileSystems) {
+  // copy_file_range refuses to copy between different file systems, so this
+  // exercises the read-and-write fallback.
+  char path[] = "/dev/shm/scoville_posix_extras_test.XXXXXX";
+  const int fd = mkstemp(path);
+  if (fd == -1) {
+    GTEST_SKIP() << "/dev/shm unavailable";
+  }
+  File destination = File::Adopt(fd);
+  unlink(path);
+  if (destination.Stat().st_dev == file_->Stat().st_dev) {
+    GTEST_SKIP() << "/dev/shm is on the same file system as the test";
+  }
+  EXPECT_EQ(file_->CopyRangeTo(3, &destination, 2, 5), 5);
+  EXPECT_EQ(Contents(destination), std::string("\0\0" "34567", 7));
+}
+
+// Enough long-named entries that a listing takes several getdents64 batches.
+constexpr int kDirectoryEntries = 1000;
+
+class ScovilleDirectoryTest : public testing::Test {
+ protected:
+  struct Entry {
+    long offset;  // where the entry was read from
+    std::string name;
+  };
+
+  void SetUp() override {
+    const File root(temporary_.path().c_str(), O_DIRECTORY);
+    for (int i = 0; i < kDirectoryEntries; ++i) {
+      root.OpenAt(Name(i).c_str(), O_WRONLY | O_CREAT, 0644);
+    }
+  }
+
+  static std::string Name(const int i) {
+    return std::to_string(i) + std::string(200, 'x');
+  }
+
+  std::unique_ptr<Directory> Open() const {
+    return std::unique_ptr<Directory>(new Directory(
+        File(temporary_.path().c_str(), O_RDONLY | O_DIRECTORY)));
+  }
+
+  // Reads the rest of the directory.
+  static std::vector<Entry> ReadAll(Directory* const directory) {
+    std::vector<Entry> result;
+    for (;;) {
+      const long offset = directory->offset();
+      const dirent64* const entry = directory->ReadOne();
+      if (entry == nullptr) {
+        return result;
+      }
+      result.push_back({offset, entry->d_name});
+    }
+  }
+
+  TemporaryDirectory temporary_{"posix_extras_test"};
+};
+
+TEST_F(ScovilleDirectoryTest, ReadsDirectoriesLargerThanOneBatch) {
+  const std::vector<Entry> entries = ReadAll(Open().get());
+  std::set<std::string> names;
+  for (const Entry& entry : entries) {
+    names.insert(entry.name);
+  }
+  EXPECT_EQ(names.size(), entries.size());
+
+  std::set<std::string> expected = {".", ".."};
+  for (int i = 0; i < kDirectoryEntries; ++i) {
+    expected.insert(Name(i));
+  }
+  EXPECT_EQ(names, expected);
+}
+
+TEST_F(ScovilleDirectoryTest, SeeksBackToPreviousEntry) {
+  const std::unique_ptr<Directory> directory = Open();
+  for (int i = 0; i < kDirectoryEntries + 2; ++i) {
+    const long offset = directory->offset();
+    const dirent64* entry = directory->ReadOne();
+    ASSERT_NE(entry, nullptr);
+    const std::string name = entry->d_name;
+    const long next = directory->offset();
+    directory->Seek(offset);
+    entry = directory->ReadOne();
+    ASSERT_NE(entry, nullptr);
+    EXPECT_EQ(entry->d_name, name);
+    EXPECT_EQ(directory->offset(), next);
+  }
+  EXPECT_EQ(directory->ReadOne(), nullptr);
+}
+
+TEST_F(ScovilleDirectoryTest, SeeksToArbitraryOffsets) {
+  const std::unique_ptr<Directory> directory = Open();
+  const std::vector<Entry> entries = ReadAll(directory.get());
+  ASSERT_EQ(entries.size(), kDirectoryEntries + 2);
+
+  for (const size_t start :
+       {entries.size() / 2, size_t(1), entries.size() - 1, size_t(0)}) {
+    directory->Seek(entries[start].offset);
+    const std::vector<Entry> rest = ReadAll(directory.get());
+    ASSERT_EQ(rest.size(), entries.size() - start);
+    for (size_t i = 0; i < rest.size(); ++i) {
+      EXPECT_EQ(rest[i].offset, entries[start + i].offset);
+      EXPECT_EQ(rest[i].name, entries[start + i].name);
+    }
+  }
+}
+
+TEST_F(ScovilleDirectoryTest, StaysAtEndOfDirectory) {
+  const std::unique_ptr<Directory> directory = Open();
+  const std::vector<Entry> entries = ReadAll(directory.get());
+  const long end = directory->offset();
+  EXPECT_EQ(directory->ReadOne(), nullptr);
+  EXPECT_EQ(directory->ReadOne(), nullptr);
+  EXPECT_EQ(directory->offset(), end);
+
+  directory->Seek(0);
+  const dirent64* const entry = directory->ReadOne();
+  ASSERT_NE(entry, nullptr);
+  EXPECT_EQ(entry->d_name, entries[0].name);
+}
+
+}  // namespace
+}  // namespace scoville
@@ -0,0 +1,108 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#include "readahead.h"
+
+#include <algorithm>
+#include <atomic>
+#include <system_error>
+
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <sys/types.h>
+
+#include "posix_extras.h"
+
+namespace scoville {
+
+namespace {
+
+// How many reads in a row make a stream sequential or random.
+constexpr int kSequentialReads = 2;
+constexpr int kRandomReads = 4;
+
+// The smallest window worth asking for.
+constexpr size_t kMinimumWindow = 128 * 1024;
+
+}  // namespace
+
+Readahead::Readahead(const size_t max_window)
+    : max_window_(max_window),
+      // Most sequential readers start at the beginning.
+      next_(0),
+      sequential_reads_(0),
+      random_reads_(0),
+      pattern_(Pattern::kUnknown),
+      window_(0),
+      advised_end_(0) {}
+
+void Readahead::Read(const File& file, const off_t offset,
+                     const size_t bytes) noexcept {
+  if (!enabled()) {
+    return;
+  }
+  const off_t end = offset + static_cast<off_t>(bytes);
+
+  if (next_.exchange(end, std::memory_order_relaxed) != offset) {
+    sequential_reads_.store(0, std::memory_order_relaxed);
+    window_.store(0, std::memory_order_relaxed);
+    if (random_reads_.fetch_add(1, std::memory_order_relaxed) + 1 >=
+            kRandomReads &&
+        pattern_.exchange(Pattern::kRandom, std::memory_order_relaxed) !=
+            Pattern::kRandom) {
+      Advise(file, 0, 0, POSIX_FADV_RANDOM);
+    }
+    return;
+  }
+
+  random_reads_.store(0, std::memory_order_relaxed);
+  if (sequential_reads_.fetch_add(1, std::memory_order_relaxed) + 1 <
+      kSequentialReads) {
+    return;
+  }
+  if (pattern_.exchange(Pattern::kSequential, std::memory_order_relaxed) !=
+      Pattern::kSequential) {
+    Advise(file, 0, 0, POSIX_FADV_SEQUENTIAL);
+  }
+
+  size_t window = window_.load(std::memory_order_relaxed);
+  off_t advised_end = advised_end_.load(std::memory_order_relaxed);
+  if (window == 0) {
+    window = std::min(std::max(kMinimumWindow, 2 * bytes), max_window_);
+    advised_end = end;
+  } else if (advised_end - end > static_cast<off_t>(window / 2)) {
+    // The reader is still well behind what's been requested.
+    return;
+  } else {
+    window = std::min(2 * window, max_window_);
+  }
+  const off_t start = std::max(advised_end, end);
+  const off_t new_end = end + static_cast<off_t>(window);
+  if (start < new_end) {
+    Advise(file, start, new_end - start, POSIX_FADV_WILLNEED);
+  }
+  window_.store(window, std::memory_order_relaxed);
+  advised_end_.store(new_end, std::memory_order_relaxed);
+}
+
+void Readahead::Advise(const File& file, const off_t offset,
+                       const off_t length, const int advice) noexcept {
+  try {
+    file.Advise(offset, length, advice);
+  } catch (const std::system_error& e) {
+    VLOG(1) << "posix_fadvise failed: " << e.what();
+  }
+}
+
+}  // namespace scoville
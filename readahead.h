@@ -0,0 +1,92 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#ifndef READAHEAD_H_
+#define READAHEAD_H_
+
+#include <atomic>
+#include <cstddef>
+
+#include <sys/types.h>
+
+#include "posix_extras.h"
+
+namespace scoville {
+
+// Watches the reads made through one file handle and tells the kernel what's
+// likely to be read next, so slow media can be read ahead of the reader.
+//
+// Once two reads in a row continue where the previous one left off, the
+// stream is sequential: the file is marked POSIX_FADV_SEQUENTIAL, and the
+// kernel is asked to start fetching a window beyond the current read with
+// POSIX_FADV_WILLNEED.  The window starts small and doubles, up to a maximum,
+// each time the reader catches up with its second half.  After several reads
+// that jump around, the file is marked POSIX_FADV_RANDOM instead, which turns
+// the kernel's own readahead off, and the window starts over.
+//
+// Thread-safe.  FUSE may deliver reads on one handle concurrently and out of
+// order; that can make the hints less accurate but never incorrect, since
+// they're only hints.
+class Readahead {
+ public:
+  // A maximum window of zero disables hints entirely.
+  explicit Readahead(size_t max_window);
+
+  bool enabled() const noexcept { return max_window_ != 0; }
+
+  // Notes that the range is about to be read from the file, hinting as
+  // appropriate.  Ignores errors from the hints.
+  void Read(const File&, off_t offset, size_t bytes) noexcept;
+
+  // How far ahead of the reader the kernel has been asked to read, or zero if
+  // the stream isn't sequential.
+  size_t window() const noexcept {
+    return window_.load(std::memory_order_relaxed);
+  }
+
+  enum class Pattern { kUnknown, kSequential, kRandom };
+  Pattern pattern() const noexcept {
+    return pattern_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  Readahead(const Readahead&) = delete;
+  Readahead(Readahead&&) = delete;
+
+  void operator=(const Readahead&) = delete;
+  void operator=(Readahead&&) = delete;
+
+  // Calls File::Advise, ignoring failures.
+  static void Advise(const File&, off_t offset, off_t length,
+                     int advice) noexcept;
+
+  const size_t max_window_;
+
+  // Where the next read will start if the stream is sequential.
+  std::atomic<off_t> next_;
+
+  // Consecutive sequential and nonsequential reads.
+  std::atomic<int> sequential_reads_;
+  std::atomic<int> random_reads_;
+
+  std::atomic<Pattern> pattern_;
+  std::atomic<size_t> window_;
+
+  // The end of the range most recently passed to POSIX_FADV_WILLNEED.
+  std::atomic<off_t> advised_end_;
+};
+
+}  // namespace scoville
+
+#endif  // READAHEAD_H_
@@ -0,0 +1,86 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#include "readahead.h"
+
+#include <memory>
+#include <string>
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include "posix_extras.h"
+#include "test_util.h"
+
+namespace scoville {
+namespace {
+
+using Pattern = Readahead::Pattern;
+
+constexpr size_t kBlock = 4096;
+
+class ScovilleReadaheadTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    file_.reset(new File(temporary_.path().c_str(), O_RDONLY));
+  }
+
+  TemporaryFile temporary_{"readahead_test"};
+  std::unique_ptr<File> file_;
+};
+
+TEST_F(ScovilleReadaheadTest, SequentialReadsGrowTheWindow) {
+  Readahead readahead(1 << 20);
+  readahead.Read(*file_, 0, kBlock);
+  EXPECT_EQ(readahead.pattern(), Pattern::kUnknown);
+  readahead.Read(*file_, kBlock, kBlock);
+  EXPECT_EQ(readahead.pattern(), Pattern::kSequential);
+  EXPECT_EQ(readahead.window(), 128 * 1024);
+
+  for (off_t offset = 2 * kBlock; offset < 4 << 20; offset += kBlock) {
+    readahead.Read(*file_, offset, kBlock);
+  }
+  EXPECT_EQ(readahead.pattern(), Pattern::kSequential);
+  EXPECT_EQ(readahead.window(), 1 << 20);
+}
+
+TEST_F(ScovilleReadaheadTest, ScatteredReadsAreRandom) {
+  Readahead readahead(1 << 20);
+  readahead.Read(*file_, 0, kBlock);
+  readahead.Read(*file_, kBlock, kBlock);
+  EXPECT_NE(readahead.window(), 0);
+  for (const off_t offset : {100000, 5000, 300000, 7}) {
+    readahead.Read(*file_, offset, kBlock);
+  }
+  EXPECT_EQ(readahead.pattern(), Pattern::kRandom);
+  EXPECT_EQ(readahead.window(), 0);
+
+  // A long enough sequential run switches back.
+  readahead.Read(*file_, 7 + kBlock, kBlock);
+  readahead.Read(*file_, 7 + 2 * kBlock, kBlock);
+  EXPECT_EQ(readahead.pattern(), Pattern::kSequential);
+}
+
+TEST_F(ScovilleReadaheadTest, ZeroWindowDisables) {
+  Readahead readahead(0);
+  EXPECT_FALSE(readahead.enabled());
+  readahead.Read(*file_, 0, kBlock);
+  readahead.Read(*file_, kBlock, kBlock);
+  EXPECT_EQ(readahead.pattern(), Pattern::kUnknown);
+  EXPECT_EQ(readahead.window(), 0);
+}
+
+}  // namespace
+}  // namespace scoville
@@ -0,0 +1,342 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#include "recording.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "posix_extras.h"
+#include "statistics.h"
+
+namespace scoville {
+
+namespace {
+
+// Identifies the file and the version of the format, which includes the order
+// of the Operation enumerators.
+constexpr char kMagic[] = "scoville recording 2\n";
+
+// Hand a thread's buffer to the writer once it's this big.
+constexpr size_t kBufferBytes = 1 << 16;
+
+// How often the writer collects buffers that aren't full.
+constexpr auto kFlushInterval = std::chrono::seconds(1);
+
+// Argument tags.
+constexpr char kEnd = 0;
+constexpr char kPath = 1;
+constexpr char kInteger = 2;
+
+void AppendVarint(std::uint64_t n, std::string* const out) {
+  while (n >= 0x80) {
+    out->push_back(static_cast<char>((n & 0x7f) | 0x80));
+    n >>= 7;
+  }
+  out->push_back(static_cast<char>(n));
+}
+
+void AppendZigzag(const std::int64_t n, std::string* const out) {
+  AppendVarint((static_cast<std::uint64_t>(n) << 1) ^
+                   static_cast<std::uint64_t>(n >> 63),
+               out);
+}
+
+std::int64_t Nanoseconds(const std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+      .count();
+}
+
+// Decodes a recording, which it holds in memory.
+class Decoder {
+ public:
+  explicit Decoder(std::vector<std::uint8_t> data) : data_(std::move(data)) {}
+
+  bool done() const noexcept { return position_ == data_.size(); }
+  size_t position() const noexcept { return position_; }
+  size_t remaining() const noexcept { return data_.size() - position_; }
+
+  std::uint8_t Byte() {
+    if (done()) {
+      throw std::runtime_error("recording is truncated");
+    }
+    return data_[position_++];
+  }
+
+  std::uint64_t Varint() {
+    std::uint64_t result = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      const std::uint8_t byte = Byte();
+      result |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        return result;
+      }
+    }
+    throw std::runtime_error("recording has an overlong varint");
+  }
+
+  std::int64_t Zigzag() {
+    const std::uint64_t n = Varint();
+    return static_cast<std::int64_t>(n >> 1) ^
+           -static_cast<std::int64_t>(n & 1);
+  }
+
+  std::string String(const size_t size) {
+    if (data_.size() - position_ < size) {
+      throw std::runtime_error("recording is truncated");
+    }
+    std::string result(reinterpret_cast<const char*>(&data_[position_]), size);
+    position_ += size;
+    return result;
+  }
+
+ private:
+  const std::vector<std::uint8_t> data_;
+  size_t position_ = 0;
+};
+
+}  // namespace
+
+void AppendCallHeader(const Operation operation,
+                      const std::chrono::steady_clock::duration duration,
+                      const int result, std::string* const record) {
+  record->push_back(static_cast<char>(operation));
+  AppendVarint(static_cast<std::uint64_t>(Nanoseconds(duration)), record);
+  AppendZigzag(result, record);
+}
+
+void AppendPath(const char* const path, std::string* const record) {
+  record->push_back(kPath);
+  const size_t size = path == nullptr ? 0 : std::strlen(path);
+  AppendVarint(size, record);
+  record->append(path == nullptr ? "" : path, size);
+}
+
+void AppendInteger(const std::int64_t n, std::string* const record) {
+  record->push_back(kInteger);
+  AppendZigzag(n, record);
+}
+
+// One thread's records for one recorder.  The thread holds mu while
+// appending, and the writer holds it while taking them, so the two only
+// contend once a second.
+struct Recorder::ThreadBuffer {
+  explicit ThreadBuffer(const std::uint64_t recorder_in)
+      : recorder(recorder_in) {}
+
+  const std::uint64_t recorder;
+
+  std::mutex mu;
+  std::string records;
+  // The start time the next record's is relative to.
+  std::chrono::steady_clock::time_point last_start;
+};
+
+std::atomic<std::uint64_t> Recorder::next_id_(0);
+thread_local std::shared_ptr<Recorder::ThreadBuffer>
+    Recorder::this_thread_buffer_;
+
+Recorder::Recorder(const char* const path)
+    : id_(next_id_.fetch_add(1)),
+      epoch_(std::chrono::steady_clock::now()),
+      file_(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644),
+      size_(sizeof(kMagic) - 1) {
+  file_.Write(0, kMagic, sizeof(kMagic) - 1);
+}
+
+Recorder::~Recorder() noexcept {
+  {
+    std::lock_guard<std::mutex> lock(queue_mu_);
+    stopping_ = true;
+  }
+  queue_ready_.notify_one();
+  if (writer_.joinable()) {
+    writer_.join();
+  }
+}
+
+void Recorder::Start() { writer_ = std::thread(&Recorder::WriteLoop, this); }
+
+void Recorder::Write(const std::chrono::steady_clock::time_point start,
+                     const std::string& record) {
+  ThreadBuffer& buffer = ThisThreadBuffer();
+  std::string full;
+  {
+    std::lock_guard<std::mutex> lock(buffer.mu);
+    if (buffer.records.empty()) {
+      buffer.records.reserve(kBufferBytes * 2);
+      buffer.last_start = epoch_;
+    }
+    AppendZigzag(Nanoseconds(start - buffer.last_start), &buffer.records);
+    buffer.last_start = start;
+    buffer.records.append(record);
+    buffer.records.push_back(kEnd);
+    if (buffer.records.size() < kBufferBytes) {
+      return;
+    }
+    std::swap(full, buffer.records);
+  }
+  {
+    std::lock_guard<std::mutex> lock(queue_mu_);
+    queue_.push_back(std::move(full));
+  }
+  queue_ready_.notify_one();
+}
+
+void Recorder::Flush() { WriteChunks(Collect()); }
+
+Recorder::ThreadBuffer& Recorder::ThisThreadBuffer() {
+  if (this_thread_buffer_ == nullptr || this_thread_buffer_->recorder != id_) {
+    auto buffer = std::make_shared<ThreadBuffer>(id_);
+    {
+      std::lock_guard<std::mutex> lock(buffers_mu_);
+      buffers_.push_back(buffer);
+    }
+    // If the thread had a buffer for an earlier recorder, that recorder still
+    // holds it.
+    this_thread_buffer_ = std::move(buffer);
+  }
+  return *this_thread_buffer_;
+}
+
+std::vector<std::string> Recorder::Collect() {
+  std::vector<std::string> result;
+  {
+    std::lock_guard<std::mutex> lock(queue_mu_);
+    std::swap(result, queue_);
+  }
+  std::lock_guard<std::mutex> lock(buffers_mu_);
+  for (auto it = buffers_.begin(); it != buffers_.end();) {
+    {
+      std::lock_guard<std::mutex> buffer_lock((*it)->mu);
+      if (!(*it)->records.empty()) {
+        result.emplace_back();
+        std::swap(result.back(), (*it)->records);
+      }
+    }
+    // If nothing else holds the buffer, its thread has exited or moved on to
+    // another recorder, and the buffer will never fill again.
+    if (it->use_count() == 1) {
+      it = buffers_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return result;
+}
+
+void Recorder::WriteChunks(const std::vector<std::string>& chunks) {
+  std::string data;
+  for (const std::string& chunk : chunks) {
+    AppendVarint(chunk.size(), &data);
+    data.append(chunk);
+  }
+  if (data.empty()) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(file_mu_);
+  file_.Write(size_, data.data(), data.size());
+  size_ += static_cast<off_t>(data.size());
+}
+
+void Recorder::WriteLoop() noexcept {
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(queue_mu_);
+      queue_ready_.wait_for(lock, kFlushInterval,
+                            [this] { return stopping_ || !queue_.empty(); });
+      if (stopping_) {
+        return;
+      }
+    }
+    try {
+      WriteChunks(Collect());
+    } catch (const std::system_error& e) {
+      LOG_EVERY_N(ERROR, 100) << "couldn't write recording: " << e.what();
+    } catch (const std::bad_alloc&) {
+      LOG_EVERY_N(ERROR, 100) << "couldn't write recording: out of memory";
+    }
+  }
+}
+
+std::vector<RecordedCall> ReadRecording(const char* const path) {
+  const File file(path, O_RDONLY | O_CLOEXEC, 0);
+  Decoder decoder(file.Read(0, static_cast<size_t>(file.Stat().st_size)));
+  if (decoder.String(sizeof(kMagic) - 1) != kMagic) {
+    throw std::runtime_error("not a Scoville recording");
+  }
+
+  std::vector<RecordedCall> result;
+  while (!decoder.done()) {
+    const std::uint64_t chunk_bytes = decoder.Varint();
+    if (chunk_bytes > decoder.remaining()) {
+      throw std::runtime_error("recording is truncated");
+    }
+    const size_t chunk_end =
+        decoder.position() + static_cast<size_t>(chunk_bytes);
+    std::int64_t start = 0;
+    while (decoder.position() < chunk_end) {
+      RecordedCall call;
+      start += decoder.Zigzag();
+      call.start = std::chrono::nanoseconds(start);
+      call.operation = static_cast<Operation>(decoder.Byte());
+      call.duration = std::chrono::nanoseconds(decoder.Varint());
+      call.result = static_cast<int>(decoder.Zigzag());
+      for (;;) {
+        const char tag = static_cast<char>(decoder.Byte());
+        if (tag == kEnd) {
+          break;
+        } else if (tag == kPath) {
+          call.paths.push_back(
+              decoder.String(static_cast<size_t>(decoder.Varint())));
+        } else if (tag == kInteger) {
+          call.integers.push_back(decoder.Zigzag());
+        } else {
+          throw std::runtime_error("recording has an unknown argument tag");
+        }
+      }
+      result.push_back(std::move(call));
+    }
+    if (decoder.position() != chunk_end) {
+      throw std::runtime_error("recording has a record spanning chunks");
+    }
+  }
+
+  // Calls are recorded as they finish, but they should be replayed as they
+  // started.
+  std::stable_sort(result.begin(), result.end(),
+                   [](const RecordedCall& a, const RecordedCall& b) {
+                     return a.start < b.start;
+                   });
+  return result;
+}
+
+}  // namespace scoville
@@ -0,0 +1,156 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+// Recordings of the FUSE calls Scoville receives, for replaying later as
+// benchmarks.
+//
+// A recording is a magic string followed by chunks of records, one record per
+// call.  Each thread fills chunks of its own, so records appear roughly in the
+// order calls finished, but only roughly.  A chunk is a varint length followed
+// by that many bytes of records, and each record is
+//
+//   - the call's start time, as a zigzag varint number of nanoseconds since
+//     the previous record's start time, or, for the first record in a chunk,
+//     since recording began;
+//   - the operation, as one byte;
+//   - the call's duration, as a varint number of nanoseconds;
+//   - its result, as a zigzag varint;
+//   - its arguments, each a tag byte followed by either a path (a varint length
+//     and that many bytes) or an integer (a zigzag varint); and
+//   - a zero byte.
+//
+// Which arguments a record holds depends on the operation; see
+// RecordArguments in operations.cc.  Recordings never include file contents.
+// Null paths are recorded as empty ones.
+
+#ifndef RECORDING_H_
+#define RECORDING_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "posix_extras.h"
+#include "statistics.h"
+
+namespace scoville {
+
+// Starts encoding a call in a record.
+void AppendCallHeader(Operation, std::chrono::steady_clock::duration,
+                      int result, std::string* record);
+
+// Encode the call's arguments.
+void AppendPath(const char*, std::string* record);
+void AppendInteger(std::int64_t, std::string* record);
+
+// Appends records to a recording file.  Thread-safe.
+//
+// Each thread buffers its records separately, so recording threads never
+// contend with each other.  Full buffers go to a writer thread, which also
+// collects partly full ones every second, so a recording of a process that
+// dies loses little.
+class Recorder {
+ public:
+  // Creates the file, replacing it if it exists.
+  explicit Recorder(const char* path);
+
+  // Stops the writer thread.  Records not yet flushed are lost.
+  virtual ~Recorder() noexcept;
+
+  // Starts the writer thread.  Until then, records are written only by Flush.
+  void Start();
+
+  // Finishes a record started with AppendCallHeader and queues it for writing.
+  void Write(std::chrono::steady_clock::time_point start,
+             const std::string& record);
+
+  // Writes every thread's records to the file.
+  void Flush();
+
+ private:
+  struct ThreadBuffer;
+
+  Recorder(const Recorder&) = delete;
+  Recorder(Recorder&&) = delete;
+
+  void operator=(const Recorder&) = delete;
+  void operator=(Recorder&&) = delete;
+
+  // Returns the calling thread's buffer for this recorder, creating it if
+  // need be.
+  ThreadBuffer& ThisThreadBuffer();
+
+  // Takes the records from every thread's buffer and from the queue.
+  std::vector<std::string> Collect();
+
+  // Writes the chunks to the file.
+  void WriteChunks(const std::vector<std::string>&);
+
+  void WriteLoop() noexcept;
+
+  // Distinguishes this recorder's thread buffers from those of recorders
+  // that came before.
+  const std::uint64_t id_;
+  const std::chrono::steady_clock::time_point epoch_;
+
+  std::mutex file_mu_;
+  File file_;
+  off_t size_;
+
+  std::mutex buffers_mu_;
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers_;
+
+  // Full buffers waiting for the writer thread.
+  std::mutex queue_mu_;
+  std::condition_variable queue_ready_;
+  std::vector<std::string> queue_;
+  bool stopping_ = false;
+
+  std::thread writer_;
+
+  static std::atomic<std::uint64_t> next_id_;
+  static thread_local std::shared_ptr<ThreadBuffer> this_thread_buffer_;
+};
+
+// A call read back from a recording.
+struct RecordedCall {
+  Operation operation;
+
+  // When the call started, relative to when recording began, and how long it
+  // took.
+  std::chrono::nanoseconds start;
+  std::chrono::nanoseconds duration;
+
+  int result;
+
+  // The arguments, in the order they were appended.
+  std::vector<std::string> paths;
+  std::vector<std::int64_t> integers;
+};
+
+// Reads a recording, returning its calls sorted by start time.  Throws
+// std::runtime_error if the recording is corrupt.
+std::vector<RecordedCall> ReadRecording(const char* path);
+
+}  // namespace scoville
+
+#endif  // RECORDING_H_
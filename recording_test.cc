@@ -0,0 +1,141 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#include "recording.h"
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include "posix_extras.h"
+#include "statistics.h"
+#include "test_util.h"
+
+namespace scoville {
+namespace {
+
+using std::chrono::milliseconds;
+
+class ScovilleRecordingTest : public testing::Test {
+ protected:
+  TemporaryFile temporary_{"recording_test"};
+  const char* const path_ = temporary_.path().c_str();
+};
+
+TEST_F(ScovilleRecordingTest, RoundTrips) {
+  const auto epoch = std::chrono::steady_clock::now();
+  {
+    Recorder recorder(path_);
+    std::string record;
+    AppendCallHeader(Operation::kRename, milliseconds(2), -2, &record);
+    AppendPath("/foo", &record);
+    AppendPath(nullptr, &record);
+    recorder.Write(epoch + milliseconds(10), record);
+
+    record.clear();
+    AppendCallHeader(Operation::kRead, milliseconds(1), 4096, &record);
+    AppendInteger(4096, &record);
+    AppendInteger(-1, &record);
+    recorder.Write(epoch + milliseconds(5), record);
+    recorder.Flush();
+  }
+
+  const std::vector<RecordedCall> calls = ReadRecording(path_);
+  ASSERT_EQ(calls.size(), 2);
+
+  // The calls come back in the order they started.
+  EXPECT_EQ(calls[0].operation, Operation::kRead);
+  EXPECT_EQ(calls[0].duration, milliseconds(1));
+  EXPECT_EQ(calls[0].result, 4096);
+  EXPECT_EQ(calls[0].integers, (std::vector<std::int64_t>{4096, -1}));
+  EXPECT_TRUE(calls[0].paths.empty());
+
+  EXPECT_EQ(calls[1].operation, Operation::kRename);
+  EXPECT_EQ(calls[1].start - calls[0].start, milliseconds(5));
+  EXPECT_EQ(calls[1].result, -2);
+  EXPECT_EQ(calls[1].paths, (std::vector<std::string>{"/foo", ""}));
+  EXPECT_TRUE(calls[1].integers.empty());
+}
+
+TEST_F(ScovilleRecordingTest, RejectsOtherFiles) {
+  File file(path_, O_WRONLY, 0);
+  file.Write(0, "hello\n", 6);
+  EXPECT_THROW(ReadRecording(path_), std::runtime_error);
+}
+
+TEST_F(ScovilleRecordingTest, RejectsTruncatedRecordings) {
+  {
+    Recorder recorder(path_);
+    std::string record;
+    AppendCallHeader(Operation::kUnlink, milliseconds(1), 0, &record);
+    AppendPath("/a/long/path", &record);
+    recorder.Write(std::chrono::steady_clock::now(), record);
+    recorder.Flush();
+  }
+  ASSERT_EQ(truncate(path_, 30), 0);
+  EXPECT_THROW(ReadRecording(path_), std::runtime_error);
+}
+
+TEST_F(ScovilleRecordingTest, RecordsFromManyThreads) {
+  constexpr int kThreads = 4;
+  constexpr int kCallsPerThread = 5000;
+  const auto epoch = std::chrono::steady_clock::now();
+  {
+    Recorder recorder(path_);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+      threads.emplace_back([&recorder, epoch, t] {
+        std::string record;
+        for (int i = 0; i < kCallsPerThread; ++i) {
+          record.clear();
+          AppendCallHeader(Operation::kGetattr, milliseconds(1), t, &record);
+          AppendPath("/some/path/or/other", &record);
+          recorder.Write(epoch + milliseconds(i * kThreads + t), record);
+        }
+      });
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    recorder.Flush();
+  }
+
+  const std::vector<RecordedCall> calls = ReadRecording(path_);
+  ASSERT_EQ(calls.size(), kThreads * kCallsPerThread);
+  for (size_t i = 1; i < calls.size(); ++i) {
+    EXPECT_EQ(calls[i].start - calls[i - 1].start, milliseconds(1));
+    EXPECT_EQ(calls[i].result, static_cast<int>(i % kThreads));
+  }
+}
+
+TEST_F(ScovilleRecordingTest, WriterFlushesPeriodically) {
+  Recorder recorder(path_);
+  recorder.Start();
+  std::string record;
+  AppendCallHeader(Operation::kUnlink, milliseconds(1), 0, &record);
+  recorder.Write(std::chrono::steady_clock::now(), record);
+  for (int i = 0; i < 500 && ReadRecording(path_).empty(); ++i) {
+    std::this_thread::sleep_for(milliseconds(10));
+  }
+  EXPECT_EQ(ReadRecording(path_).size(), 1);
+}
+
+}  // namespace
+}  // namespace scoville
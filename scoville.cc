@@ -14,7 +14,9 @@
 // You should have received a copy of the GNU General Public License along with
 // this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <cstdlib>
 #include <memory>
+#include <string>
 #include <system_error>
 #include <vector>
 
@@ -22,20 +24,148 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include "encoding.h"
 #include "fuse.h"
 #include "operations.h"
 #include "posix_extras.h"
+#if FUSE_USE_VERSION < 30
+#include "low_level_operations.h"
+#include "session_loop.h"
+#endif
+
+#if FUSE_USE_VERSION < 30
+DEFINE_bool(low_level, false,
+            "Use the FUSE low-level API, which tracks inodes instead of "
+            "resolving full paths on every operation.");
+#endif
+DEFINE_string(profile, "vfat",
+              "Naming rules of the underlying file system, which determine "
+              "which characters Scoville escapes: vfat, exfat, ntfs (also for "
+              "SMB shares), or posix.");
+DEFINE_double(kernel_cache_timeout, 1.0,
+              "Seconds for which the kernel may cache names and attributes "
+              "without asking Scoville.  Longer timeouts save round trips but "
+              "delay noticing changes made to the underlying file system "
+              "directly.");
+DEFINE_double(kernel_negative_timeout, 0.0,
+              "Seconds for which the kernel may remember that a name doesn't "
+              "exist.  Files created directly in the underlying file system "
+              "stay invisible for up to this long.");
+
+#if FUSE_USE_VERSION >= 30
+DEFINE_uint64(max_request_bytes, 1 << 20,
+              "Largest read or write to accept from the kernel in one "
+              "request.  libfuse and the kernel may lower it.");
+#else
+DEFINE_bool(io_uring, false,
+            "With --low_level, make reads, writes, and most metadata "
+            "operations asynchronously through io_uring, so a few threads can "
+            "keep many requests in flight.  Falls back to ordinary system "
+            "calls if the kernel doesn't support io_uring.");
+DEFINE_uint64(io_uring_entries, 256,
+              "With --io_uring, the most operations to keep in flight.");
+DEFINE_uint64(io_uring_buffers, 64,
+              "With --io_uring, the number of 128 KiB buffers to register "
+              "with the kernel for reads and writes.");
+
+DEFINE_int32(threads, 0,
+             "Serve requests with this many worker threads, each with its own "
+             "buffers.  Set to 0 to use libfuse's own loop, which starts "
+             "threads on demand (or runs single-threaded with -s).");
+DEFINE_bool(clone_fd, false,
+            "With --threads, give each worker its own clone of the FUSE "
+            "device file descriptor.  Requires Linux 4.2 or later.");
+DEFINE_bool(pin_threads, false, "With --threads, pin each worker to a CPU.");
+#endif
 
 constexpr char kUsage[] = R"(allow forbidden characters on VFAT file systems
 
 usage: scoville [flags] target_dir [-- fuse_options])";
 
+#if FUSE_USE_VERSION < 30
+namespace {
+
+scoville::SessionLoopOptions LoopOptions() {
+  scoville::SessionLoopOptions result;
+  result.threads = FLAGS_threads;
+  result.clone_fd = FLAGS_clone_fd;
+  result.pin_threads = FLAGS_pin_threads;
+  return result;
+}
+
+// fuse_main, but with our own session loop.
+int HighLevelMain(const int argc, char* argv[],
+                  const fuse_operations& operations) {
+  char* mountpoint;
+  int multithreaded;
+  fuse* const fuse = fuse_setup(argc, argv, &operations, sizeof(operations),
+                                &mountpoint, &multithreaded, nullptr);
+  if (fuse == nullptr) {
+    return 1;
+  }
+  int result = fuse_start_cleanup_thread(fuse);
+  if (result == 0) {
+    result = scoville::RunSessionLoop(fuse_get_session(fuse), LoopOptions());
+    fuse_stop_cleanup_thread(fuse);
+  }
+  fuse_teardown(fuse, mountpoint);
+  return result == 0 ? 0 : 1;
+}
+
+// The low-level equivalent of fuse_main.
+int LowLevelMain(const int argc, char* argv[],
+                 const fuse_lowlevel_ops& operations) {
+  fuse_args args = FUSE_ARGS_INIT(argc, argv);
+  char* mountpoint;
+  int multithreaded;
+  int foreground;
+  if (fuse_parse_cmdline(&args, &mountpoint, &multithreaded, &foreground) ==
+      -1) {
+    return 1;
+  }
+
+  int result = 1;
+  if (fuse_chan* const channel = fuse_mount(mountpoint, &args)) {
+    if (fuse_session* const session = fuse_lowlevel_new(
+            &args, &operations, sizeof(operations), nullptr)) {
+      if (fuse_set_signal_handlers(session) == 0) {
+        fuse_session_add_chan(session, channel);
+        if (fuse_daemonize(foreground) == 0) {
+          if (FLAGS_threads > 0) {
+            result = scoville::RunSessionLoop(session, LoopOptions());
+          } else if (multithreaded) {
+            result = fuse_session_loop_mt(session);
+          } else {
+            result = fuse_session_loop(session);
+          }
+        }
+        fuse_remove_signal_handlers(session);
+        fuse_session_remove_chan(channel);
+      }
+      fuse_session_destroy(session);
+    }
+    fuse_unmount(mountpoint, channel);
+  }
+  std::free(mountpoint);
+  fuse_opt_free_args(&args);
+  return result == 0 ? 0 : 1;
+}
+
+}  // namespace
+#endif
+
 int main(int argc, char* argv[]) {
   google::InstallFailureSignalHandler();
   google::SetUsageMessage(kUsage);
   google::ParseCommandLineFlags(&argc, &argv, true);
   google::InitGoogleLogging(argv[0]);
 
+  scoville::Profile profile;
+  if (!scoville::ParseProfile(FLAGS_profile, &profile)) {
+    LOG(FATAL) << "scoville: unknown profile `" << FLAGS_profile << "'";
+  }
+  scoville::SetProfile(profile);
+
   // This is an overlay file system, which means once we start FUSE, the
   // underlying file system will be inaccessible through normal means.  Open a
   // file descriptor to the underlying root now so we can still do operations on
@@ -48,14 +178,42 @@ int main(int argc, char* argv[]) {
     LOG(FATAL) << "scoville: bad mount point `" << root_path
                << "': " << e.what();
   }
-  LOG(INFO) << "overlaying " << root->path();
-  const fuse_operations operations = scoville::FuseOperations(root.get());
+  LOG(INFO) << "overlaying " << root_path;
 
-  // Add -o nonempty to argv so FUSE won't complain about overlaying.
   char hyphen_o[] = "-o";
-  char nonempty[] = "nonempty";
   std::vector<char*> new_argv(argv, argv + argc);
+#if FUSE_USE_VERSION >= 30
+  // FUSE 3 overlays nonempty directories without complaint, but it wants the
+  // largest read both as a mount option and from init.
+  std::string max_read = "max_read=" + std::to_string(FLAGS_max_request_bytes);
+  new_argv.emplace_back(hyphen_o);
+  new_argv.emplace_back(&max_read[0]);
+#else
+  // Add -o nonempty to argv so FUSE won't complain about overlaying.
+  char nonempty[] = "nonempty";
   new_argv.emplace_back(hyphen_o);
   new_argv.emplace_back(nonempty);
+
+  if (FLAGS_low_level) {
+    const fuse_lowlevel_ops operations =
+        scoville::FuseLowLevelOperations(root.get());
+    return LowLevelMain(new_argv.size(), new_argv.data(), operations);
+  }
+#endif
+
+  // The low-level API takes the kernel cache timeouts with each reply, but the
+  // high-level API wants them as options.
+  std::string timeouts =
+      "attr_timeout=" + std::to_string(FLAGS_kernel_cache_timeout) +
+      ",entry_timeout=" + std::to_string(FLAGS_kernel_cache_timeout) +
+      ",negative_timeout=" + std::to_string(FLAGS_kernel_negative_timeout);
+  new_argv.emplace_back(hyphen_o);
+  new_argv.emplace_back(&timeouts[0]);
+  const fuse_operations operations = scoville::FuseOperations(root.get());
+#if FUSE_USE_VERSION < 30
+  if (FLAGS_threads > 0) {
+    return HighLevelMain(new_argv.size(), new_argv.data(), operations);
+  }
+#endif
   return fuse_main(new_argv.size(), new_argv.data(), &operations, nullptr);
 }
@@ -0,0 +1,419 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+// An end-to-end benchmark.  It runs a set of file system workloads in a
+// directory, mounts Scoville over the directory, runs the same workloads again
+// through Scoville, and reports each workload's throughput and p50/p99
+// latencies both ways.
+//
+// Point --directory at a tmpfs to measure Scoville's own overhead, or at a
+// loopback-mounted vfat image to measure it against the file system it's meant
+// for.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+DEFINE_string(directory, "",
+              "Directory to run the workloads in and to mount Scoville over.  "
+              "It should be empty.");
+DEFINE_string(scoville, "./scoville", "Path to the Scoville binary.");
+DEFINE_string(scoville_args, "",
+              "Extra whitespace-separated arguments to pass to Scoville.");
+DEFINE_string(workloads, "",
+              "Comma-separated workloads to run.  Leave empty to run all.");
+DEFINE_uint64(file_bytes, 64 << 20,
+              "Size of the file the sequential read and write workloads use.");
+DEFINE_int32(small_files, 2000,
+             "Number of files the create/unlink workload creates.");
+DEFINE_int32(depth, 16, "Depth of the tree the getattr workload stats.");
+DEFINE_int32(getattrs, 20000, "Number of stats the getattr workload makes.");
+DEFINE_int32(directory_entries, 10000,
+             "Number of entries in the directory the readdir workload lists.");
+DEFINE_int32(listings, 20,
+             "Number of times the readdir workload lists the directory.");
+DEFINE_int32(renames, 5000, "Number of renames the rename workload makes.");
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// What running a workload once produced.
+struct Sample {
+  // Latency of each operation, in nanoseconds.
+  std::vector<double> latencies;
+
+  // Units of work done (bytes, files, entries, ...) and the total time taken.
+  double work = 0;
+  double seconds = 0;
+};
+
+struct Workload {
+  std::string name;
+  const char* unit;  // what Sample::work counts
+
+  // Runs the workload in the given (empty, existing) directory.
+  std::function<Sample(const std::string&)> run;
+};
+
+// Times work that counts toward the sample's total time but isn't one of the
+// operations whose latencies the workload measures.  Returns the time taken.
+template <typename F>
+Clock::duration TimeTotal(Sample* const sample, F f) {
+  const Clock::time_point start = Clock::now();
+  f();
+  const Clock::duration elapsed = Clock::now() - start;
+  sample->seconds += std::chrono::duration<double>(elapsed).count();
+  return elapsed;
+}
+
+// Times one operation, appending its latency to the sample.
+template <typename F>
+void Time(Sample* const sample, F f) {
+  const Clock::duration elapsed = TimeTotal(sample, f);
+  sample->latencies.push_back(
+      std::chrono::duration<double, std::nano>(elapsed).count());
+}
+
+int Open(const std::string& path, const int flags) {
+  const int fd = open(path.c_str(), flags | O_CLOEXEC, 0644);
+  PCHECK(fd != -1) << "couldn't open " << path;
+  return fd;
+}
+
+void MakeDirectory(const std::string& path) {
+  PCHECK(mkdir(path.c_str(), 0755) == 0) << "couldn't create " << path;
+}
+
+// Removes a tree, children first, without following symbolic links.
+void RemoveTree(const std::string& path) {
+  PCHECK(nftw(path.c_str(),
+              [](const char* const entry, const struct stat*, int, FTW*) {
+                return std::remove(entry);
+              },
+              64, FTW_DEPTH | FTW_PHYS) == 0)
+      << "couldn't remove " << path;
+}
+
+// Writes --file_bytes to the file in pieces the size of the buffer, the last
+// one short if the file size isn't a multiple of it.  Each write is passed to
+// time, which must call it.
+template <typename Timer>
+void WriteFile(const int fd, const std::vector<char>& buffer, Timer time) {
+  for (std::uint64_t written = 0; written < FLAGS_file_bytes;) {
+    const size_t bytes = static_cast<size_t>(
+        std::min<std::uint64_t>(buffer.size(), FLAGS_file_bytes - written));
+    time([&] {
+      PCHECK(write(fd, buffer.data(), bytes) == static_cast<ssize_t>(bytes));
+    });
+    written += bytes;
+  }
+}
+
+Sample SequentialWrite(const std::string& directory, const size_t block) {
+  std::vector<char> buffer(block, 'x');
+  const std::string path = directory + "/file";
+  Sample sample;
+  const int fd = Open(path, O_WRONLY | O_CREAT | O_TRUNC);
+  WriteFile(fd, buffer, [&sample](auto write) { Time(&sample, write); });
+  // The data aren't written until they're on the medium, so the fsync counts
+  // toward throughput.  It isn't a write, though, so it has no latency sample.
+  TimeTotal(&sample, [fd] { PCHECK(fsync(fd) == 0); });
+  close(fd);
+  sample.work = static_cast<double>(FLAGS_file_bytes);
+  return sample;
+}
+
+Sample SequentialRead(const std::string& directory, const size_t block) {
+  const std::string path = directory + "/file";
+  {
+    const std::vector<char> buffer(1 << 20, 'x');
+    const int fd = Open(path, O_WRONLY | O_CREAT | O_TRUNC);
+    WriteFile(fd, buffer, [](auto write) { write(); });
+    close(fd);
+  }
+
+  std::vector<char> buffer(block);
+  Sample sample;
+  const int fd = Open(path, O_RDONLY);
+  for (;;) {
+    ssize_t bytes_read;
+    Time(&sample, [&] { bytes_read = read(fd, buffer.data(), block); });
+    PCHECK(bytes_read != -1);
+    if (bytes_read == 0) {
+      break;
+    }
+    sample.work += static_cast<double>(bytes_read);
+  }
+  close(fd);
+  return sample;
+}
+
+Sample CreateUnlink(const std::string& directory) {
+  const char contents[] = "hello, world\n";
+  Sample sample;
+  for (int i = 0; i < FLAGS_small_files; ++i) {
+    const std::string path = directory + "/" + std::to_string(i);
+    Time(&sample, [&] {
+      const int fd = Open(path, O_WRONLY | O_CREAT | O_EXCL);
+      PCHECK(write(fd, contents, sizeof(contents)) != -1);
+      close(fd);
+    });
+  }
+  for (int i = 0; i < FLAGS_small_files; ++i) {
+    const std::string path = directory + "/" + std::to_string(i);
+    Time(&sample, [&] { PCHECK(unlink(path.c_str()) == 0); });
+  }
+  sample.work = FLAGS_small_files;
+  return sample;
+}
+
+Sample GetattrStorm(const std::string& directory) {
+  std::string path = directory;
+  for (int i = 0; i < FLAGS_depth; ++i) {
+    path += "/level" + std::to_string(i);
+    MakeDirectory(path);
+  }
+  close(Open(path + "/file", O_WRONLY | O_CREAT));
+  const std::vector<std::string> paths = {path + "/file", path + "/missing",
+                                          path};
+
+  Sample sample;
+  struct stat stats;
+  for (int i = 0; i < FLAGS_getattrs; ++i) {
+    const std::string& target = paths[static_cast<size_t>(i) % paths.size()];
+    Time(&sample, [&] { lstat(target.c_str(), &stats); });
+  }
+  sample.work = FLAGS_getattrs;
+  return sample;
+}
+
+Sample ListDirectory(const std::string& directory) {
+  for (int i = 0; i < FLAGS_directory_entries; ++i) {
+    close(Open(directory + "/entry" + std::to_string(i),
+               O_WRONLY | O_CREAT));
+  }
+
+  Sample sample;
+  for (int i = 0; i < FLAGS_listings; ++i) {
+    Time(&sample, [&] {
+      DIR* const stream = opendir(directory.c_str());
+      PCHECK(stream != nullptr);
+      while (readdir(stream) != nullptr) {
+        sample.work += 1;
+      }
+      closedir(stream);
+    });
+  }
+  return sample;
+}
+
+Sample RenameChurn(const std::string& directory) {
+  const std::string names[] = {directory + "/a", directory + "/b"};
+  close(Open(names[0], O_WRONLY | O_CREAT));
+  Sample sample;
+  for (int i = 0; i < FLAGS_renames; ++i) {
+    const std::string& from = names[i % 2];
+    const std::string& to = names[(i + 1) % 2];
+    Time(&sample, [&] { PCHECK(rename(from.c_str(), to.c_str()) == 0); });
+  }
+  sample.work = FLAGS_renames;
+  return sample;
+}
+
+std::vector<Workload> AllWorkloads() {
+  std::vector<Workload> result;
+  for (const size_t block : {4 << 10, 64 << 10, 1 << 20}) {
+    const std::string size = std::to_string(block >> 10) + "k";
+    result.push_back({"write_" + size, "bytes", [block](const std::string& d) {
+                        return SequentialWrite(d, block);
+                      }});
+    result.push_back({"read_" + size, "bytes", [block](const std::string& d) {
+                        return SequentialRead(d, block);
+                      }});
+  }
+  result.push_back({"create_unlink", "files", CreateUnlink});
+  result.push_back({"getattr", "stats", GetattrStorm});
+  result.push_back({"readdir", "entries", ListDirectory});
+  result.push_back({"rename", "renames", RenameChurn});
+  return result;
+}
+
+bool Selected(const std::string& name) {
+  if (FLAGS_workloads.empty()) {
+    return true;
+  }
+  std::stringstream workloads(FLAGS_workloads);
+  std::string workload;
+  while (std::getline(workloads, workload, ',')) {
+    if (workload == name) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Runs each workload in its own scratch directory, returning the samples in
+// the same order.
+std::vector<Sample> RunAll(const std::vector<Workload>& workloads) {
+  std::vector<Sample> result;
+  for (const Workload& workload : workloads) {
+    const std::string scratch = FLAGS_directory + "/bench-" + workload.name;
+    MakeDirectory(scratch);
+    result.push_back(workload.run(scratch));
+    RemoveTree(scratch);
+  }
+  return result;
+}
+
+// Starts a command in a child process, returning the child's PID.
+pid_t Spawn(const std::vector<std::string>& command) {
+  std::vector<char*> argv;
+  for (const std::string& arg : command) {
+    argv.push_back(const_cast<char*>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+
+  const pid_t child = fork();
+  PCHECK(child != -1);
+  if (child == 0) {
+    execvp(argv[0], argv.data());
+    _exit(127);
+  }
+  return child;
+}
+
+// Runs a command to completion, returning its exit status.
+int Run(const std::vector<std::string>& command) {
+  const pid_t child = Spawn(command);
+  int status;
+  PCHECK(waitpid(child, &status, 0) == child);
+  return status;
+}
+
+dev_t DeviceOf(const std::string& path) {
+  struct stat stats;
+  PCHECK(stat(path.c_str(), &stats) == 0) << "couldn't stat " << path;
+  return stats.st_dev;
+}
+
+// Starts Scoville over --directory and waits for the mount to appear.
+pid_t Mount() {
+  std::vector<std::string> command = {FLAGS_scoville};
+  std::stringstream args(FLAGS_scoville_args);
+  std::string arg;
+  while (args >> arg) {
+    command.push_back(arg);
+  }
+  command.insert(command.end(), {"--", "-f", FLAGS_directory});
+
+  const dev_t unmounted = DeviceOf(FLAGS_directory);
+  const pid_t scoville = Spawn(command);
+
+  for (int i = 0; DeviceOf(FLAGS_directory) == unmounted; ++i) {
+    CHECK_LT(i, 1000) << "scoville didn't mount " << FLAGS_directory;
+    int status;
+    if (waitpid(scoville, &status, WNOHANG) == scoville) {
+      LOG(FATAL) << "scoville exited early with status " << status;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return scoville;
+}
+
+void Unmount(const pid_t scoville) {
+  CHECK(Run({"fusermount", "-u", FLAGS_directory}) == 0)
+      << "couldn't unmount " << FLAGS_directory;
+  int status;
+  PCHECK(waitpid(scoville, &status, 0) == scoville);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    LOG(WARNING) << "scoville exited with status " << status;
+  }
+}
+
+double Percentile(std::vector<double> latencies, const double p) {
+  if (latencies.empty()) {
+    return 0;
+  }
+  const size_t index =
+      static_cast<size_t>(p * static_cast<double>(latencies.size() - 1));
+  std::nth_element(latencies.begin(), latencies.begin() + index,
+                   latencies.end());
+  return latencies[index];
+}
+
+void Report(const std::vector<Workload>& workloads,
+            const std::vector<Sample>& raw,
+            const std::vector<Sample>& scoville) {
+  std::printf("%-14s %-8s %14s %14s %8s %10s %10s %10s %10s\n", "workload",
+              "unit", "raw/s", "scoville/s", "ratio", "raw p50", "raw p99",
+              "sco p50", "sco p99");
+  for (size_t i = 0; i < workloads.size(); ++i) {
+    const double raw_rate = raw[i].work / raw[i].seconds;
+    const double scoville_rate = scoville[i].work / scoville[i].seconds;
+    std::printf(
+        "%-14s %-8s %14.0f %14.0f %8.2f %8.1fus %8.1fus %8.1fus %8.1fus\n",
+        workloads[i].name.c_str(), workloads[i].unit, raw_rate, scoville_rate,
+        raw_rate / scoville_rate, Percentile(raw[i].latencies, 0.5) / 1e3,
+        Percentile(raw[i].latencies, 0.99) / 1e3,
+        Percentile(scoville[i].latencies, 0.5) / 1e3,
+        Percentile(scoville[i].latencies, 0.99) / 1e3);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  google::InstallFailureSignalHandler();
+  google::SetUsageMessage("measure Scoville's overhead end to end");
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  if (FLAGS_directory.empty()) {
+    LOG(FATAL) << "--directory is required";
+  }
+
+  std::vector<Workload> workloads;
+  for (Workload& workload : AllWorkloads()) {
+    if (Selected(workload.name)) {
+      workloads.push_back(std::move(workload));
+    }
+  }
+
+  LOG(INFO) << "running workloads on the raw directory";
+  const std::vector<Sample> raw = RunAll(workloads);
+
+  LOG(INFO) << "running workloads through Scoville";
+  const pid_t scoville = Mount();
+  const std::vector<Sample> through_scoville = RunAll(workloads);
+  Unmount(scoville);
+
+  Report(workloads, raw, through_scoville);
+  return 0;
+}
@@ -0,0 +1,327 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+// Replays a recording made with scoville --record_file against a directory,
+// normally a fresh Scoville mount over a copy of the tree the recording was
+// made on, and reports how long it took.
+//
+// Each recorded FUSE call becomes the system call most likely to produce it.
+// The kernel caches and splits calls as it sees fit, so the calls Scoville
+// receives during a replay resemble the recorded ones but needn't match them
+// exactly.  Since recordings don't include file contents, writes write
+// whatever's in the replayer's buffer.
+//
+// By default, calls are issued open-loop at the times they were recorded, so
+// the replay applies the same load the original workload did.  The replayer
+// is single-threaded, though, so it falls behind if a call takes longer than
+// the gap before the next; it reports how far.  With --as_fast_as_possible,
+// calls are issued back to back instead.
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "recording.h"
+#include "statistics.h"
+
+DEFINE_string(recording, "", "Recording to replay.");
+DEFINE_string(directory, "",
+              "Directory to replay the recording in, usually a Scoville mount "
+              "point.");
+DEFINE_bool(as_fast_as_possible, false,
+            "Issue calls back to back instead of at their recorded times.");
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+using scoville::Operation;
+using scoville::RecordedCall;
+
+// Turns a system call's return value into the form FUSE operations return.
+int Result(const long result) { return result < 0 ? -errno : 0; }
+
+// Issues recorded calls against a directory.
+class Replayer {
+ public:
+  explicit Replayer(std::string directory) : directory_(std::move(directory)) {}
+
+  // Issues the system call corresponding to the recorded call, returning 0 or
+  // a negated errno value.
+  int Replay(const RecordedCall&);
+
+ private:
+  Replayer(const Replayer&) = delete;
+  Replayer(Replayer&&) = delete;
+
+  void operator=(const Replayer&) = delete;
+  void operator=(Replayer&&) = delete;
+
+  std::string Path(const RecordedCall& call, const size_t i) const {
+    return directory_ + call.paths.at(i);
+  }
+
+  // Returns the file descriptor standing in for a recorded handle, or -1 if
+  // there isn't one (e.g., because opening it failed).
+  int Descriptor(const std::int64_t handle) const {
+    const auto it = descriptors_.find(handle);
+    return it == descriptors_.end() ? -1 : it->second;
+  }
+
+  // Remembers the descriptor for a handle that a successful call created.
+  int Open(const RecordedCall& call, const std::int64_t handle, const int fd) {
+    if (fd == -1) {
+      return -errno;
+    }
+    if (call.result < 0) {
+      // The original open failed, so nothing will refer to this handle.
+      close(fd);
+      return 0;
+    }
+    const auto inserted = descriptors_.emplace(handle, fd);
+    if (!inserted.second) {
+      close(inserted.first->second);
+      inserted.first->second = fd;
+    }
+    return 0;
+  }
+
+  int Close(const std::int64_t handle) {
+    const auto it = descriptors_.find(handle);
+    if (it == descriptors_.end()) {
+      return -EBADF;
+    }
+    const int result = Result(close(it->second));
+    descriptors_.erase(it);
+    return result;
+  }
+
+  // Makes sure buffer_ holds at least the given number of bytes.
+  char* Buffer(const std::int64_t bytes) {
+    if (buffer_.size() < static_cast<size_t>(bytes)) {
+      buffer_.resize(static_cast<size_t>(bytes));
+    }
+    return buffer_.data();
+  }
+
+  const std::string directory_;
+  std::unordered_map<std::int64_t, int> descriptors_;
+  std::vector<char> buffer_;
+};
+
+int Replayer::Replay(const RecordedCall& call) {
+  const std::vector<std::int64_t>& n = call.integers;
+  switch (call.operation) {
+    case Operation::kStatfs: {
+      struct statvfs buffer;
+      return Result(statvfs(Path(call, 0).c_str(), &buffer));
+    }
+    case Operation::kGetattr: {
+      struct stat buffer;
+      return Result(lstat(Path(call, 0).c_str(), &buffer));
+    }
+    case Operation::kFgetattr: {
+      struct stat buffer;
+      return Result(fstat(Descriptor(n.at(0)), &buffer));
+    }
+    case Operation::kMknod:
+      return Result(mknod(Path(call, 0).c_str(), static_cast<mode_t>(n.at(0)),
+                          static_cast<dev_t>(n.at(1))));
+    case Operation::kChmod:
+      return Result(
+          chmod(Path(call, 0).c_str(), static_cast<mode_t>(n.at(0))));
+    case Operation::kRename:
+      return Result(rename(Path(call, 0).c_str(), Path(call, 1).c_str()));
+    case Operation::kCreate:
+      return Open(call, n.at(2),
+                  open(Path(call, 0).c_str(),
+                       static_cast<int>(n.at(1)) | O_CREAT | O_CLOEXEC,
+                       static_cast<mode_t>(n.at(0))));
+    case Operation::kOpen:
+      return Open(
+          call, n.at(1),
+          open(Path(call, 0).c_str(), static_cast<int>(n.at(0)) | O_CLOEXEC));
+    case Operation::kRead:
+    case Operation::kReadBuf:
+      return Result(pread(Descriptor(n.at(2)), Buffer(n.at(0)),
+                          static_cast<size_t>(n.at(0)), n.at(1)));
+    case Operation::kWrite:
+    case Operation::kWriteBuf:
+      return Result(pwrite(Descriptor(n.at(2)), Buffer(n.at(0)),
+                           static_cast<size_t>(n.at(0)), n.at(1)));
+    case Operation::kUtimens: {
+      const timespec times[2] = {{n.at(0), n.at(1)}, {n.at(2), n.at(3)}};
+      return Result(utimensat(AT_FDCWD, Path(call, 0).c_str(), times,
+                              AT_SYMLINK_NOFOLLOW));
+    }
+    case Operation::kRelease:
+    case Operation::kReleasedir:
+      return Close(n.at(1));
+    case Operation::kTruncate:
+      return Result(truncate(Path(call, 0).c_str(), n.at(0)));
+    case Operation::kFtruncate:
+      return Result(ftruncate(Descriptor(n.at(1)), n.at(0)));
+    case Operation::kUnlink:
+      return Result(unlink(Path(call, 0).c_str()));
+    case Operation::kSymlink:
+      // The target is stored verbatim, not relative to the mount.
+      return Result(symlink(call.paths.at(0).c_str(), Path(call, 1).c_str()));
+    case Operation::kReadlink:
+      return Result(readlink(Path(call, 0).c_str(), Buffer(n.at(0)),
+                             static_cast<size_t>(n.at(0))));
+    case Operation::kMkdir:
+      return Result(
+          mkdir(Path(call, 0).c_str(), static_cast<mode_t>(n.at(0))));
+    case Operation::kOpendir:
+      return Open(call, n.at(1),
+                  open(Path(call, 0).c_str(),
+                       O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    case Operation::kReaddir: {
+      const int fd = Descriptor(n.at(1));
+      if (lseek(fd, n.at(0), SEEK_SET) == -1) {
+        return -errno;
+      }
+      constexpr size_t kBytes = 1 << 15;
+      return Result(syscall(SYS_getdents64, fd, Buffer(kBytes), kBytes));
+    }
+    case Operation::kRmdir:
+      return Result(rmdir(Path(call, 0).c_str()));
+    case Operation::kFlush: {
+      // Closing any descriptor for an open file makes the kernel flush it.
+      const int fd = dup(Descriptor(n.at(1)));
+      if (fd == -1) {
+        return -errno;
+      }
+      return Result(close(fd));
+    }
+    case Operation::kFsync: {
+      const int fd = Descriptor(n.at(1));
+      return Result(n.at(0) != 0 ? fdatasync(fd) : fsync(fd));
+    }
+    case Operation::kCopyFileRange: {
+      loff_t in_offset = n.at(1);
+      loff_t out_offset = n.at(3);
+      return Result(copy_file_range(Descriptor(n.at(2)), &in_offset,
+                                    Descriptor(n.at(4)), &out_offset,
+                                    static_cast<size_t>(n.at(0)), 0));
+    }
+  }
+  LOG(FATAL) << "unknown operation " << static_cast<int>(call.operation);
+}
+
+// What replaying one kind of operation produced.
+struct Sample {
+  // Latency of each call, in nanoseconds.
+  std::vector<double> latencies;
+
+  // Calls that succeeded when recorded but failed when replayed, or vice versa.
+  int mismatches = 0;
+};
+
+double Percentile(std::vector<double> latencies, const double p) {
+  if (latencies.empty()) {
+    return 0;
+  }
+  const size_t index =
+      static_cast<size_t>(p * static_cast<double>(latencies.size() - 1));
+  std::nth_element(latencies.begin(), latencies.begin() + index,
+                   latencies.end());
+  return latencies[index];
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  google::InstallFailureSignalHandler();
+  google::SetUsageMessage("replay a Scoville recording");
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  if (FLAGS_recording.empty() || FLAGS_directory.empty()) {
+    LOG(FATAL) << "--recording and --directory are required";
+  }
+
+  const std::vector<RecordedCall> calls =
+      scoville::ReadRecording(FLAGS_recording.c_str());
+  LOG(INFO) << "replaying " << calls.size() << " calls";
+
+  Replayer replayer(FLAGS_directory);
+  std::map<Operation, Sample> samples;
+  Clock::duration max_lag = Clock::duration::zero();
+  const Clock::time_point begin = Clock::now();
+  for (const RecordedCall& call : calls) {
+    if (!FLAGS_as_fast_as_possible) {
+      const Clock::time_point scheduled =
+          begin + std::chrono::duration_cast<Clock::duration>(
+                      call.start - calls.front().start);
+      const Clock::time_point now = Clock::now();
+      if (now < scheduled) {
+        std::this_thread::sleep_until(scheduled);
+      } else {
+        max_lag = std::max(max_lag, now - scheduled);
+      }
+    }
+
+    const Clock::time_point start = Clock::now();
+    const int result = replayer.Replay(call);
+    const Clock::duration elapsed = Clock::now() - start;
+
+    Sample& sample = samples[call.operation];
+    sample.latencies.push_back(
+        std::chrono::duration<double, std::nano>(elapsed).count());
+    if ((result < 0) != (call.result < 0)) {
+      ++sample.mismatches;
+    }
+  }
+  const Clock::duration total = Clock::now() - begin;
+
+  std::printf("%-12s %10s %10s %10s %10s\n", "operation", "calls",
+              "mismatches", "p50", "p99");
+  for (const auto& entry : samples) {
+    const Sample& sample = entry.second;
+    std::printf("%-12s %10zu %10d %8.1fus %8.1fus\n",
+                scoville::OperationName(entry.first), sample.latencies.size(),
+                sample.mismatches, Percentile(sample.latencies, 0.5) / 1e3,
+                Percentile(sample.latencies, 0.99) / 1e3);
+  }
+  std::printf("replayed %zu calls in %.3fs", calls.size(),
+              std::chrono::duration<double>(total).count());
+  if (calls.empty() || FLAGS_as_fast_as_possible) {
+    std::printf("\n");
+  } else {
+    std::printf(" (recorded in %.3fs; fell behind by up to %.3fs)\n",
+                std::chrono::duration<double>(calls.back().start -
+                                              calls.front().start)
+                    .count(),
+                std::chrono::duration<double>(max_lag).count());
+  }
+  return 0;
+}
@@ -0,0 +1,266 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#include "session_loop.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <linux/fuse.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "fuse.h"
+
+namespace scoville {
+
+namespace {
+
+// Channel operations for a clone of the FUSE device.  These mirror the ones
+// libfuse uses for the device itself (fuse_kern_chan.c), which it doesn't
+// export.
+
+int ReceiveFromClone(fuse_chan** const channel, char* const buffer,
+                     const size_t size) {
+  fuse_chan* const ch = *channel;
+  auto* const session = static_cast<fuse_session*>(fuse_chan_data(ch));
+  for (;;) {
+    const ssize_t bytes_read = read(fuse_chan_fd(ch), buffer, size);
+    const int error = errno;
+    if (fuse_session_exited(session)) {
+      return 0;
+    }
+    if (bytes_read == -1) {
+      if (error == ENOENT) {
+        // The request was interrupted before we could read it.
+        continue;
+      }
+      if (error == ENODEV) {
+        // The file system was unmounted.
+        fuse_session_exit(session);
+        return 0;
+      }
+      if (error != EINTR && error != EAGAIN) {
+        LOG(ERROR) << "reading FUSE device: " << std::strerror(error);
+      }
+      return -error;
+    }
+    if (static_cast<size_t>(bytes_read) < sizeof(fuse_in_header)) {
+      LOG(ERROR) << "short read on FUSE device";
+      return -EIO;
+    }
+    return static_cast<int>(bytes_read);
+  }
+}
+
+int SendToClone(fuse_chan* const ch, const iovec iov[], const size_t count) {
+  if (iov == nullptr) {
+    return 0;
+  }
+  if (writev(fuse_chan_fd(ch), iov, static_cast<int>(count)) == -1) {
+    const int error = errno;
+    auto* const session = static_cast<fuse_session*>(fuse_chan_data(ch));
+    // ENOENT means the request was interrupted, and the kernel no longer
+    // wants the reply.
+    if (error != ENOENT && !fuse_session_exited(session)) {
+      LOG(ERROR) << "writing FUSE device: " << std::strerror(error);
+    }
+    return -error;
+  }
+  return 0;
+}
+
+void DestroyClone(fuse_chan* const ch) { close(fuse_chan_fd(ch)); }
+
+fuse_chan_ops clone_operations = {ReceiveFromClone, SendToClone, DestroyClone};
+
+// Opens a new file descriptor attached to the same FUSE connection as the
+// channel, returning a channel for it, or nullptr if the kernel can't clone
+// FUSE file descriptors.
+fuse_chan* CloneChannel(fuse_session* const session, fuse_chan* const master) {
+  const int fd = open("/dev/fuse", O_RDWR | O_CLOEXEC);
+  if (fd == -1) {
+    PLOG(WARNING) << "couldn't open /dev/fuse";
+    return nullptr;
+  }
+  std::uint32_t master_fd = static_cast<std::uint32_t>(fuse_chan_fd(master));
+  if (ioctl(fd, FUSE_DEV_IOC_CLONE, &master_fd) == -1) {
+    PLOG(WARNING) << "couldn't clone FUSE file descriptor";
+    close(fd);
+    return nullptr;
+  }
+  fuse_chan* const result = fuse_chan_new(&clone_operations, fd,
+                                          fuse_chan_bufsize(master), session);
+  if (result == nullptr) {
+    close(fd);
+  }
+  return result;
+}
+
+struct Worker {
+  fuse_session* session;
+  fuse_chan* channel;
+  bool cloned;
+  int cpu;  // -1 if not pinned
+  sem_t* finished;
+  pthread_t thread;
+  bool failed = false;
+};
+
+void* Work(void* const data) {
+  auto* const worker = static_cast<Worker*>(data);
+
+  if (worker->cpu >= 0) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(worker->cpu, &cpus);
+    if (const int error =
+            pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus)) {
+      LOG(WARNING) << "couldn't pin worker to CPU " << worker->cpu << ": "
+                   << std::strerror(error);
+    }
+  }
+
+  std::vector<char> buffer(fuse_chan_bufsize(worker->channel));
+  while (!fuse_session_exited(worker->session)) {
+    fuse_buf request;
+    std::memset(&request, 0, sizeof(request));
+    request.mem = buffer.data();
+    request.size = buffer.size();
+    fuse_chan* channel = worker->channel;
+
+    // Workers are only cancelled while they're waiting for requests, never
+    // while they're processing one.
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, nullptr);
+    const int result =
+        fuse_session_receive_buf(worker->session, &request, &channel);
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, nullptr);
+    if (result == -EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      if (result < 0) {
+        worker->failed = true;
+        fuse_session_exit(worker->session);
+      }
+      break;
+    }
+    fuse_session_process_buf(worker->session, &request, channel);
+  }
+
+  sem_post(worker->finished);
+  return nullptr;
+}
+
+// Returns the CPUs this process may run on.
+std::vector<int> AllowedCpus() {
+  std::vector<int> result;
+  cpu_set_t cpus;
+  if (sched_getaffinity(0, sizeof(cpus), &cpus) == -1) {
+    PLOG(WARNING) << "couldn't get CPU affinity";
+    return result;
+  }
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &cpus)) {
+      result.push_back(cpu);
+    }
+  }
+  return result;
+}
+
+}  // namespace
+
+int RunSessionLoop(fuse_session* const session,
+                   const SessionLoopOptions& options) {
+  CHECK_GT(options.threads, 0);
+  fuse_chan* const master = fuse_session_next_chan(session, nullptr);
+
+  sem_t finished;
+  sem_init(&finished, 0, 0);
+
+  const std::vector<int> cpus =
+      options.pin_threads ? AllowedCpus() : std::vector<int>();
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  bool clone_fd = options.clone_fd;
+  for (int i = 0; i < options.threads; ++i) {
+    std::unique_ptr<Worker> worker(new Worker);
+    worker->session = session;
+    worker->channel = clone_fd ? CloneChannel(session, master) : nullptr;
+    worker->cloned = worker->channel != nullptr;
+    if (!worker->cloned) {
+      // If one clone fails, the rest will too.
+      clone_fd = false;
+      worker->channel = master;
+    }
+    worker->cpu =
+        cpus.empty() ? -1 : cpus[static_cast<size_t>(i) % cpus.size()];
+    worker->finished = &finished;
+
+    // Deliver signals to the main thread only, so they interrupt sem_wait
+    // below rather than some worker's read.
+    sigset_t all_signals;
+    sigset_t old_signals;
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_BLOCK, &all_signals, &old_signals);
+    const int error =
+        pthread_create(&worker->thread, nullptr, Work, worker.get());
+    pthread_sigmask(SIG_SETMASK, &old_signals, nullptr);
+    if (error) {
+      LOG(ERROR) << "couldn't start FUSE worker: " << std::strerror(error);
+      if (worker->cloned) {
+        fuse_chan_destroy(worker->channel);
+      }
+      fuse_session_exit(session);
+      break;
+    }
+    workers.push_back(std::move(worker));
+  }
+  LOG(INFO) << "serving FUSE requests with " << workers.size() << " workers"
+            << (clone_fd ? " on cloned file descriptors" : "");
+
+  // Wait for a worker to finish (the file system was unmounted) or for a
+  // signal handler to end the session.
+  while (!fuse_session_exited(session)) {
+    sem_wait(&finished);
+  }
+
+  for (const std::unique_ptr<Worker>& worker : workers) {
+    pthread_cancel(worker->thread);
+  }
+  bool failed = workers.size() != static_cast<size_t>(options.threads);
+  for (const std::unique_ptr<Worker>& worker : workers) {
+    pthread_join(worker->thread, nullptr);
+    if (worker->cloned) {
+      fuse_chan_destroy(worker->channel);
+    }
+    failed |= worker->failed;
+  }
+  sem_destroy(&finished);
+
+  fuse_session_reset(session);
+  return failed ? -1 : 0;
+}
+
+}  // namespace scoville
@@ -0,0 +1,44 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#ifndef SESSION_LOOP_H_
+#define SESSION_LOOP_H_
+
+#include "fuse.h"
+
+namespace scoville {
+
+struct SessionLoopOptions {
+  // The number of worker threads.  Must be positive.
+  int threads;
+
+  // If true, give each worker its own clone of the FUSE device file descriptor,
+  // so the kernel tracks each worker's outstanding requests separately.
+  // Workers fall back to the shared descriptor if cloning isn't supported.
+  bool clone_fd;
+
+  // If true, pin each worker to a CPU.
+  bool pin_threads;
+};
+
+// Serves requests on the session with a fixed pool of worker threads, each with
+// its own receive buffer, until the session exits.  This replaces
+// fuse_session_loop_mt, which grows and shrinks its pool on demand and funnels
+// every worker through one file descriptor.  Returns 0 on success and -1 on
+// error, like fuse_session_loop_mt.
+int RunSessionLoop(fuse_session*, const SessionLoopOptions&);
+
+}  // namespace scoville
+
+#endif  // SESSION_LOOP_H_
@@ -0,0 +1,121 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#include "stat_prefetcher.h"
+
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+#include <glog/logging.h>
+#include <sys/stat.h>
+
+#include "attribute_cache.h"
+#include "posix_extras.h"
+
+namespace scoville {
+
+namespace {
+
+// Beyond this many queued paths, the workers are so far behind that getattr
+// will get there first.
+constexpr size_t kMaxQueuedPaths = 1 << 14;
+
+}  // namespace
+
+StatPrefetcher::StatPrefetcher(const File& root, AttributeCache* const cache,
+                               const int threads)
+    : root_(root), cache_(cache), dropped_(0) {
+  if (!cache_->enabled()) {
+    if (threads > 0) {
+      LOG(WARNING) << "stat prefetching needs the attribute cache; disabled";
+    }
+    return;
+  }
+  for (int i = 0; i < threads; ++i) {
+    workers_.emplace_back(&StatPrefetcher::Work, this);
+  }
+}
+
+StatPrefetcher::~StatPrefetcher() noexcept {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    stopping_ = true;
+  }
+  ready_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+void StatPrefetcher::Prefetch(const std::string& directory,
+                              const char* const name) {
+  if (!enabled()) {
+    return;
+  }
+  std::string path;
+  if (!directory.empty()) {
+    path.reserve(directory.size() + 1 + std::strlen(name));
+    path.append(directory).push_back('/');
+  }
+  path.append(name);
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (queue_.size() >= kMaxQueuedPaths) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    queue_.push_back(std::move(path));
+  }
+  ready_.notify_one();
+}
+
+void StatPrefetcher::Work() noexcept {
+  for (;;) {
+    std::string path;
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      ready_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      if (stopping_) {
+        return;
+      }
+      path = std::move(queue_.front());
+      queue_.pop_front();
+    }
+
+    if (cache_->Contains(path)) {
+      continue;
+    }
+    const AttributeCache::Generation generation = cache_->BeginFetch(path);
+    struct stat stats;
+    try {
+      if (root_.TryLinkStatAt(path.c_str(), &stats)) {
+        cache_->Insert(path, stats, generation);
+      } else {
+        cache_->InsertMissing(path, generation);
+      }
+    } catch (const std::system_error& e) {
+      // Leave it to getattr to report.
+      VLOG(1) << "couldn't prefetch attributes of " << path << ": " << e.what();
+    } catch (const std::bad_alloc&) {
+      // Likewise.
+    }
+  }
+}
+
+}  // namespace scoville
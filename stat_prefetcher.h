@@ -0,0 +1,77 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#ifndef STAT_PREFETCHER_H_
+#define STAT_PREFETCHER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "attribute_cache.h"
+#include "posix_extras.h"
+
+namespace scoville {
+
+// Stats files in the background and stores the results in an AttributeCache.
+//
+// Programs which list a directory usually go on to stat everything in it, one
+// entry at a time.  On slow media, those stats add up.  Handing the names to a
+// StatPrefetcher as soon as they're listed lets a pool of workers issue the
+// stats in parallel, so that by the time the getattr requests arrive, the
+// answers are already cached.
+class StatPrefetcher {
+ public:
+  // A prefetcher with zero threads, or with a disabled cache, does nothing.
+  StatPrefetcher(const File& root, AttributeCache*, int threads);
+  virtual ~StatPrefetcher() noexcept;
+
+  bool enabled() const noexcept { return !workers_.empty(); }
+
+  // Queues the named entry of the directory for stat.  Both are encoded, and
+  // the directory is relative to the root (empty for the root itself).  If the
+  // queue is full, drops the entry; getattr will fetch it on demand instead.
+  void Prefetch(const std::string& directory, const char* name);
+
+  std::uint64_t dropped() const noexcept { return dropped_.load(); }
+
+ private:
+  StatPrefetcher(const StatPrefetcher&) = delete;
+  StatPrefetcher(StatPrefetcher&&) = delete;
+
+  void operator=(const StatPrefetcher&) = delete;
+  void operator=(StatPrefetcher&&) = delete;
+
+  void Work() noexcept;
+
+  const File& root_;
+  AttributeCache* const cache_;
+
+  std::mutex mu_;
+  std::condition_variable ready_;
+  std::deque<std::string> queue_;
+  bool stopping_ = false;
+
+  std::vector<std::thread> workers_;
+  std::atomic<std::uint64_t> dropped_;
+};
+
+}  // namespace scoville
+
+#endif  // STAT_PREFETCHER_H_
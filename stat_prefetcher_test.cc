@@ -0,0 +1,87 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#include "stat_prefetcher.h"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "attribute_cache.h"
+#include "posix_extras.h"
+#include "test_util.h"
+
+namespace scoville {
+namespace {
+
+constexpr auto kLongTime = std::chrono::hours(1);
+
+class ScovilleStatPrefetcherTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    root_.reset(new File(temporary_.path().c_str(), O_DIRECTORY));
+    root_->MkDir("directory", 0755);
+    root_->OpenAt("directory/file", O_WRONLY | O_CREAT, 0644);
+  }
+
+  // Waits for the cache to learn about the path.
+  static bool WaitFor(AttributeCache* const cache, const char* const path) {
+    for (int i = 0; i < 500; ++i) {
+      if (cache->Contains(path)) {
+        return true;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+  }
+
+  TemporaryDirectory temporary_{"stat_prefetcher_test"};
+  std::unique_ptr<File> root_;
+};
+
+TEST_F(ScovilleStatPrefetcherTest, FillsCache) {
+  AttributeCache cache(*root_, 64, 64, kLongTime, kLongTime);
+  StatPrefetcher prefetcher(*root_, &cache, 2);
+  ASSERT_TRUE(prefetcher.enabled());
+  prefetcher.Prefetch("directory", "file");
+  prefetcher.Prefetch("directory", "missing");
+  prefetcher.Prefetch("", "directory");
+
+  ASSERT_TRUE(WaitFor(&cache, "directory/file"));
+  struct stat stats;
+  ASSERT_EQ(cache.Lookup("directory/file", &stats),
+            AttributeCache::Result::kExists);
+  EXPECT_EQ(stats.st_ino, root_->LinkStatAt("directory/file").st_ino);
+
+  ASSERT_TRUE(WaitFor(&cache, "directory/missing"));
+  EXPECT_EQ(cache.Lookup("directory/missing", &stats),
+            AttributeCache::Result::kMissing);
+
+  EXPECT_TRUE(WaitFor(&cache, "directory"));
+}
+
+TEST_F(ScovilleStatPrefetcherTest, NeedsCache) {
+  AttributeCache cache(*root_, 0, 64, kLongTime, kLongTime);
+  StatPrefetcher prefetcher(*root_, &cache, 2);
+  EXPECT_FALSE(prefetcher.enabled());
+}
+
+}  // namespace
+}  // namespace scoville
@@ -0,0 +1,175 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#include "statistics.h"
+
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include <absl/strings/str_cat.h>
+#include <glog/logging.h>
+#include <signal.h>
+
+namespace scoville {
+
+namespace {
+
+constexpr const char* kOperationNames[] = {
+#define SCOVILLE_OPERATION_NAME(f) #f,
+    SCOVILLE_FOR_EACH_OPERATION(SCOVILLE_OPERATION_NAME)
+#undef SCOVILLE_OPERATION_NAME
+};
+
+// Returns the index of the histogram bucket for the latency.
+int LatencyBucket(const std::uint64_t nanoseconds, const int buckets) noexcept {
+  const int bucket =
+      nanoseconds == 0 ? 0 : 64 - __builtin_clzll(nanoseconds);
+  return bucket < buckets ? bucket : buckets - 1;
+}
+
+std::string Lowercase(const char* const name) {
+  std::string result(name);
+  for (char& c : result) {
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+  return result;
+}
+
+}  // namespace
+
+const char* OperationName(const Operation operation) noexcept {
+  return kOperationNames[static_cast<int>(operation)];
+}
+
+constexpr int Statistics::kMaxErrno;
+constexpr int Statistics::kLatencyBuckets;
+constexpr int Statistics::kOperations;
+
+void Statistics::Record(const Operation operation, const int result,
+                        const std::chrono::steady_clock::duration latency) {
+  Counters& counters = at(operation);
+  counters.calls.fetch_add(1, std::memory_order_relaxed);
+  if (result < 0) {
+    const int error = -result < kMaxErrno ? -result : kMaxErrno;
+    counters.errors[static_cast<size_t>(error)].fetch_add(
+        1, std::memory_order_relaxed);
+  } else if (result > 0 && MovesBytes(operation)) {
+    counters.bytes.fetch_add(static_cast<std::uint64_t>(result),
+                             std::memory_order_relaxed);
+  }
+
+  const auto nanoseconds = static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count());
+  counters.latency_nanoseconds.fetch_add(nanoseconds,
+                                         std::memory_order_relaxed);
+  counters
+      .latencies[static_cast<size_t>(
+          LatencyBucket(nanoseconds, kLatencyBuckets))]
+      .fetch_add(1, std::memory_order_relaxed);
+}
+
+std::string Statistics::Format() const {
+  std::string calls =
+      "# HELP scoville_operations_total FUSE operations handled.\n"
+      "# TYPE scoville_operations_total counter\n";
+  std::string errors =
+      "# HELP scoville_errors_total FUSE operations which failed, by errno.\n"
+      "# TYPE scoville_errors_total counter\n";
+  std::string bytes =
+      "# HELP scoville_bytes_total Bytes read or written.\n"
+      "# TYPE scoville_bytes_total counter\n";
+  std::string latencies =
+      "# HELP scoville_latency_seconds Time spent handling FUSE operations.\n"
+      "# TYPE scoville_latency_seconds histogram\n";
+
+  for (int i = 0; i < kOperations; ++i) {
+    const Counters& counters = operations_[static_cast<size_t>(i)];
+    // The counters may change while we read them, so the output is only
+    // approximately self-consistent.
+    const std::uint64_t call_count =
+        counters.calls.load(std::memory_order_relaxed);
+    if (call_count == 0) {
+      continue;
+    }
+    const std::string label =
+        absl::StrCat("operation=\"", Lowercase(kOperationNames[i]), "\"");
+
+    absl::StrAppend(&calls, "scoville_operations_total{", label, "} ",
+                    call_count, "\n");
+
+    for (int error = 1; error <= kMaxErrno; ++error) {
+      const std::uint64_t count =
+          counters.errors[static_cast<size_t>(error)].load(
+              std::memory_order_relaxed);
+      if (count != 0) {
+        absl::StrAppend(
+            &errors, "scoville_errors_total{", label, ",errno=\"",
+            error == kMaxErrno ? "other" : absl::StrCat(error), "\"} ", count,
+            "\n");
+      }
+    }
+
+    if (MovesBytes(static_cast<Operation>(i)) ||
+        static_cast<Operation>(i) == Operation::kReadBuf) {
+      absl::StrAppend(&bytes, "scoville_bytes_total{", label, "} ",
+                      counters.bytes.load(std::memory_order_relaxed), "\n");
+    }
+
+    std::uint64_t cumulative = 0;
+    for (int bucket = 0; bucket < kLatencyBuckets - 1; ++bucket) {
+      cumulative += counters.latencies[static_cast<size_t>(bucket)].load(
+          std::memory_order_relaxed);
+      absl::StrAppend(&latencies, "scoville_latency_seconds_bucket{", label,
+                      ",le=\"", static_cast<double>(1ull << bucket) * 1e-9,
+                      "\"} ", cumulative, "\n");
+    }
+    absl::StrAppend(
+        &latencies, "scoville_latency_seconds_bucket{", label, ",le=\"+Inf\"} ",
+        call_count, "\n", "scoville_latency_seconds_sum{", label, "} ",
+        static_cast<double>(
+            counters.latency_nanoseconds.load(std::memory_order_relaxed)) *
+            1e-9,
+        "\n", "scoville_latency_seconds_count{", label, "} ", call_count, "\n");
+  }
+
+  return calls + errors + bytes + latencies;
+}
+
+void BlockDumpSignal() {
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGUSR1);
+  if (const int error = pthread_sigmask(SIG_BLOCK, &signals, nullptr)) {
+    LOG(WARNING) << "couldn't block SIGUSR1: error " << error;
+  }
+}
+
+void StartDumpingOnSignal(const Statistics* const statistics) {
+  std::thread([statistics] {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+    for (;;) {
+      int signal;
+      if (sigwait(&signals, &signal) == 0) {
+        LOG(INFO) << "statistics:\n" << statistics->Format();
+      }
+    }
+  }).detach();
+}
+
+}  // namespace scoville
@@ -0,0 +1,120 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#ifndef STATISTICS_H_
+#define STATISTICS_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace scoville {
+
+// The FUSE operations Scoville implements, by the names of the functions that
+// implement them.  Recordings store operations by their position in this list,
+// so add new ones at the end.
+#define SCOVILLE_FOR_EACH_OPERATION(X)                                      \
+  X(Statfs) X(Getattr) X(Fgetattr) X(Mknod) X(Chmod) X(Rename) X(Create)   \
+  X(Open) X(Read) X(ReadBuf) X(Write) X(WriteBuf) X(Utimens) X(Release)   \
+  X(Truncate) X(Ftruncate) X(Unlink) X(Symlink) X(Readlink) X(Mkdir)      \
+  X(Opendir) X(Readdir) X(Releasedir) X(Rmdir) X(Flush) X(Fsync)          \
+  X(CopyFileRange)
+
+enum class Operation {
+#define SCOVILLE_OPERATION_ENUMERATOR(f) k##f,
+  SCOVILLE_FOR_EACH_OPERATION(SCOVILLE_OPERATION_ENUMERATOR)
+#undef SCOVILLE_OPERATION_ENUMERATOR
+};
+
+// The name of the function implementing the operation, e.g., "Getattr".
+const char* OperationName(Operation) noexcept;
+
+// Whether the operation's nonnegative results are byte counts.
+inline bool MovesBytes(const Operation operation) noexcept {
+  return operation == Operation::kRead || operation == Operation::kWrite ||
+         operation == Operation::kWriteBuf ||
+         operation == Operation::kCopyFileRange;
+}
+
+// Counters for every FUSE operation: calls, errors by errno, bytes moved, and
+// a latency histogram with power-of-two buckets.  Recording is a handful of
+// relaxed atomic increments, so it's cheap enough to leave on all the time;
+// the expensive part, formatting, happens only when someone asks.
+class Statistics {
+ public:
+  Statistics() = default;
+
+  // Records a call to the operation, which returned result (a negated errno
+  // value on failure) after the given time.  Results of data-moving operations
+  // count as bytes moved.
+  void Record(Operation, int result, std::chrono::steady_clock::duration);
+
+  // Counts bytes moved by an operation whose result doesn't say.
+  void AddBytes(Operation operation, const std::uint64_t bytes) noexcept {
+    at(operation).bytes.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  // Formats the statistics in the Prometheus text exposition format.
+  std::string Format() const;
+
+ private:
+  // Errors with errno values this large or larger share a counter.
+  static constexpr int kMaxErrno = 134;
+
+  // Bucket i counts latencies in [2^(i-1), 2^i) nanoseconds.  The last bucket
+  // also counts everything longer.
+  static constexpr int kLatencyBuckets = 32;
+
+  // Aligned so that counters for different operations never share a cache
+  // line.
+  struct alignas(64) Counters {
+    std::atomic<std::uint64_t> calls{0};
+    std::atomic<std::uint64_t> bytes{0};
+    std::atomic<std::uint64_t> latency_nanoseconds{0};
+    std::array<std::atomic<std::uint64_t>, kMaxErrno + 1> errors{};
+    std::array<std::atomic<std::uint64_t>, kLatencyBuckets> latencies{};
+  };
+
+#define SCOVILLE_OPERATION_ONE(f) +1
+  static constexpr int kOperations =
+      0 SCOVILLE_FOR_EACH_OPERATION(SCOVILLE_OPERATION_ONE);
+#undef SCOVILLE_OPERATION_ONE
+
+  Statistics(const Statistics&) = delete;
+  Statistics(Statistics&&) = delete;
+
+  void operator=(const Statistics&) = delete;
+  void operator=(Statistics&&) = delete;
+
+  Counters& at(const Operation operation) noexcept {
+    return operations_[static_cast<int>(operation)];
+  }
+
+  std::array<Counters, kOperations> operations_;
+};
+
+// Blocks SIGUSR1 in the calling thread and every thread it later creates, so
+// the thread StartDumpingOnSignal starts can wait for it.  Call this before
+// starting any other threads.
+void BlockDumpSignal();
+
+// Starts a thread that logs the statistics every time the process receives
+// SIGUSR1.
+void StartDumpingOnSignal(const Statistics*);
+
+}  // namespace scoville
+
+#endif  // STATISTICS_H_
@@ -0,0 +1,98 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#include "test_util.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <ftw.h>
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "posix_extras.h"
+
+namespace scoville {
+
+namespace {
+
+// A mkstemp/mkdtemp template for a new entry under testing::TempDir().
+std::string Template(const char* const name) {
+  std::string result = testing::TempDir();
+  if (!result.empty() && result.back() != '/') {
+    result.push_back('/');
+  }
+  result.append("scoville_").append(name).append(".XXXXXX");
+  return result;
+}
+
+}  // namespace
+
+TemporaryFile::TemporaryFile(const char* const name) : path_(Template(name)) {
+  const int fd = mkstemp(&path_[0]);
+  if (fd == -1) {
+    throw std::system_error(errno, std::system_category());
+  }
+  close(fd);
+}
+
+TemporaryFile::~TemporaryFile() noexcept {
+  if (unlink(path_.c_str()) == -1) {
+    ADD_FAILURE() << "couldn't remove " << path_ << ": "
+                  << std::system_category().message(errno);
+  }
+}
+
+TemporaryDirectory::TemporaryDirectory(const char* const name)
+    : path_(Template(name)) {
+  if (mkdtemp(&path_[0]) == nullptr) {
+    throw std::system_error(errno, std::system_category());
+  }
+}
+
+TemporaryDirectory::~TemporaryDirectory() noexcept {
+  try {
+    RemoveTree(path_);
+  } catch (const std::system_error& e) {
+    ADD_FAILURE() << "couldn't remove " << path_ << ": " << e.what();
+  }
+}
+
+void RemoveTree(const std::string& path) {
+  // The callback's nonzero return ends the walk, and nftw passes it back.
+  const int result =
+      nftw(path.c_str(),
+           [](const char* const entry, const struct stat*, int, FTW*) {
+             return std::remove(entry) == 0 ? 0 : errno;
+           },
+           64, FTW_DEPTH | FTW_PHYS);
+  if (result != 0) {
+    throw std::system_error(result == -1 ? errno : result,
+                            std::system_category());
+  }
+}
+
+std::string Contents(const File& file) {
+  const std::vector<std::uint8_t> contents =
+      file.Read(0, static_cast<size_t>(file.Stat().st_size));
+  return std::string(contents.begin(), contents.end());
+}
+
+}  // namespace scoville
@@ -0,0 +1,74 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+// Helpers for tests which need scratch files.
+
+#ifndef TEST_UTIL_H_
+#define TEST_UTIL_H_
+
+#include <string>
+
+#include "posix_extras.h"
+
+namespace scoville {
+
+// An empty file with a unique name under testing::TempDir(), removed when this
+// is destroyed.
+class TemporaryFile {
+ public:
+  // Includes the name in the file's name, to help identify leftovers.
+  explicit TemporaryFile(const char* name);
+  ~TemporaryFile() noexcept;
+
+  const std::string& path() const noexcept { return path_; }
+
+ private:
+  TemporaryFile(const TemporaryFile&) = delete;
+  TemporaryFile(TemporaryFile&&) = delete;
+
+  void operator=(const TemporaryFile&) = delete;
+  void operator=(TemporaryFile&&) = delete;
+
+  std::string path_;
+};
+
+// Like TemporaryFile, but a directory, which is removed along with everything
+// in it.
+class TemporaryDirectory {
+ public:
+  explicit TemporaryDirectory(const char* name);
+  ~TemporaryDirectory() noexcept;
+
+  const std::string& path() const noexcept { return path_; }
+
+ private:
+  TemporaryDirectory(const TemporaryDirectory&) = delete;
+  TemporaryDirectory(TemporaryDirectory&&) = delete;
+
+  void operator=(const TemporaryDirectory&) = delete;
+  void operator=(TemporaryDirectory&&) = delete;
+
+  std::string path_;
+};
+
+// Removes a file or directory tree, children first, without following symbolic
+// links.  Throws std::system_error on failure.
+void RemoveTree(const std::string& path);
+
+// Reads the whole file.
+std::string Contents(const File&);
+
+}  // namespace scoville
+
+#endif  // TEST_UTIL_H_
@@ -0,0 +1,250 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#include "tracer.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include <absl/strings/str_cat.h>
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "posix_extras.h"
+#include "statistics.h"
+
+namespace scoville {
+
+// The ring belonging to the current thread.  When the thread exits, the ring
+// goes back to the tracer for another thread to use.
+struct ThreadRing {
+  ~ThreadRing() {
+    if (ring != nullptr) {
+      tracer->ReleaseRing(ring);
+    }
+  }
+
+  Tracer* tracer = nullptr;
+  Tracer::Ring* ring = nullptr;
+};
+
+namespace {
+
+thread_local ThreadRing this_thread_ring;
+
+// FNV-1a.  It's stable from run to run, unlike absl::Hash, so traces from
+// different runs can be compared.
+std::uint64_t HashPath(const char* path) noexcept {
+  if (path == nullptr) {
+    return 0;
+  }
+  std::uint64_t result = 0xcbf29ce484222325;
+  for (; *path != '\0'; ++path) {
+    result = (result ^ static_cast<unsigned char>(*path)) * 0x100000001b3;
+  }
+  return result;
+}
+
+std::int64_t Nanoseconds(const std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+      .count();
+}
+
+// Formats nanoseconds as microseconds, which is what the trace format wants,
+// without losing precision to floating point.
+std::string Microseconds(const std::int64_t nanoseconds) {
+  return absl::StrCat(nanoseconds / 1000, ".",
+                      absl::Dec(nanoseconds % 1000, absl::kZeroPad3));
+}
+
+}  // namespace
+
+Tracer::Tracer(const size_t entries_per_thread,
+               const std::chrono::steady_clock::duration slow_threshold)
+    : entries_per_thread_(entries_per_thread),
+      slow_threshold_(slow_threshold) {}
+
+void Tracer::Record(const Operation operation, const char* const path,
+                    const std::chrono::steady_clock::time_point start,
+                    const std::chrono::steady_clock::duration duration,
+                    const int result, const std::uint64_t bytes) {
+  if (entries_per_thread_ != 0) {
+    Ring* const ring = ThisThreadRing();
+    Event& event = ring->events[ring->next];
+    ring->next = (ring->next + 1) % ring->size;
+
+    const std::uint32_t sequence =
+        event.sequence.load(std::memory_order_relaxed);
+    event.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.operation.store(static_cast<std::uint32_t>(operation),
+                          std::memory_order_relaxed);
+    event.result.store(result, std::memory_order_relaxed);
+    event.path_hash.store(HashPath(path), std::memory_order_relaxed);
+    event.start_nanoseconds.store(Nanoseconds(start.time_since_epoch()),
+                                  std::memory_order_relaxed);
+    event.duration_nanoseconds.store(Nanoseconds(duration),
+                                     std::memory_order_relaxed);
+    event.bytes.store(bytes, std::memory_order_relaxed);
+    event.sequence.store(sequence + 2, std::memory_order_release);
+  }
+
+  if (slow_threshold_ != std::chrono::steady_clock::duration::zero() &&
+      duration >= slow_threshold_) {
+    LOG(WARNING) << OperationName(operation) << "("
+                 << (path == nullptr ? "<handle>" : path) << ") took "
+                 << static_cast<double>(Nanoseconds(duration)) / 1e6
+                 << " ms and returned " << result;
+  }
+}
+
+std::string Tracer::ChromeTrace() const {
+  std::string result = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  const int pid = getpid();
+  bool first = true;
+
+  std::lock_guard<std::mutex> lock(mu_);
+  for (const std::unique_ptr<Ring>& ring : rings_) {
+    for (size_t i = 0; i < ring->size; ++i) {
+      const Event& event = ring->events[i];
+      const std::uint32_t sequence =
+          event.sequence.load(std::memory_order_acquire);
+      if (sequence == 0 || sequence % 2 != 0) {
+        continue;
+      }
+      const auto operation = static_cast<Operation>(
+          event.operation.load(std::memory_order_relaxed));
+      const std::int32_t call_result =
+          event.result.load(std::memory_order_relaxed);
+      const std::uint64_t path_hash =
+          event.path_hash.load(std::memory_order_relaxed);
+      const std::int64_t start =
+          event.start_nanoseconds.load(std::memory_order_relaxed);
+      const std::int64_t duration =
+          event.duration_nanoseconds.load(std::memory_order_relaxed);
+      const std::uint64_t bytes = event.bytes.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (event.sequence.load(std::memory_order_relaxed) != sequence) {
+        // The owning thread overwrote the event while we were reading it.
+        continue;
+      }
+
+      absl::StrAppend(&result, first ? "\n" : ",\n", "{\"name\":\"",
+                      OperationName(operation),
+                      "\",\"cat\":\"fuse\",\"ph\":\"X\",\"pid\":", pid,
+                      ",\"tid\":", ring->id, ",\"ts\":", Microseconds(start),
+                      ",\"dur\":", Microseconds(duration),
+                      ",\"args\":{\"path_hash\":\"",
+                      absl::Hex(path_hash, absl::kZeroPad16),
+                      "\",\"result\":", call_result, ",\"bytes\":", bytes,
+                      "}}");
+      first = false;
+    }
+  }
+  result += "\n]}\n";
+  return result;
+}
+
+void Tracer::WriteChromeTrace(const char* const path) const {
+  const std::string trace = ChromeTrace();
+  // Write a fresh file beside the destination and rename it into place, so
+  // whatever is already at the path, such as a symbolic link planted by another
+  // user, gets replaced rather than written through.
+  std::string temporary = absl::StrCat(path, ".XXXXXX");
+  const int fd = mkostemp(&temporary[0], O_CLOEXEC);
+  if (fd == -1) {
+    throw std::system_error(errno, std::system_category());
+  }
+  try {
+    File file = File::Adopt(fd);
+    file.Write(0, trace.data(), trace.size());
+    if (rename(temporary.c_str(), path) == -1) {
+      throw std::system_error(errno, std::system_category());
+    }
+  } catch (...) {
+    unlink(temporary.c_str());
+    throw;
+  }
+}
+
+Tracer::Ring* Tracer::ThisThreadRing() {
+  if (this_thread_ring.tracer == this) {
+    return this_thread_ring.ring;
+  }
+
+  Ring* ring;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (free_rings_.empty()) {
+      rings_.emplace_back(
+          new Ring(static_cast<int>(rings_.size()), entries_per_thread_));
+      ring = rings_.back().get();
+    } else {
+      ring = free_rings_.back();
+      free_rings_.pop_back();
+    }
+  }
+  // There's only one Tracer outside tests, so a thread that switches tracers
+  // simply abandons its old ring to the old tracer.
+  this_thread_ring.tracer = this;
+  this_thread_ring.ring = ring;
+  return ring;
+}
+
+void Tracer::ReleaseRing(Ring* const ring) {
+  std::lock_guard<std::mutex> lock(mu_);
+  free_rings_.push_back(ring);
+}
+
+void BlockTraceSignal() {
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGUSR2);
+  if (const int error = pthread_sigmask(SIG_BLOCK, &signals, nullptr)) {
+    LOG(WARNING) << "couldn't block SIGUSR2: error " << error;
+  }
+}
+
+void StartWritingTraceOnSignal(const Tracer* const tracer, std::string path) {
+  std::thread([tracer, path] {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR2);
+    for (;;) {
+      int signal;
+      if (sigwait(&signals, &signal) != 0) {
+        continue;
+      }
+      try {
+        tracer->WriteChromeTrace(path.c_str());
+        LOG(INFO) << "wrote trace to " << path;
+      } catch (const std::system_error& e) {
+        LOG(ERROR) << "couldn't write trace to " << path << ": " << e.what();
+      }
+    }
+  }).detach();
+}
+
+}  // namespace scoville
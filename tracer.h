@@ -0,0 +1,122 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#ifndef TRACER_H_
+#define TRACER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "statistics.h"
+
+namespace scoville {
+
+// Remembers the most recent FUSE calls each thread handled, and optionally
+// logs calls that take too long.
+//
+// Each thread writes to its own ring buffer, so recording takes no locks and
+// touches no shared cache lines.  Each slot in a ring is guarded by a sequence
+// number, seqlock-style, so a dump can run concurrently with recording and
+// simply skips slots that are being overwritten.  Rings belonging to threads
+// that exit are reused by threads created later, which keeps memory bounded
+// even though FUSE's multithreaded loop starts and stops threads as load
+// changes.
+//
+// Threads that record must not outlive the Tracer.
+class Tracer {
+ public:
+  // Keeps the last entries_per_thread calls on each thread (none if it's zero),
+  // and logs calls that take at least slow_threshold (none if it's zero).
+  Tracer(size_t entries_per_thread,
+         std::chrono::steady_clock::duration slow_threshold);
+
+  // Records a call to the operation on the path, or on a null path for
+  // operations on handles.
+  void Record(Operation, const char* path,
+              std::chrono::steady_clock::time_point start,
+              std::chrono::steady_clock::duration, int result,
+              std::uint64_t bytes);
+
+  // Returns the recorded calls as a JSON trace that chrome://tracing and
+  // Perfetto understand.
+  std::string ChromeTrace() const;
+
+  // Writes ChromeTrace to the file, replacing it atomically.  The new file is
+  // readable only by its owner.
+  void WriteChromeTrace(const char* path) const;
+
+ private:
+  struct Event {
+    // Odd while the slot is being written, and zero until it's first written.
+    std::atomic<std::uint32_t> sequence{0};
+    std::atomic<std::uint32_t> operation{0};
+    std::atomic<std::int32_t> result{0};
+    std::atomic<std::uint64_t> path_hash{0};
+    std::atomic<std::int64_t> start_nanoseconds{0};
+    std::atomic<std::int64_t> duration_nanoseconds{0};
+    std::atomic<std::uint64_t> bytes{0};
+  };
+
+  struct Ring {
+    Ring(int id, size_t size) : id(id), size(size), events(new Event[size]) {}
+
+    const int id;
+    const size_t size;
+    std::unique_ptr<Event[]> events;
+
+    // The next slot to write.  Only the thread currently owning the ring
+    // touches this.
+    size_t next = 0;
+  };
+
+  friend struct ThreadRing;
+
+  Tracer(const Tracer&) = delete;
+  Tracer(Tracer&&) = delete;
+
+  void operator=(const Tracer&) = delete;
+  void operator=(Tracer&&) = delete;
+
+  // Returns the calling thread's ring, assigning it one if it doesn't have one
+  // yet.
+  Ring* ThisThreadRing();
+
+  // Makes a ring available to other threads.
+  void ReleaseRing(Ring*);
+
+  const size_t entries_per_thread_;
+  const std::chrono::steady_clock::duration slow_threshold_;
+
+  mutable std::mutex mu_;
+  std::vector<std::unique_ptr<Ring>> rings_;
+  std::vector<Ring*> free_rings_;
+};
+
+// Blocks SIGUSR2 in the calling thread and every thread it later creates, so
+// the thread StartWritingTraceOnSignal starts can wait for it.  Call this
+// before starting any other threads.
+void BlockTraceSignal();
+
+// Starts a thread that writes the tracer's Chrome trace to the file every time
+// the process receives SIGUSR2.
+void StartWritingTraceOnSignal(const Tracer*, std::string path);
+
+}  // namespace scoville
+
+#endif  // TRACER_H_
@@ -0,0 +1,112 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#include "tracer.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "posix_extras.h"
+#include "statistics.h"
+#include "test_util.h"
+
+namespace scoville {
+namespace {
+
+constexpr auto kNever = std::chrono::steady_clock::duration::zero();
+
+int Count(const std::string& haystack, const std::string& needle) {
+  int result = 0;
+  for (size_t i = haystack.find(needle); i != std::string::npos;
+       i = haystack.find(needle, i + 1)) {
+    ++result;
+  }
+  return result;
+}
+
+// Records from a new thread, since a thread sticks with the first tracer it
+// records to.
+void RecordOnNewThread(Tracer* const tracer, const Operation operation,
+                       const int times) {
+  std::thread([=] {
+    for (int i = 0; i < times; ++i) {
+      tracer->Record(operation, "/foo", std::chrono::steady_clock::now(),
+                     std::chrono::microseconds(3), 42, 42);
+    }
+  }).join();
+}
+
+TEST(ScovilleTracerTest, EmptyTraceIsValid) {
+  Tracer tracer(16, kNever);
+  EXPECT_EQ(tracer.ChromeTrace(),
+            "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n]}\n");
+}
+
+TEST(ScovilleTracerTest, RecordsCalls) {
+  Tracer tracer(16, kNever);
+  RecordOnNewThread(&tracer, Operation::kRead, 1);
+  const std::string trace = tracer.ChromeTrace();
+  EXPECT_EQ(Count(trace, "\"name\":\"Read\""), 1);
+  EXPECT_EQ(Count(trace, "\"dur\":3.000"), 1);
+  EXPECT_EQ(Count(trace, "\"result\":42"), 1);
+  EXPECT_EQ(Count(trace, "\"bytes\":42"), 1);
+}
+
+TEST(ScovilleTracerTest, KeepsOnlyRecentCalls) {
+  Tracer tracer(4, kNever);
+  RecordOnNewThread(&tracer, Operation::kRead, 10);
+  EXPECT_EQ(Count(tracer.ChromeTrace(), "\"ph\":\"X\""), 4);
+}
+
+TEST(ScovilleTracerTest, ReusesRingsOfExitedThreads) {
+  Tracer tracer(4, kNever);
+  RecordOnNewThread(&tracer, Operation::kRead, 4);
+  RecordOnNewThread(&tracer, Operation::kWrite, 2);
+  const std::string trace = tracer.ChromeTrace();
+  EXPECT_EQ(Count(trace, "\"name\":\"Read\""), 2);
+  EXPECT_EQ(Count(trace, "\"name\":\"Write\""), 2);
+  EXPECT_EQ(Count(trace, "\"tid\":1"), 0);
+}
+
+TEST(ScovilleTracerTest, DisabledBufferRecordsNothing) {
+  Tracer tracer(0, std::chrono::hours(1));
+  RecordOnNewThread(&tracer, Operation::kRead, 1);
+  EXPECT_EQ(Count(tracer.ChromeTrace(), "\"ph\":\"X\""), 0);
+}
+
+TEST(ScovilleTracerTest, WriteReplacesSymbolicLinks) {
+  TemporaryDirectory directory("tracer_test");
+  const std::string victim = directory.path() + "/victim";
+  const std::string trace = directory.path() + "/trace.json";
+  File(victim.c_str(), O_WRONLY | O_CREAT, 0644).Write(0, "precious", 8);
+  ASSERT_EQ(symlink(victim.c_str(), trace.c_str()), 0);
+
+  Tracer tracer(16, kNever);
+  tracer.WriteChromeTrace(trace.c_str());
+
+  EXPECT_EQ(Contents(File(victim.c_str(), O_RDONLY)), "precious");
+  struct stat stats;
+  ASSERT_EQ(lstat(trace.c_str(), &stats), 0);
+  EXPECT_TRUE(S_ISREG(stats.st_mode));
+  EXPECT_EQ(Contents(File(trace.c_str(), O_RDONLY)), tracer.ChromeTrace());
+}
+
+}  // namespace
+}  // namespace scoville
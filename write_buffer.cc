@@ -0,0 +1,174 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#include "write_buffer.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include <glog/logging.h>
+#include <sys/types.h>
+
+#include "posix_extras.h"
+
+namespace scoville {
+
+WriteBuffer::WriteBuffer(const size_t capacity)
+    : capacity_(capacity), offset_(0) {}
+
+void WriteBuffer::Write(File* const file, const off_t offset,
+                        const void* const buffer, const size_t bytes) {
+  DCHECK(Absorbs(bytes));
+  if (!data_.empty() &&
+      offset != offset_ + static_cast<off_t>(data_.size())) {
+    Flush(file);
+  }
+  if (data_.empty()) {
+    // Allocate lazily, so handles that are never written to cost nothing.
+    data_.reserve(capacity_ * 2);
+    offset_ = offset;
+  }
+  data_.append(static_cast<const char*>(buffer), bytes);
+
+  const off_t end = offset_ + static_cast<off_t>(data_.size());
+  const off_t boundary = end - end % static_cast<off_t>(capacity_);
+  if (offset_ < boundary) {
+    WriteOut(file, static_cast<size_t>(boundary - offset_));
+  }
+}
+
+void WriteBuffer::Flush(File* const file) {
+  if (!data_.empty()) {
+    WriteOut(file, data_.size());
+  }
+}
+
+void WriteBuffer::WriteOut(File* const file, const size_t bytes) {
+  try {
+    file->Write(offset_, data_.data(), bytes);
+  } catch (...) {
+    data_.clear();
+    throw;
+  }
+  data_.erase(0, bytes);
+  offset_ += static_cast<off_t>(bytes);
+}
+
+void BufferedFile::Open(File* const file) {
+  std::lock_guard<std::mutex> lock(mu_);
+  buffers_.emplace_back(
+      file, std::unique_ptr<WriteBuffer>(new WriteBuffer(capacity_)));
+}
+
+void BufferedFile::Close(File* const file) {
+  std::lock_guard<std::mutex> lock(mu_);
+  const auto it = Find(file);
+  const std::unique_ptr<WriteBuffer> buffer = std::move(it->second);
+  buffers_.erase(it);
+  buffer->Flush(file);
+}
+
+void BufferedFile::Write(File* const file, const off_t offset,
+                         const void* const buffer, const size_t bytes) {
+  std::lock_guard<std::mutex> lock(mu_);
+  FlushOthers(file);
+  dirty_.store(true, std::memory_order_release);
+  Find(file)->second->Write(file, offset, buffer, bytes);
+}
+
+void BufferedFile::Flush(File* const file) {
+  std::lock_guard<std::mutex> lock(mu_);
+  Find(file)->second->Flush(file);
+}
+
+bool BufferedFile::Flush() {
+  if (!dirty_.load(std::memory_order_acquire)) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mu_);
+  return FlushOthers(nullptr);
+}
+
+std::unique_lock<std::mutex> BufferedFile::FlushForWrite() {
+  std::unique_lock<std::mutex> lock(mu_);
+  if (dirty_.load(std::memory_order_acquire)) {
+    FlushOthers(nullptr);
+  }
+  return lock;
+}
+
+BufferedFile::Buffers::iterator BufferedFile::Find(File* const file) {
+  const auto it = std::find_if(
+      buffers_.begin(), buffers_.end(),
+      [file](const Buffers::value_type& buffer) {
+        return buffer.first == file;
+      });
+  CHECK(it != buffers_.end()) << "file was never opened for buffering";
+  return it;
+}
+
+bool BufferedFile::FlushOthers(File* const file) {
+  bool flushed = false;
+  for (const auto& buffer : buffers_) {
+    if (buffer.first != file && !buffer.second->empty()) {
+      buffer.second->Flush(buffer.first);
+      flushed = true;
+    }
+  }
+  if (file == nullptr) {
+    dirty_.store(false, std::memory_order_release);
+  }
+  return flushed;
+}
+
+constexpr size_t BufferedFiles::kShards;
+
+std::shared_ptr<BufferedFile> BufferedFiles::Acquire(const Key& key) {
+  Shard& shard = ShardFor(key);
+  std::lock_guard<std::mutex> lock(shard.mu);
+  Entry& entry = shard.files[key];
+  if (entry.file == nullptr) {
+    entry.file = std::make_shared<BufferedFile>(capacity_);
+  }
+  ++entry.handles;
+  return entry.file;
+}
+
+void BufferedFiles::Release(const Key& key) {
+  Shard& shard = ShardFor(key);
+  std::lock_guard<std::mutex> lock(shard.mu);
+  const auto it = shard.files.find(key);
+  CHECK(it != shard.files.end());
+  if (--it->second.handles == 0) {
+    shard.files.erase(it);
+  }
+}
+
+bool BufferedFiles::Flush(const Key& key) {
+  std::shared_ptr<BufferedFile> file;
+  {
+    Shard& shard = ShardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mu);
+    const auto it = shard.files.find(key);
+    if (it == shard.files.end()) {
+      return false;
+    }
+    file = it->second.file;
+  }
+  return file->Flush();
+}
+
+}  // namespace scoville
@@ -0,0 +1,194 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#ifndef WRITE_BUFFER_H_
+#define WRITE_BUFFER_H_
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "posix_extras.h"
+
+namespace scoville {
+
+// Coalesces small sequential writes to a file into large, aligned ones.  Flash
+// media, and FAT on flash media in particular, handle a few big writes much
+// better than many small ones.
+//
+// The buffer holds one contiguous run of data.  A write that doesn't continue
+// the run flushes it first.  Whenever the run crosses a multiple of the
+// buffer's capacity, everything before that multiple is written out, so after
+// the first chunk, writes reach the file in capacity-sized, capacity-aligned
+// pieces.
+//
+// Not thread-safe.  If writing to the file fails, the buffered data are
+// discarded and the error is thrown from whichever call was writing.
+class WriteBuffer {
+ public:
+  // A buffer with zero capacity buffers nothing.
+  explicit WriteBuffer(size_t capacity);
+
+  size_t capacity() const noexcept { return capacity_; }
+  bool empty() const noexcept { return data_.empty(); }
+
+  // Whether Write buffers writes of the given size.  Larger ones should go
+  // straight to the file, after a Flush.
+  bool Absorbs(const size_t bytes) const noexcept { return bytes < capacity_; }
+
+  // Buffers a write to the file, which must be smaller than the capacity.
+  void Write(File*, off_t, const void* buffer, size_t);
+
+  // Writes everything buffered to the file.
+  void Flush(File*);
+
+ private:
+  WriteBuffer(const WriteBuffer&) = delete;
+  WriteBuffer(WriteBuffer&&) = delete;
+
+  void operator=(const WriteBuffer&) = delete;
+  void operator=(WriteBuffer&&) = delete;
+
+  // Writes the first bytes of the buffer to the file and drops them.
+  void WriteOut(File*, size_t bytes);
+
+  const size_t capacity_;
+
+  // The offset in the file of data_.
+  off_t offset_;
+  std::string data_;
+};
+
+// The write buffers of every handle open on one file.  Data buffered through
+// one handle have to land before the file is read or stat'ed through any
+// handle, and before another handle writes to it, or the stale data would
+// overwrite newer ones when they were eventually written out.
+//
+// Thread-safe.  Flushing a file with nothing buffered takes no lock, so reads
+// of files that aren't being written are as cheap as without buffering.
+class BufferedFile {
+ public:
+  explicit BufferedFile(size_t capacity) : capacity_(capacity), dirty_(false) {}
+
+  // Whether Write buffers writes of the given size.  Larger ones should go
+  // straight to the file, under the lock from FlushForWrite.
+  bool Absorbs(const size_t bytes) const noexcept { return bytes < capacity_; }
+
+  // Adds a buffer for writes through the file, which must be one of the
+  // handles open on this file.
+  void Open(File*);
+
+  // Writes out and removes the file's buffer.  The buffer is removed even if
+  // writing fails.
+  void Close(File*);
+
+  // Buffers a write through the file after writing out anything other
+  // handles have buffered.  The write must be one that Absorbs.
+  void Write(File*, off_t, const void* buffer, size_t);
+
+  // Writes out what's been buffered through the file.
+  void Flush(File*);
+
+  // Writes out what's been buffered through every handle.  Returns whether
+  // there was anything.
+  bool Flush();
+
+  // Writes out what's been buffered through every handle and returns a lock
+  // that keeps anything new from being buffered.  Hold it while writing
+  // straight to the file.
+  std::unique_lock<std::mutex> FlushForWrite();
+
+ private:
+  BufferedFile(const BufferedFile&) = delete;
+  BufferedFile(BufferedFile&&) = delete;
+
+  void operator=(const BufferedFile&) = delete;
+  void operator=(BufferedFile&&) = delete;
+
+  using Buffers = std::vector<std::pair<File*, std::unique_ptr<WriteBuffer>>>;
+
+  Buffers::iterator Find(File*);
+
+  // Flushes every buffer but the one for the file, which may be null.
+  // Returns whether there was anything.
+  bool FlushOthers(File*);
+
+  const size_t capacity_;
+
+  std::mutex mu_;
+  Buffers buffers_;
+
+  // Set whenever a write is buffered, and cleared once everything has been
+  // written out.  A failed flush can leave it set spuriously, which only
+  // costs the next flush a lock.
+  std::atomic<bool> dirty_;
+};
+
+// BufferedFiles by inode, shared among all the handles open on each inode.
+// Thread-safe.
+class BufferedFiles {
+ public:
+  // Identifies an inode.  The backing tree can span several file systems, so
+  // the inode number alone isn't enough.
+  using Key = std::pair<dev_t, ino_t>;
+
+  // Each file's handles buffer up to capacity bytes apiece.
+  explicit BufferedFiles(size_t capacity) : capacity_(capacity) {}
+
+  // Returns the inode's BufferedFile, creating it if no handle has it yet.
+  // Pair each call with a Release once the handle is closed.
+  std::shared_ptr<BufferedFile> Acquire(const Key&);
+  void Release(const Key&);
+
+  // Writes out everything buffered for the inode through any handle.  Returns
+  // whether there was anything.
+  bool Flush(const Key&);
+
+ private:
+  BufferedFiles(const BufferedFiles&) = delete;
+  BufferedFiles(BufferedFiles&&) = delete;
+
+  void operator=(const BufferedFiles&) = delete;
+  void operator=(BufferedFiles&&) = delete;
+
+  static constexpr size_t kShards = 16;
+
+  struct Entry {
+    size_t handles;
+    std::shared_ptr<BufferedFile> file;
+  };
+
+  struct Shard {
+    std::mutex mu;
+    std::map<Key, Entry> files;
+  };
+
+  Shard& ShardFor(const Key& key) noexcept {
+    return shards_[key.second % kShards];
+  }
+
+  const size_t capacity_;
+  std::array<Shard, kShards> shards_;
+};
+
+}  // namespace scoville
+
+#endif  // WRITE_BUFFER_H_
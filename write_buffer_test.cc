@@ -0,0 +1,150 @@
+// Copyright 2026 Benjamin Barenblat
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations under
+// the License.
+
+#include "write_buffer.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "posix_extras.h"
+#include "test_util.h"
+
+namespace scoville {
+namespace {
+
+class ScovilleWriteBufferTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    file_.reset(new File(temporary_.path().c_str(), O_RDWR));
+  }
+
+  std::string Contents() const { return scoville::Contents(*file_); }
+
+  TemporaryFile temporary_{"write_buffer_test"};
+  std::unique_ptr<File> file_;
+};
+
+TEST_F(ScovilleWriteBufferTest, CoalescesSequentialWrites) {
+  WriteBuffer buffer(16);
+  buffer.Write(file_.get(), 0, "abcd", 4);
+  buffer.Write(file_.get(), 4, "efgh", 4);
+  buffer.Write(file_.get(), 8, "ijkl", 4);
+  EXPECT_EQ(Contents(), "");
+  buffer.Flush(file_.get());
+  EXPECT_TRUE(buffer.empty());
+  EXPECT_EQ(Contents(), "abcdefghijkl");
+}
+
+TEST_F(ScovilleWriteBufferTest, WritesAlignedChunks) {
+  WriteBuffer buffer(8);
+  buffer.Write(file_.get(), 0, "abc", 3);
+  buffer.Write(file_.get(), 3, "defgh", 5);
+  // The buffer reached a multiple of its capacity, so it wrote everything.
+  EXPECT_TRUE(buffer.empty());
+  EXPECT_EQ(Contents(), "abcdefgh");
+
+  buffer.Write(file_.get(), 8, "ijklmno", 7);
+  buffer.Write(file_.get(), 15, "pqr", 3);
+  // Only the part before offset 16 was written.
+  EXPECT_EQ(Contents(), "abcdefghijklmnop");
+  buffer.Flush(file_.get());
+  EXPECT_EQ(Contents(), "abcdefghijklmnopqr");
+}
+
+TEST_F(ScovilleWriteBufferTest, FlushesBeforeNoncontiguousWrites) {
+  WriteBuffer buffer(16);
+  buffer.Write(file_.get(), 0, "ab", 2);
+  buffer.Write(file_.get(), 4, "ef", 2);
+  EXPECT_EQ(Contents(), "ab");
+  buffer.Flush(file_.get());
+  EXPECT_EQ(Contents(), std::string("ab\0\0ef", 6));
+}
+
+TEST_F(ScovilleWriteBufferTest, DiscardsDataWhenWritingFails) {
+  File read_only(temporary_.path().c_str(), O_RDONLY);
+  WriteBuffer buffer(4);
+  buffer.Write(&read_only, 0, "ab", 2);
+  EXPECT_THROW(buffer.Write(&read_only, 2, "cd", 2), std::system_error);
+  EXPECT_TRUE(buffer.empty());
+}
+
+TEST_F(ScovilleWriteBufferTest, FlushesOtherHandlesBeforeWriting) {
+  File other(temporary_.path().c_str(), O_RDWR);
+  BufferedFile buffers(16);
+  buffers.Open(file_.get());
+  buffers.Open(&other);
+  buffers.Write(file_.get(), 0, "abcd", 4);
+  // If the first handle's stale data were written out later, they would
+  // overwrite these.
+  buffers.Write(&other, 0, "wx", 2);
+  EXPECT_EQ(Contents(), "abcd");
+  buffers.Close(file_.get());
+  buffers.Close(&other);
+  EXPECT_EQ(Contents(), "wxcd");
+}
+
+TEST_F(ScovilleWriteBufferTest, FlushesEveryHandleBeforeWritingThrough) {
+  File other(temporary_.path().c_str(), O_RDWR);
+  BufferedFile buffers(16);
+  buffers.Open(file_.get());
+  buffers.Open(&other);
+  buffers.Write(file_.get(), 0, "abcd", 4);
+  buffers.Write(&other, 4, "ef", 2);
+  {
+    const std::unique_lock<std::mutex> lock = buffers.FlushForWrite();
+    EXPECT_EQ(Contents(), "abcdef");
+    other.Write(1, "XY", 2);
+  }
+  EXPECT_FALSE(buffers.Flush());
+  buffers.Close(file_.get());
+  buffers.Close(&other);
+  EXPECT_EQ(Contents(), "aXYdef");
+}
+
+TEST_F(ScovilleWriteBufferTest, SharesFilesByInode) {
+  BufferedFiles files(16);
+  const struct stat stats = file_->Stat();
+  const BufferedFiles::Key inode(stats.st_dev, stats.st_ino);
+  const std::shared_ptr<BufferedFile> buffers = files.Acquire(inode);
+  EXPECT_EQ(files.Acquire(inode), buffers);
+  buffers->Open(file_.get());
+  buffers->Write(file_.get(), 0, "ab", 2);
+  EXPECT_TRUE(files.Flush(inode));
+  EXPECT_EQ(Contents(), "ab");
+  EXPECT_FALSE(files.Flush(inode));
+  buffers->Close(file_.get());
+  files.Release(inode);
+  files.Release(inode);
+  EXPECT_FALSE(files.Flush(inode));
+  EXPECT_NE(files.Acquire(inode), buffers);
+}
+
+TEST_F(ScovilleWriteBufferTest, DistinguishesInodesOnDifferentDevices) {
+  BufferedFiles files(16);
+  const BufferedFiles::Key first(1, 42);
+  const BufferedFiles::Key second(2, 42);
+  EXPECT_NE(files.Acquire(first), files.Acquire(second));
+  files.Release(first);
+  files.Release(second);
+}
+
+}  // namespace
+}  // namespace scoville